@@ -0,0 +1,226 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE file.
+ */
+
+#pragma once
+
+#include <dsp/common.hpp>
+
+
+namespace rack {
+namespace dsp {
+
+
+/** Bank of biquad sections evaluated side by side, one section per SIMD lane.
+
+`T` is `simd::float_4` or `simd::float_8`, giving 4 or 8 sections.
+Sections use transposed direct form II, with coefficients and state stored one vector per term.
+Coefficients follow the layout of TBiquadFilter, `b[3]` for the numerator and `a[2]` for the denominator without its leading 1.
+Unused sections should be set to identity, which is the default.
+
+The same bank can be run as:
+- independent filters, one signal per lane, with `process(T)`
+- a cascade of all sections, in series, with `processCascade()`
+- a parallel filter bank, summing all section outputs, with `processParallel()`
+
+Coefficient changes are interpolated linearly over `setRampLength()` samples to avoid zipper noise.
+*/
+template <typename T = simd::float_4>
+struct TBiquadBank {
+	static constexpr const int SECTIONS = T::size;
+
+	/** Coefficients currently in use */
+	T b0, b1, b2, a1, a2;
+	/** Coefficients being interpolated towards */
+	T targetB0, targetB1, targetB2, targetA1, targetA2;
+	/** Per-sample coefficient increments while interpolating */
+	T deltaB0, deltaB1, deltaB2, deltaA1, deltaA2;
+	/** Filter state */
+	T s1, s2;
+
+	int rampLength = 0;
+	int rampRemaining = 0;
+	bool targetChanged = false;
+
+	TBiquadBank() {
+		targetB0 = 1.f;
+		targetB1 = targetB2 = targetA1 = targetA2 = 0.f;
+		b0 = targetB0;
+		b1 = b2 = a1 = a2 = 0.f;
+		deltaB0 = deltaB1 = deltaB2 = deltaA1 = deltaA2 = 0.f;
+		reset();
+	}
+
+	void reset() {
+		s1 = s2 = 0.f;
+	}
+
+	/** Sets the number of samples over which coefficient changes are interpolated, 0 applies them immediately. */
+	void setRampLength(int rampLength) {
+		this->rampLength = std::max(rampLength, 0);
+	}
+
+	/** Sets the coefficients of one section.
+	Takes effect on the next process call, interpolated over the ramp length.
+	*/
+	void setSection(int section, const float* b, const float* a) {
+		targetB0.s[section] = b[0];
+		targetB1.s[section] = b[1];
+		targetB2.s[section] = b[2];
+		targetA1.s[section] = a[0];
+		targetA2.s[section] = a[1];
+		targetChanged = true;
+	}
+
+	/** Makes one section pass its input through unchanged. */
+	void setSectionIdentity(int section) {
+		const float b[3] = {1.f, 0.f, 0.f};
+		const float a[2] = {0.f, 0.f};
+		setSection(section, b, a);
+	}
+
+	/** Processes one sample per lane, each section filtering its own signal. */
+	T process(T in) {
+		updateRamp();
+		T out = step(in);
+		advanceRamp();
+		return out;
+	}
+
+	/** Runs `buffer` through all sections in series, in place.
+	Section k works on the sample k steps behind section 0, so all sections are evaluated at once per step with no added latency.
+	The first and last SECTIONS - 1 steps of a block only update the sections that have a sample to work on.
+	*/
+	void processCascade(float* buffer, int frames) {
+		updateRamp();
+
+		const int latency = SECTIONS - 1;
+		// lanes[k] is the input of section k, lanes[k + 1] receives its output
+		float lanes[SECTIONS + 1] = {};
+		T laneIndex;
+		for (int i = 0; i < SECTIONS; i++) {
+			laneIndex.s[i] = i;
+		}
+
+		for (int i = 0; i < frames + latency; i++) {
+			lanes[0] = i < frames ? buffer[i] : 0.f;
+			T in = T::load(lanes);
+			T out;
+			if (i < latency || i >= frames) {
+				T active = (laneIndex <= float(i)) & (laneIndex > float(i - frames));
+				out = stepMasked(in, active);
+			}
+			else {
+				out = step(in);
+			}
+			out.store(&lanes[1]);
+
+			if (i >= latency)
+				buffer[i - latency] = lanes[SECTIONS];
+			if (i < frames)
+				advanceRamp();
+		}
+	}
+
+	/** Feeds `input` to all sections and writes the sum of their outputs to `output`.
+	`input` and `output` may be the same buffer.
+	*/
+	void processParallel(const float* input, float* output, int frames) {
+		updateRamp();
+
+		for (int i = 0; i < frames; i++) {
+			T out = step(T(input[i]));
+			advanceRamp();
+
+			float sum = 0.f;
+			for (int k = 0; k < SECTIONS; k++) {
+				sum += out[k];
+			}
+			output[i] = sum;
+		}
+	}
+
+private:
+	T step(T in) {
+		T out = b0 * in + s1;
+		s1 = b1 * in - a1 * out + s2;
+		s2 = b2 * in - a2 * out;
+		return out;
+	}
+
+	/** Like step() but leaves the state of lanes outside `mask` untouched */
+	T stepMasked(T in, T mask) {
+		T out = b0 * in + s1;
+		T newS1 = b1 * in - a1 * out + s2;
+		T newS2 = b2 * in - a2 * out;
+		s1 = simd::ifelse(mask, newS1, s1);
+		s2 = simd::ifelse(mask, newS2, s2);
+		return out;
+	}
+
+	/** Starts interpolating towards new targets, if any were set since the last call */
+	void updateRamp() {
+		if (!targetChanged)
+			return;
+		targetChanged = false;
+
+		if (rampLength == 0) {
+			snapToTarget();
+			return;
+		}
+
+		const float scale = 1.f / rampLength;
+		deltaB0 = (targetB0 - b0) * scale;
+		deltaB1 = (targetB1 - b1) * scale;
+		deltaB2 = (targetB2 - b2) * scale;
+		deltaA1 = (targetA1 - a1) * scale;
+		deltaA2 = (targetA2 - a2) * scale;
+		rampRemaining = rampLength;
+	}
+
+	void advanceRamp() {
+		if (rampRemaining == 0)
+			return;
+
+		if (--rampRemaining == 0) {
+			snapToTarget();
+			return;
+		}
+
+		b0 += deltaB0;
+		b1 += deltaB1;
+		b2 += deltaB2;
+		a1 += deltaA1;
+		a2 += deltaA2;
+	}
+
+	void snapToTarget() {
+		b0 = targetB0;
+		b1 = targetB1;
+		b2 = targetB2;
+		a1 = targetA1;
+		a2 = targetA2;
+		rampRemaining = 0;
+	}
+};
+
+
+typedef TBiquadBank<simd::float_4> BiquadBank4;
+typedef TBiquadBank<simd::float_8> BiquadBank8;
+
+
+} // namespace dsp
+} // namespace rack
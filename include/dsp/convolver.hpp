@@ -0,0 +1,292 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE file.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <dsp/fir.hpp>
+
+
+namespace rack {
+namespace dsp {
+
+
+/** Worker threads shared by all NonUniformConvolver instances, one per stage level.
+Level 0 runs the first stage of every convolver, level 1 the second and so on, so a long job never delays a shorter one.
+Workers ask for realtime priority, higher for lower levels as those have the closest deadlines.
+Realtime priority is only a request, without permission for it workers keep the default priority.
+*/
+struct NonUniformConvolverWorkers {
+	/** Realtime priority of the level 0 worker, below what audio threads usually run at. Later levels go one lower each. */
+	static constexpr const int WORKER_PRIORITY = 60;
+
+	/** Convolution job handed over without locks, see NonUniformConvolver::Stage */
+	struct Job {
+		enum State { IDLE, QUEUED, RUNNING };
+		std::atomic<int> state {IDLE};
+
+		virtual ~Job() {}
+		virtual void run() = 0;
+
+		/** Runs the job if it is queued and nobody took it yet, returns whether it did */
+		bool tryRun() {
+			int expected = QUEUED;
+			if (!state.compare_exchange_strong(expected, RUNNING, std::memory_order_acquire))
+				return false;
+			run();
+			state.store(IDLE, std::memory_order_release);
+			return true;
+		}
+	};
+
+	struct Level {
+		/** Jobs of this level, the worker holds the mutex while it scans or runs them */
+		std::vector<Job*> jobs;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::thread worker;
+		bool workerShouldExit = false;
+
+		void run() {
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!workerShouldExit) {
+				bool ranAny = false;
+				for (Job* job : jobs) {
+					if (job->tryRun())
+						ranAny = true;
+				}
+				if (ranAny)
+					continue;
+				// Jobs are queued without taking the mutex, so a wakeup can be missed while scanning.
+				// Waking up periodically bounds that, and the audio thread runs any job still queued at its deadline.
+				if (jobs.empty())
+					condition.wait(lock);
+				else
+					condition.wait_for(lock, std::chrono::milliseconds(1));
+			}
+		}
+	};
+
+	std::mutex mutex;
+	std::vector<Level*> levels;
+
+	static NonUniformConvolverWorkers& get() {
+		static NonUniformConvolverWorkers workers;
+		return workers;
+	}
+
+	~NonUniformConvolverWorkers() {
+		for (Level* level : levels) {
+			{
+				std::lock_guard<std::mutex> lock(level->mutex);
+				level->workerShouldExit = true;
+			}
+			level->condition.notify_one();
+			level->worker.join();
+			delete level;
+		}
+	}
+
+	/** Adds a job to a level, starting its worker if needed. Not realtime safe. */
+	Level* addJob(size_t levelIndex, Job* job) {
+		Level* level;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			while (levels.size() <= levelIndex) {
+				Level* newLevel = new Level;
+				newLevel->worker = std::thread(&Level::run, newLevel);
+
+				const int policy = SCHED_FIFO;
+				sched_param param = {};
+				param.sched_priority = std::max(WORKER_PRIORITY - (int) levels.size(), sched_get_priority_min(policy));
+				pthread_setschedparam(newLevel->worker.native_handle(), policy, &param);
+
+				levels.push_back(newLevel);
+			}
+			level = levels[levelIndex];
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(level->mutex);
+			level->jobs.push_back(job);
+		}
+		level->condition.notify_one();
+		return level;
+	}
+
+	/** Removes a job from its level, waiting for the worker to finish running it. Not realtime safe. */
+	static void removeJob(Level* level, Job* job) {
+		std::lock_guard<std::mutex> lock(level->mutex);
+		level->jobs.erase(std::remove(level->jobs.begin(), level->jobs.end(), job), level->jobs.end());
+	}
+};
+
+
+/** Zero-latency convolver for long kernels, using non-uniform partitions.
+
+The kernel head is convolved on the calling thread with partitions of `blockSize`, same as RealTimeConvolver.
+The rest of the kernel is split into stages. Each stage uses partitions STAGE_GROWTH times larger than the one before and starts at twice its partition size into the kernel.
+A stage therefore has one full period of its own partition size between receiving a complete input partition and having to output its result.
+Stages run that work on NonUniformConvolverWorkers, shared by all instances, so the calling thread only does the head plus a few copies and sums per block.
+Jobs are handed over without locks. If a worker has not picked up a job by the time its result is needed, `processBlock()` runs it itself,
+and if the worker is still running it, waits for it to finish, so the output is never wrong.
+
+Has the same API as RealTimeConvolver, and can be used as a drop-in replacement for long kernels.
+*/
+struct NonUniformConvolver {
+	/** Ratio between the partition sizes of consecutive stages */
+	static constexpr const size_t STAGE_GROWTH = 4;
+	/** Partition size at which stages stop growing, the last stage takes the remaining kernel */
+	static constexpr const size_t MAX_PARTITION_SIZE = 16384;
+
+	struct Stage : NonUniformConvolverWorkers::Job {
+		RealTimeConvolver convolver;
+		size_t partitionSize;
+		/** Input partition being filled by the calling thread */
+		float* inputAccum;
+		/** Complete input partition handed over to the worker */
+		float* jobInput;
+		/** Double-buffered stage output, one is read while the worker writes the other */
+		float* outputs[2];
+		float* jobOutput = NULL;
+		NonUniformConvolverWorkers::Level* level = NULL;
+
+		Stage(size_t partitionSize) : convolver(partitionSize), partitionSize(partitionSize) {
+			inputAccum = (float*) pffft_aligned_malloc(sizeof(float) * partitionSize);
+			std::memset(inputAccum, 0, sizeof(float) * partitionSize);
+			jobInput = (float*) pffft_aligned_malloc(sizeof(float) * partitionSize);
+			std::memset(jobInput, 0, sizeof(float) * partitionSize);
+			for (int i = 0; i < 2; i++) {
+				outputs[i] = (float*) pffft_aligned_malloc(sizeof(float) * partitionSize);
+				std::memset(outputs[i], 0, sizeof(float) * partitionSize);
+			}
+		}
+
+		~Stage() {
+			if (level)
+				NonUniformConvolverWorkers::removeJob(level, this);
+
+			pffft_aligned_free(inputAccum);
+			pffft_aligned_free(jobInput);
+			pffft_aligned_free(outputs[0]);
+			pffft_aligned_free(outputs[1]);
+		}
+
+		void run() override {
+			convolver.processBlock(jobInput, jobOutput);
+		}
+
+		/** Finishes the previous job, if any, then hands over the complete input partition. Called from the processing thread. */
+		void startJob(float* output) {
+			// The worker missed its deadline, run the job here, or wait for it if the worker already started it
+			if (!tryRun()) {
+				while (state.load(std::memory_order_acquire) != IDLE)
+					std::this_thread::yield();
+			}
+
+			std::memcpy(jobInput, inputAccum, sizeof(float) * partitionSize);
+			jobOutput = output;
+			state.store(QUEUED, std::memory_order_release);
+			level->condition.notify_one();
+		}
+	};
+	RealTimeConvolver head;
+	std::vector<Stage*> stages;
+	size_t blockSize;
+	/** Number of samples processed since the kernel was set */
+	int64_t position = 0;
+
+	/** `blockSize` is the size of each call to `processBlock()`. It should be >=32 and a power of 2. */
+	NonUniformConvolver(size_t blockSize) : head(blockSize) {
+		this->blockSize = blockSize;
+	}
+
+	~NonUniformConvolver() {
+		setKernel(NULL, 0);
+	}
+
+	/** Must not be called concurrently with `processBlock()`. */
+	void setKernel(const float* kernel, size_t length) {
+		for (Stage* stage : stages) {
+			delete stage;
+		}
+		stages.clear();
+		position = 0;
+
+		if (!kernel || length == 0) {
+			head.setKernel(NULL, 0);
+			return;
+		}
+
+		size_t partitionSize = blockSize * STAGE_GROWTH;
+		size_t offset = std::min(length, 2 * partitionSize);
+		head.setKernel(kernel, offset);
+
+		while (offset < length) {
+			size_t nextPartitionSize = partitionSize * STAGE_GROWTH;
+			size_t end = nextPartitionSize > MAX_PARTITION_SIZE ? length : std::min(length, 2 * nextPartitionSize);
+
+			Stage* stage = new Stage(partitionSize);
+			stage->convolver.setKernel(&kernel[offset], end - offset);
+			stage->level = NonUniformConvolverWorkers::get().addJob(stages.size(), stage);
+			stages.push_back(stage);
+
+			offset = end;
+			partitionSize = nextPartitionSize;
+		}
+	}
+
+	/** Applies the kernel to input
+	input and output must be of size `blockSize`
+	*/
+	void processBlock(const float* input, float* output) {
+		head.processBlock(input, output);
+
+		for (Stage* stage : stages) {
+			const size_t partitionSize = stage->partitionSize;
+			const size_t phase = position % partitionSize;
+			const int64_t partition = position / partitionSize;
+
+			// A full input partition is ready, its result is needed one partition from now
+			if (phase == 0 && partition > 0) {
+				stage->startJob(stage->outputs[(partition - 1) & 1]);
+			}
+
+			const float* stageOutput = &stage->outputs[partition & 1][phase];
+			for (size_t i = 0; i < blockSize; i++) {
+				output[i] += stageOutput[i];
+			}
+			std::memcpy(&stage->inputAccum[phase], input, sizeof(float) * blockSize);
+		}
+
+		position += blockSize;
+	}
+};
+
+
+} // namespace dsp
+} // namespace rack
@@ -0,0 +1,157 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE file.
+ */
+
+#pragma once
+
+#include <cstring>
+
+#include <dsp/common.hpp>
+
+
+namespace rack {
+namespace dsp {
+
+
+/** Polynomial approximations for per-sample level and curve conversions, as replacement for libm calls in process().
+
+Every function has a scalar version and a version for `simd::float_4` and `simd::float_8`, all computing the same thing.
+Errors listed are the maximum measured over the documented input range, in single precision.
+Inputs are not checked for NaN.
+*/
+
+/** Minimax fit of 2^f for f in [0, 1), relative error 7.5e-8 */
+template <typename T>
+inline T fastExp2Fraction(T f) {
+	return 0.999999925f + f * (0.693153073f + f * (0.240153617f + f * (0.0558263181f + f * (0.00898934009f + f * 0.00187757667f))));
+}
+
+/** Minimax fit of log2(1 + t) for 1 + t in [sqrt(1/2), sqrt(2)), absolute error 2.8e-7 */
+template <typename T>
+inline T fastLog2Mantissa(T t) {
+	return 1.32373138e-07f + t * (1.44270064f + t * (-0.721384189f + t * (0.480435498f + t * (-0.358804819f + t * (0.297439166f + t * (-0.273649806f + t * 0.171123905f))))));
+}
+
+
+/** Returns 2^x.
+`x` is clamped to [-126, 127] so the result is always a normal number.
+Max relative error 2e-7.
+*/
+inline float fastExp2(float x) {
+	x = math::clamp(x, -126.f, 127.f);
+	float xi = std::floor(x);
+	int32_t e = ((int32_t) xi + 127) << 23;
+	float scale;
+	std::memcpy(&scale, &e, sizeof(float));
+	return fastExp2Fraction(x - xi) * scale;
+}
+
+template <int N>
+inline simd::Vector<float, N> fastExp2(simd::Vector<float, N> x) {
+	using float_n = simd::Vector<float, N>;
+	using int32_n = simd::Vector<int32_t, N>;
+	x = simd::fmin(simd::fmax(x, -126.f), 127.f);
+	// floor() without SSE4.1, truncate then subtract 1 where that rounded up
+	int32_n i = int32_n(x);
+	i += int32_n::cast(float_n(i) > x);
+	return fastExp2Fraction(x - float_n(i)) * float_n::cast((i + 127) << 23);
+}
+
+
+/** Returns log2(x) for x > 0.
+Values below the smallest normal number are treated as that number.
+Max absolute error 4e-7 for x in [1/2, 2], elsewhere dominated by the rounding of the result, up to 4e-6 near the ends of the float range.
+*/
+inline float fastLog2(float x) {
+	x = std::fmax(x, 1.17549435e-38f);
+	int32_t bits;
+	std::memcpy(&bits, &x, sizeof(float));
+	// Split into exponent and a mantissa in [sqrt(1/2), sqrt(2)), by moving the upper half of [1, 2) down an octave
+	int32_t e = ((bits - 0x3f3504f3) >> 23);
+	// Shift as unsigned, left shifting a negative exponent is undefined
+	bits -= (int32_t) ((uint32_t) e << 23);
+	float m;
+	std::memcpy(&m, &bits, sizeof(float));
+	return (float) e + fastLog2Mantissa(m - 1.f);
+}
+
+template <int N>
+inline simd::Vector<float, N> fastLog2(simd::Vector<float, N> x) {
+	using float_n = simd::Vector<float, N>;
+	using int32_n = simd::Vector<int32_t, N>;
+	x = simd::fmax(x, 1.17549435e-38f);
+	int32_n bits = int32_n::cast(x);
+	// Exponent as a signed value, the shift operators are logical so restore the sign by hand
+	int32_n offset = bits - 0x3f3504f3;
+	int32_n e = (offset >> 23) | ((offset < int32_n(0)) & int32_n(~0x1ff));
+	bits -= e << 23;
+	return float_n(e) + fastLog2Mantissa(float_n::cast(bits) - 1.f);
+}
+
+
+/** Returns 10^(db / 20).
+Max relative error 1e-6 for db in [-120, 120], mostly from the rounding of the scaled input.
+*/
+template <typename T>
+inline T fastDbToGain(T db) {
+	// log2(10) / 20
+	return fastExp2(db * 0.166096404f);
+}
+
+/** Returns 20 * log10(gain).
+Gains below the smallest normal number give about -759 dB.
+Max absolute error 4e-6 dB for gains within +-20 dB, 4e-5 dB over the full range, where results reach about 770 dB and their rounding dominates.
+*/
+template <typename T>
+inline T fastGainToDb(T gain) {
+	// 20 * log10(2)
+	return fastLog2(gain) * 6.02059991f;
+}
+
+/** Returns base^exponent for base > 0.
+Relative error grows with the magnitude of `exponent * log2(base)`, max 2.5e-6 for base in [0.01, 10] and exponent in [-4, 4].
+*/
+template <typename T>
+inline T fastPow(T base, T exponent) {
+	return fastExp2(exponent * fastLog2(base));
+}
+
+/** Returns e^x.
+Same error as fastExp2() plus the rounding of `x * log2(e)`.
+*/
+template <typename T>
+inline T fastExp(T x) {
+	// log2(e)
+	return fastExp2(x * 1.44269504f);
+}
+
+/** Returns tanh(x).
+Max absolute error 1.5e-7.
+*/
+inline float fastTanh(float x) {
+	float e = fastExp(2.f * math::clamp(x, -9.f, 9.f));
+	return (e - 1.f) / (e + 1.f);
+}
+
+template <int N>
+inline simd::Vector<float, N> fastTanh(simd::Vector<float, N> x) {
+	simd::Vector<float, N> e = fastExp(2.f * simd::fmin(simd::fmax(x, -9.f), 9.f));
+	return (e - 1.f) / (e + 1.f);
+}
+
+
+} // namespace dsp
+} // namespace rack
@@ -0,0 +1,161 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE file.
+ */
+
+/**
+ * This file is an edited version of VCVRack's dsp/fft.hpp
+ * Copyright (C) 2016-2021 VCV.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <pffft.h>
+
+#include <dsp/common.hpp>
+
+
+namespace rack {
+namespace dsp {
+
+
+/** Returns a PFFFT setup shared by the whole process for the given size and transform type.
+Setups are created on first use and kept until the process exits, so repeated instantiation does not recompute twiddles.
+The returned setup is never modified after creation, so it can be used by any number of threads at once.
+Must not be called from the audio thread, as it may need to allocate.
+Returns NULL if PFFFT does not support the size.
+*/
+PFFFT_Setup* getSharedPffftSetup(int length, pffft_transform_t transform);
+
+/** Returns an aligned scratch buffer of at least `length` floats, owned by the calling thread.
+The buffer is reused by the next call on the same thread, so it must not be held across calls.
+Growing it allocates, so only call this outside the audio thread or with a length already requested before.
+*/
+float* getThreadScratchBuffer(size_t length);
+
+
+/** Real-valued FFT context.
+Wrapper for [PFFFT](https://bitbucket.org/jpommier/pffft/)
+`length` must be a multiple of 32.
+Buffers must be aligned to 16-byte boundaries. new[] and malloc() do this for you.
+*/
+struct RealFFT {
+	PFFFT_Setup* setup;
+	int length;
+
+	RealFFT(size_t length) {
+		this->length = length;
+		setup = getSharedPffftSetup(length, PFFFT_REAL);
+	}
+
+	/** Performs the real FFT.
+	Input and output must be aligned using the above align* functions.
+	Input is `length` elements. Output is `2*length` elements.
+	Output is arbitrarily ordered for performance reasons.
+	However, this ordering is consistent, so element-wise multiplication with line up with other results, and the inverse FFT will return a correctly ordered result.
+	*/
+	void rfftUnordered(const float* input, float* output) {
+		pffft_transform(setup, input, output, NULL, PFFFT_FORWARD);
+	}
+
+	/** Performs the inverse real FFT.
+	Input is `2*length` elements. Output is `length` elements.
+	Scaling is such that IRFFT(RFFT(x)) = N*x.
+	*/
+	void irfftUnordered(const float* input, float* output) {
+		pffft_transform(setup, input, output, NULL, PFFFT_BACKWARD);
+	}
+
+	/** Slower than the above methods, but returns results in the "canonical" FFT order as follows.
+		output[0] = F(0)
+		output[1] = F(n/2)
+		output[2] = real(F(1))
+		output[3] = imag(F(1))
+		output[4] = real(F(2))
+		output[5] = imag(F(2))
+		...
+		output[length - 2] = real(F(n/2 - 1))
+		output[length - 1] = imag(F(n/2 - 1))
+	*/
+	void rfft(const float* input, float* output) {
+		pffft_transform_ordered(setup, input, output, NULL, PFFFT_FORWARD);
+	}
+
+	void irfft(const float* input, float* output) {
+		pffft_transform_ordered(setup, input, output, NULL, PFFFT_BACKWARD);
+	}
+
+	/** Scales the RFFT so that `scale(IFFT(FFT(x))) = x`.
+	*/
+	void scale(float* x) {
+		float a = 1.f / length;
+		for (int i = 0; i < length; i++) {
+			x[i] *= a;
+		}
+	}
+};
+
+
+struct ComplexFFT {
+	PFFFT_Setup* setup;
+	int length;
+
+	ComplexFFT(size_t length) {
+		this->length = length;
+		setup = getSharedPffftSetup(length, PFFFT_COMPLEX);
+	}
+
+	/** Performs the complex FFT.
+	Input and output must be aligned using the above align* functions.
+	Input is `length` elements. Output is `2*length` elements.
+	Output is arbitrarily ordered for performance reasons.
+	However, this ordering is consistent, so element-wise multiplication with line up with other results, and the inverse FFT will return a correctly ordered result.
+	*/
+	void fftUnordered(const float* input, float* output) {
+		pffft_transform(setup, input, output, NULL, PFFFT_FORWARD);
+	}
+
+	/** Performs the inverse complex FFT.
+	Input is `2*length` elements. Output is `length` elements.
+	Scaling is such that FFT(IFFT(x)) = N*x.
+	*/
+	void ifftUnordered(const float* input, float* output) {
+		pffft_transform(setup, input, output, NULL, PFFFT_BACKWARD);
+	}
+
+	void fft(const float* input, float* output) {
+		pffft_transform_ordered(setup, input, output, NULL, PFFFT_FORWARD);
+	}
+
+	void ifft(const float* input, float* output) {
+		pffft_transform_ordered(setup, input, output, NULL, PFFFT_BACKWARD);
+	}
+
+	void scale(float* x) {
+		float a = 1.f / length;
+		for (int i = 0; i < length; i++) {
+			x[i] *= a;
+		}
+	}
+};
+
+
+} // namespace dsp
+} // namespace rack
@@ -1,6 +1,6 @@
 /*
  * DISTRHO Cardinal Plugin
- * Copyright (C) 2021-2022 Filipe Coelho <falktx@falktx.com>
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -30,6 +30,8 @@
 #include <pffft.h>
 
 #include <dsp/common.hpp>
+#include <dsp/fft.hpp>
+#include <simd/dispatch.hpp>
 
 
 namespace rack {
@@ -38,11 +40,7 @@ namespace dsp {
 
 /** Performs a direct sum convolution */
 inline float convolveNaive(const float* in, const float* kernel, int len) {
-	float y = 0.f;
-	for (int i = 0; i < len; i++) {
-		y += in[len - 1 - i] * kernel[i];
-	}
-	return y;
+	return simd::kernels.convolve(in, kernel, len);
 }
 
 /** Computes the impulse response of a boxcar lowpass filter */
@@ -69,7 +67,7 @@ struct RealTimeConvolver {
 	/** `blockSize` is the size of each FFT block. It should be >=32 and a power of 2. */
 	RealTimeConvolver(size_t blockSize) {
 		this->blockSize = blockSize;
-		pffft = pffft_new_setup(blockSize * 2, PFFFT_REAL);
+		pffft = getSharedPffftSetup(blockSize * 2, PFFFT_REAL);
 		outputTail = (float*) pffft_aligned_malloc(sizeof(float) * blockSize);
 		std::memset(outputTail, 0, blockSize * sizeof(float));
 		tmpBlock = (float*) pffft_aligned_malloc(sizeof(float) * blockSize * 2);
@@ -80,7 +78,6 @@ struct RealTimeConvolver {
 		setKernel(NULL, 0);
 		pffft_aligned_free(outputTail);
 		pffft_aligned_free(tmpBlock);
-		pffft_destroy_setup(pffft);
 	}
 
 	void setKernel(const float* kernel, size_t length) {
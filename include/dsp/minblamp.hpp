@@ -0,0 +1,75 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE file.
+ */
+
+#pragma once
+
+#include <dsp/minblep.hpp>
+
+
+namespace rack {
+namespace dsp {
+
+
+/** Computes the minimum-phase bandlimited ramp (MinBLAMP) residual, the integral of the MinBLEP
+z: number of zero-crossings
+o: oversample factor
+output: must be length `2 * z * o`.
+The output is what must be added to a naive ramp with a slope change of 1 per sample, and settles to 0 at the end.
+Results are cached, so only the first call for each configuration is slow.
+*/
+void minBlampImpulse(int z, int o, float* output);
+
+
+/** Generator for slope discontinuities such as the corners of triangle waves, or hard sync in the middle of a slope.
+Used the same way as MinBlepGenerator, and both can be summed together.
+*/
+template <int Z, int O, typename T = float>
+struct MinBlampGenerator {
+	T buf[2 * Z] = {};
+	int pos = 0;
+	float impulse[2 * Z * O + 1];
+
+	MinBlampGenerator() {
+		minBlampImpulse(Z, O, impulse);
+		impulse[2 * Z * O] = 0.f;
+	}
+
+	/** Places a change of slope of `x` per sample at -1 < p <= 0 relative to the current frame */
+	void insertDiscontinuity(float p, T x) {
+		if (!(-1 < p && p <= 0))
+			return;
+		for (int j = 0; j < 2 * Z; j++) {
+			float minBlampIndex = ((float) j - p) * O;
+			int index = (int) minBlampIndex;
+			float t = minBlampIndex - index;
+			// Linearly interpolate impulse
+			float minBlamp = impulse[index] + (impulse[index + 1] - impulse[index]) * t;
+			buf[(pos + j) % (2 * Z)] += x * minBlamp;
+		}
+	}
+
+	T process() {
+		T v = buf[pos];
+		buf[pos] = T(0);
+		pos = (pos + 1) % (2 * Z);
+		return v;
+	}
+};
+
+
+} // namespace dsp
+} // namespace rack
@@ -1,6 +1,6 @@
 /*
  * DISTRHO Cardinal Plugin
- * Copyright (C) 2021-2022 Filipe Coelho <falktx@falktx.com>
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -186,6 +186,27 @@ struct Port {
 		voltage.store(&voltages[firstChannel]);
 	}
 
+	/** Reads all PORT_MAX_CHANNELS voltages as `PORT_MAX_CHANNELS / T::size` vectors, e.g. two `float_8`.
+	Unused channels are read too, so a whole port can be processed without looping over channel counts.
+	*/
+	template <typename T>
+	void readVoltagesSimd(T* v) const noexcept {
+		for (int c = 0; c < PORT_MAX_CHANNELS; c += T::size) {
+			v[c / T::size] = T::load(&voltages[c]);
+		}
+	}
+
+	/** Writes all PORT_MAX_CHANNELS voltages from `PORT_MAX_CHANNELS / T::size` vectors.
+	The channel count is left as is.
+	*/
+	template <typename T>
+	void writeVoltagesSimd(const T* v) noexcept {
+		for (int c = 0; c < PORT_MAX_CHANNELS; c += T::size) {
+			T voltage = v[c / T::size];
+			voltage.store(&voltages[c]);
+		}
+	}
+
 	/** Sets the number of polyphony channels.
 	Also clears voltages of higher channels.
 	If disconnected, this does nothing (`channels` remains 0).
@@ -0,0 +1,44 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE file.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rack {
+namespace engine {
+
+/** Implemented by modules whose widgets draw state computed in process(), such as meters and scope buffers.
+In the split Mini variant the UI does not process modules, so the DSP side publishes this state
+for the modules of this kind that are on screen.
+*/
+struct VisualStateProvider {
+    virtual ~VisualStateProvider() {}
+
+    /** Called on the DSP side, concurrently with process(), to append the state to send to the UI.
+    Appending nothing means nothing changed since the previous call.
+    */
+    virtual void getVisualState(std::vector<uint8_t>& data) = 0;
+
+    /** Called on the UI side with the data from a getVisualState() call. */
+    virtual void setVisualState(const uint8_t* data, size_t size) = 0;
+};
+
+}
+}
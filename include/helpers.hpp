@@ -36,8 +36,23 @@
 
 namespace rack {
 
+namespace app {
+/** Returns true when module widgets should be deferred, that is, while no UI is attached to the current context. */
+bool shouldDeferModuleWidgetCreation();
+/** Creates a lightweight placeholder for `module`, replaced by the real widget once the rack is shown. */
+ModuleWidget* createDeferredModuleWidget(plugin::Model* model, engine::Module* module);
+/** Replaces all placeholder widgets in the current rack with real ones. */
+void realizeDeferredModuleWidgets();
+}
+
 struct CardinalPluginModelHelper : plugin::Model {
+    /** Set for the few models whose widget must exist for the module to work, even without UI.
+        These get their widget created during engine load, all others wait until the rack is shown.
+    */
+    bool needsWidgetOnEngineLoad = false;
+
     virtual app::ModuleWidget* createModuleWidgetFromEngineLoad(engine::Module* m) = 0;
+    virtual app::ModuleWidget* createModuleWidgetNow(engine::Module* m) = 0;
     virtual void removeCachedModuleWidget(engine::Module* m) = 0;
 };
 
@@ -61,7 +76,6 @@ struct CardinalPluginModel : CardinalPluginModelHelper
 
     app::ModuleWidget* createModuleWidget(engine::Module* const m) override
     {
-        TModule* tm = nullptr;
         if (m)
         {
             DISTRHO_SAFE_ASSERT_RETURN(m->model == this, nullptr);
@@ -70,6 +84,18 @@ struct CardinalPluginModel : CardinalPluginModelHelper
                 widgetNeedsDeletion[m] = false;
                 return widgets[m];
             }
+            if (!needsWidgetOnEngineLoad && app::shouldDeferModuleWidgetCreation())
+                return app::createDeferredModuleWidget(this, m);
+        }
+        return createModuleWidgetNow(m);
+    }
+
+    app::ModuleWidget* createModuleWidgetNow(engine::Module* const m) override
+    {
+        TModule* tm = nullptr;
+        if (m)
+        {
+            DISTRHO_SAFE_ASSERT_RETURN(m->model == this, nullptr);
             tm = dynamic_cast<TModule*>(m);
         }
         app::ModuleWidget* const tmw = new TModuleWidget(tm);
@@ -117,6 +143,14 @@ CardinalPluginModel<TModule, TModuleWidget>* createModel(const std::string slug)
     return new CardinalPluginModel<TModule, TModuleWidget>(slug);
 }
 
+template <class TModule, class TModuleWidget>
+CardinalPluginModel<TModule, TModuleWidget>* createModelWithWidgetOnEngineLoad(const std::string slug)
+{
+    CardinalPluginModel<TModule, TModuleWidget>* const model = new CardinalPluginModel<TModule, TModuleWidget>(slug);
+    model->needsWidgetOnEngineLoad = true;
+    return model;
+}
+
 }
 
 #define createModel createModelOldVCV
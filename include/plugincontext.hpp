@@ -95,6 +95,8 @@ struct CardinalPluginContext : rack::Context {
     CardinalDISTRHO::UI* ui;
     CardinalPluginContext(CardinalDISTRHO::Plugin* const p);
     void writeMidiMessage(const rack::midi::Message& message, uint8_t channel);
+    // to be called from process() by modules that delay their audio, whenever that delay changes
+    void setModuleLatency(rack::engine::Module* module, uint32_t frames);
     bool addIdleCallback(IdleCallback* cb) const;
     void removeIdleCallback(IdleCallback* cb) const;
 };
@@ -1,6 +1,6 @@
 /*
  * DISTRHO Cardinal Plugin
- * Copyright (C) 2021-2023 Filipe Coelho <falktx@falktx.com>
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -29,6 +29,9 @@
 
 #include <cstring>
 #include <pmmintrin.h>
+#ifdef __AVX__
+# include <immintrin.h>
+#endif
 
 /** NOTE alignas is required in some systems in order to allow SSE usage. */
 #define SIMD_ALIGN alignas(16)
@@ -364,11 +367,333 @@ inline Vector<int32_t, 4> operator>>(const Vector<int32_t, 4>& a, const int& b)
 }
 
 
+/** Wrapper for 8 single-precision float values, as used for processing 8 polyphonic channels at once.
+Uses `__m256` when the build enables AVX, otherwise a pair of `float_4` halves so it works everywhere `float_4` does.
+*/
+template <>
+struct Vector<float, 8> {
+	using type = float;
+	constexpr static int size = 8;
+
+	union alignas(32) {
+#ifdef __AVX__
+		__m256 v;
+#endif
+		/** Lower and upper 4 elements. */
+		Vector<float, 4> h[2];
+		/** Accessing this array of scalars is slow and defeats the purpose of vectorizing.
+		*/
+		float s[8];
+	};
+
+	/** Constructs an uninitialized vector. */
+	Vector() = default;
+
+#ifdef __AVX__
+	/** Constructs a vector from a native `__m256` type. */
+	Vector(__m256 v) : v(v) {}
+#endif
+
+	/** Constructs a vector from its lower and upper halves. */
+	Vector(Vector<float, 4> lo, Vector<float, 4> hi) {
+#ifdef __AVX__
+		v = _mm256_setr_m128(lo.v, hi.v);
+#else
+		h[0] = lo;
+		h[1] = hi;
+#endif
+	}
+
+	/** Constructs a vector with all elements set to `x`. */
+	Vector(float x) {
+#ifdef __AVX__
+		v = _mm256_set1_ps(x);
+#else
+		h[0] = h[1] = Vector<float, 4>(x);
+#endif
+	}
+
+	/** Constructs a vector from eight scalars. */
+	Vector(float x1, float x2, float x3, float x4, float x5, float x6, float x7, float x8) {
+#ifdef __AVX__
+		v = _mm256_setr_ps(x1, x2, x3, x4, x5, x6, x7, x8);
+#else
+		h[0] = Vector<float, 4>(x1, x2, x3, x4);
+		h[1] = Vector<float, 4>(x5, x6, x7, x8);
+#endif
+	}
+
+	/** Returns a vector with all 0 bits. */
+	static Vector zero() {
+		return Vector(0.f);
+	}
+
+	/** Returns a vector with all 1 bits. */
+	static Vector mask() {
+		return Vector(Vector<float, 4>::mask(), Vector<float, 4>::mask());
+	}
+
+	/** Reads an array of 8 values. */
+	static Vector load(const float* x) {
+#ifdef __AVX__
+		return Vector(_mm256_loadu_ps(x));
+#else
+		return Vector(Vector<float, 4>::load(x), Vector<float, 4>::load(x + 4));
+#endif
+	}
+
+	/** Writes an array of 8 values. */
+	void store(float* x) {
+#ifdef __AVX__
+		_mm256_storeu_ps(x, v);
+#else
+		h[0].store(x);
+		h[1].store(x + 4);
+#endif
+	}
+
+	/** Accessing vector elements individually is slow and defeats the purpose of vectorizing.
+	However, this operator is convenient when writing simple serial code in a non-bottlenecked section.
+	*/
+	float& operator[](int i) {
+		return s[i];
+	}
+	const float& operator[](int i) const {
+		return s[i];
+	}
+
+	// Conversions
+	Vector(Vector<int32_t, 8> a);
+	// Casts
+	static Vector cast(Vector<int32_t, 8> a);
+};
+
+
+/** Wrapper for 8 int32 values.
+Always a pair of `int32_4` halves, as 256-bit integer operations need AVX2.
+*/
+template <>
+struct Vector<int32_t, 8> {
+	using type = int32_t;
+	constexpr static int size = 8;
+
+	union alignas(32) {
+		Vector<int32_t, 4> h[2];
+		int32_t s[8];
+	};
+
+	Vector() = default;
+	Vector(Vector<int32_t, 4> lo, Vector<int32_t, 4> hi) {
+		h[0] = lo;
+		h[1] = hi;
+	}
+	Vector(int32_t x) {
+		h[0] = h[1] = Vector<int32_t, 4>(x);
+	}
+	Vector(int32_t x1, int32_t x2, int32_t x3, int32_t x4, int32_t x5, int32_t x6, int32_t x7, int32_t x8) {
+		h[0] = Vector<int32_t, 4>(x1, x2, x3, x4);
+		h[1] = Vector<int32_t, 4>(x5, x6, x7, x8);
+	}
+	static Vector zero() {
+		return Vector(0);
+	}
+	static Vector mask() {
+		return Vector(Vector<int32_t, 4>::mask(), Vector<int32_t, 4>::mask());
+	}
+	static Vector load(const int32_t* x) {
+		return Vector(Vector<int32_t, 4>::load(x), Vector<int32_t, 4>::load(x + 4));
+	}
+	void store(int32_t* x) {
+		h[0].store(x);
+		h[1].store(x + 4);
+	}
+	int32_t& operator[](int i) {
+		return s[i];
+	}
+	const int32_t& operator[](int i) const {
+		return s[i];
+	}
+	Vector(Vector<float, 8> a);
+	static Vector cast(Vector<float, 8> a);
+};
+
+
+inline Vector<float, 8>::Vector(Vector<int32_t, 8> a) : Vector(Vector<float, 4>(a.h[0]), Vector<float, 4>(a.h[1])) {}
+
+inline Vector<int32_t, 8>::Vector(Vector<float, 8> a) : Vector(Vector<int32_t, 4>(a.h[0]), Vector<int32_t, 4>(a.h[1])) {}
+
+inline Vector<float, 8> Vector<float, 8>::cast(Vector<int32_t, 8> a) {
+	return Vector(Vector<float, 4>::cast(a.h[0]), Vector<float, 4>::cast(a.h[1]));
+}
+
+inline Vector<int32_t, 8> Vector<int32_t, 8>::cast(Vector<float, 8> a) {
+	return Vector(Vector<int32_t, 4>::cast(a.h[0]), Vector<int32_t, 4>::cast(a.h[1]));
+}
+
+
+/** `a @ b` for 8-wide vectors, applied to each half */
+#define DECLARE_VECTOR8_OPERATOR_INFIX(t, operator) \
+	inline Vector<t, 8> operator(const Vector<t, 8>& a, const Vector<t, 8>& b) { \
+		return Vector<t, 8>(operator(a.h[0], b.h[0]), operator(a.h[1], b.h[1])); \
+	}
+
+#ifdef __AVX__
+/** `a @ b` for 8-wide float vectors, using AVX */
+# define DECLARE_VECTOR8_FLOAT_OPERATOR_INFIX(operator, func) \
+	inline Vector<float, 8> operator(const Vector<float, 8>& a, const Vector<float, 8>& b) { \
+		return Vector<float, 8>(func(a.v, b.v)); \
+	}
+# define DECLARE_VECTOR8_FLOAT_OPERATOR_COMPARE(operator, predicate) \
+	inline Vector<float, 8> operator(const Vector<float, 8>& a, const Vector<float, 8>& b) { \
+		return Vector<float, 8>(_mm256_cmp_ps(a.v, b.v, predicate)); \
+	}
+#else
+# define DECLARE_VECTOR8_FLOAT_OPERATOR_INFIX(operator, func) DECLARE_VECTOR8_OPERATOR_INFIX(float, operator)
+# define DECLARE_VECTOR8_FLOAT_OPERATOR_COMPARE(operator, predicate) DECLARE_VECTOR8_OPERATOR_INFIX(float, operator)
+#endif
+
+DECLARE_VECTOR8_FLOAT_OPERATOR_INFIX(operator+, _mm256_add_ps)
+DECLARE_VECTOR8_OPERATOR_INFIX(int32_t, operator+)
+
+DECLARE_VECTOR8_FLOAT_OPERATOR_INFIX(operator-, _mm256_sub_ps)
+DECLARE_VECTOR8_OPERATOR_INFIX(int32_t, operator-)
+
+DECLARE_VECTOR8_FLOAT_OPERATOR_INFIX(operator*, _mm256_mul_ps)
+
+DECLARE_VECTOR8_FLOAT_OPERATOR_INFIX(operator/, _mm256_div_ps)
+
+DECLARE_VECTOR8_FLOAT_OPERATOR_INFIX(operator^, _mm256_xor_ps)
+DECLARE_VECTOR8_OPERATOR_INFIX(int32_t, operator^)
+
+DECLARE_VECTOR8_FLOAT_OPERATOR_INFIX(operator&, _mm256_and_ps)
+DECLARE_VECTOR8_OPERATOR_INFIX(int32_t, operator&)
+
+DECLARE_VECTOR8_FLOAT_OPERATOR_INFIX(operator|, _mm256_or_ps)
+DECLARE_VECTOR8_OPERATOR_INFIX(int32_t, operator|)
+
+DECLARE_VECTOR_OPERATOR_INCREMENT(float, 8, operator+=, operator+)
+DECLARE_VECTOR_OPERATOR_INCREMENT(int32_t, 8, operator+=, operator+)
+
+DECLARE_VECTOR_OPERATOR_INCREMENT(float, 8, operator-=, operator-)
+DECLARE_VECTOR_OPERATOR_INCREMENT(int32_t, 8, operator-=, operator-)
+
+DECLARE_VECTOR_OPERATOR_INCREMENT(float, 8, operator*=, operator*)
+
+DECLARE_VECTOR_OPERATOR_INCREMENT(float, 8, operator/=, operator/)
+
+DECLARE_VECTOR_OPERATOR_INCREMENT(float, 8, operator^=, operator^)
+DECLARE_VECTOR_OPERATOR_INCREMENT(int32_t, 8, operator^=, operator^)
+
+DECLARE_VECTOR_OPERATOR_INCREMENT(float, 8, operator&=, operator&)
+DECLARE_VECTOR_OPERATOR_INCREMENT(int32_t, 8, operator&=, operator&)
+
+DECLARE_VECTOR_OPERATOR_INCREMENT(float, 8, operator|=, operator|)
+DECLARE_VECTOR_OPERATOR_INCREMENT(int32_t, 8, operator|=, operator|)
+
+// predicates match the SSE comparisons used by the 4-wide operators
+DECLARE_VECTOR8_FLOAT_OPERATOR_COMPARE(operator==, _CMP_EQ_OQ)
+DECLARE_VECTOR8_OPERATOR_INFIX(int32_t, operator==)
+
+DECLARE_VECTOR8_FLOAT_OPERATOR_COMPARE(operator>=, _CMP_GE_OS)
+DECLARE_VECTOR8_OPERATOR_INFIX(int32_t, operator>=)
+
+DECLARE_VECTOR8_FLOAT_OPERATOR_COMPARE(operator>, _CMP_GT_OS)
+DECLARE_VECTOR8_OPERATOR_INFIX(int32_t, operator>)
+
+DECLARE_VECTOR8_FLOAT_OPERATOR_COMPARE(operator<=, _CMP_LE_OS)
+DECLARE_VECTOR8_OPERATOR_INFIX(int32_t, operator<=)
+
+DECLARE_VECTOR8_FLOAT_OPERATOR_COMPARE(operator<, _CMP_LT_OS)
+DECLARE_VECTOR8_OPERATOR_INFIX(int32_t, operator<)
+
+DECLARE_VECTOR8_FLOAT_OPERATOR_COMPARE(operator!=, _CMP_NEQ_UQ)
+DECLARE_VECTOR8_OPERATOR_INFIX(int32_t, operator!=)
+
+#undef DECLARE_VECTOR8_FLOAT_OPERATOR_INFIX
+#undef DECLARE_VECTOR8_FLOAT_OPERATOR_COMPARE
+
+/** `+a` */
+inline Vector<float, 8> operator+(const Vector<float, 8>& a) {
+	return a;
+}
+inline Vector<int32_t, 8> operator+(const Vector<int32_t, 8>& a) {
+	return a;
+}
+
+/** `-a` */
+inline Vector<float, 8> operator-(const Vector<float, 8>& a) {
+	return 0.f - a;
+}
+inline Vector<int32_t, 8> operator-(const Vector<int32_t, 8>& a) {
+	return 0 - a;
+}
+
+/** `++a` */
+inline Vector<float, 8>& operator++(Vector<float, 8>& a) {
+	return a += 1.f;
+}
+inline Vector<int32_t, 8>& operator++(Vector<int32_t, 8>& a) {
+	return a += 1;
+}
+
+/** `--a` */
+inline Vector<float, 8>& operator--(Vector<float, 8>& a) {
+	return a -= 1.f;
+}
+inline Vector<int32_t, 8>& operator--(Vector<int32_t, 8>& a) {
+	return a -= 1;
+}
+
+/** `a++` */
+inline Vector<float, 8> operator++(Vector<float, 8>& a, int) {
+	Vector<float, 8> b = a;
+	++a;
+	return b;
+}
+inline Vector<int32_t, 8> operator++(Vector<int32_t, 8>& a, int) {
+	Vector<int32_t, 8> b = a;
+	++a;
+	return b;
+}
+
+/** `a--` */
+inline Vector<float, 8> operator--(Vector<float, 8>& a, int) {
+	Vector<float, 8> b = a;
+	--a;
+	return b;
+}
+inline Vector<int32_t, 8> operator--(Vector<int32_t, 8>& a, int) {
+	Vector<int32_t, 8> b = a;
+	--a;
+	return b;
+}
+
+/** `~a` */
+inline Vector<float, 8> operator~(const Vector<float, 8>& a) {
+	return a ^ Vector<float, 8>::mask();
+}
+inline Vector<int32_t, 8> operator~(const Vector<int32_t, 8>& a) {
+	return a ^ Vector<int32_t, 8>::mask();
+}
+
+/** `a << b` */
+inline Vector<int32_t, 8> operator<<(const Vector<int32_t, 8>& a, const int& b) {
+	return Vector<int32_t, 8>(a.h[0] << b, a.h[1] << b);
+}
+
+/** `a >> b` */
+inline Vector<int32_t, 8> operator>>(const Vector<int32_t, 8>& a, const int& b) {
+	return Vector<int32_t, 8>(a.h[0] >> b, a.h[1] >> b);
+}
+
+
 // Typedefs
 
 
 using float_4 = Vector<float, 4>;
 using int32_4 = Vector<int32_t, 4>;
+using float_8 = Vector<float, 8>;
+using int32_8 = Vector<int32_t, 8>;
 
 
 } // namespace simd
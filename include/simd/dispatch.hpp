@@ -0,0 +1,39 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+
+namespace rack {
+namespace simd {
+
+
+/** Hot DSP kernels over long buffers, compiled for several instruction sets.
+The build targets SSE3 so a single binary runs everywhere, on x86-64 the best variant supported by the running CPU is selected at startup.
+Until then, and on other architectures, the baseline variant is used.
+Variants may sum in a different order, so results can differ from the baseline by rounding.
+Small fixed-size loops, such as those over port channels, stay inline as the indirect call would cost more than it saves.
+*/
+struct Kernels {
+	/** Returns the sum of `in[len - 1 - i] * kernel[i]`, as in dsp::convolveNaive(). */
+	float (*convolve)(const float* in, const float* kernel, int len);
+	/** Returns the sum of `a[i] * b[i]`. */
+	float (*dot)(const float* a, const float* b, int len);
+	/** Name of the instruction set the variant was built for. */
+	const char* name;
+};
+
+/** Kernels selected for the running CPU. */
+extern Kernels kernels;
+
+/** Returns all variants the running CPU supports, the baseline first.
+Meant for comparing variants against each other.
+*/
+const Kernels* const* getSupportedKernels(int* count);
+
+
+} // namespace simd
+} // namespace rack
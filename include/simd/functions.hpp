@@ -8,5 +8,91 @@
 
 #include "simd/common.hpp"
 #include_next "simd/functions.hpp"
+
+namespace rack {
+namespace simd {
+
+
+// 8-wide variants of the float_4 functions, applied to each half unless AVX has a direct equivalent
+
+#define DECLARE_VECTOR8_FUNCTION_UNARY(name) \
+	inline float_8 name(float_8 a) { \
+		return float_8(name(a.h[0]), name(a.h[1])); \
+	}
+
+#define DECLARE_VECTOR8_FUNCTION_BINARY(name) \
+	inline float_8 name(float_8 a, float_8 b) { \
+		return float_8(name(a.h[0], b.h[0]), name(a.h[1], b.h[1])); \
+	}
+
+/** `~a & b` */
+#ifdef __AVX__
+inline float_8 andnot(float_8 a, float_8 b) {
+	return float_8(_mm256_andnot_ps(a.v, b.v));
+}
+#else
+DECLARE_VECTOR8_FUNCTION_BINARY(andnot)
+#endif
+
+inline int movemask(float_8 a) {
+	return movemask(a.h[0]) | (movemask(a.h[1]) << 4);
+}
+
+inline int movemask(int32_8 a) {
+	return movemask(a.h[0]) | (movemask(a.h[1]) << 4);
+}
+
+DECLARE_VECTOR8_FUNCTION_UNARY(rsqrt)
+DECLARE_VECTOR8_FUNCTION_UNARY(rcp)
+
+/** Given a mask, returns a if mask is 0xffffffff per element, b if mask is 0x00000000 */
+inline float_8 ifelse(float_8 mask, float_8 a, float_8 b) {
+	return (a & mask) | andnot(mask, b);
+}
+
+#ifdef __AVX__
+inline float_8 fmax(float_8 a, float_8 b) {
+	return float_8(_mm256_max_ps(a.v, b.v));
+}
+inline float_8 fmin(float_8 a, float_8 b) {
+	return float_8(_mm256_min_ps(a.v, b.v));
+}
+inline float_8 sqrt(float_8 a) {
+	return float_8(_mm256_sqrt_ps(a.v));
+}
+#else
+DECLARE_VECTOR8_FUNCTION_BINARY(fmax)
+DECLARE_VECTOR8_FUNCTION_BINARY(fmin)
+DECLARE_VECTOR8_FUNCTION_UNARY(sqrt)
+#endif
+
+DECLARE_VECTOR8_FUNCTION_UNARY(log)
+DECLARE_VECTOR8_FUNCTION_UNARY(log10)
+DECLARE_VECTOR8_FUNCTION_UNARY(log2)
+DECLARE_VECTOR8_FUNCTION_UNARY(exp)
+DECLARE_VECTOR8_FUNCTION_UNARY(sin)
+DECLARE_VECTOR8_FUNCTION_UNARY(cos)
+DECLARE_VECTOR8_FUNCTION_UNARY(floor)
+DECLARE_VECTOR8_FUNCTION_UNARY(ceil)
+DECLARE_VECTOR8_FUNCTION_UNARY(round)
+DECLARE_VECTOR8_FUNCTION_BINARY(fmod)
+DECLARE_VECTOR8_FUNCTION_UNARY(fabs)
+DECLARE_VECTOR8_FUNCTION_BINARY(pow)
+DECLARE_VECTOR8_FUNCTION_UNARY(sgn)
+
+inline float_8 pow(float a, float_8 b) {
+	return float_8(pow(a, b.h[0]), pow(a, b.h[1]));
+}
+
+inline float_8 clamp(float_8 x, float_8 a = 0.f, float_8 b = 1.f) {
+	return fmin(fmax(x, a), b);
+}
+
+#undef DECLARE_VECTOR8_FUNCTION_UNARY
+#undef DECLARE_VECTOR8_FUNCTION_BINARY
+
+
+} // namespace simd
+} // namespace rack
 // #undef SIMDE_MM_FROUND_NO_EXC
 // #undef _MM_FROUND_NO_EXC
@@ -21,6 +21,23 @@
 
 // -----------------------------------------------------------------------
 
+// first channel keeps the plain symbol, so mono ports stay compatible with older exports
+static void printPortSymbol(const char* const prefix, const int number, const int channel)
+{
+    if (channel == 0)
+        d_stdout("        lv2:symbol \"%s_%d\" ;", prefix, number);
+    else
+        d_stdout("        lv2:symbol \"%s_%d_%d\" ;", prefix, number, channel + 1);
+}
+
+static void printPortName(const std::string& name, const int channels, const int channel)
+{
+    if (channels == 1)
+        d_stdout("        lv2:name \"%s\" ;", name.c_str());
+    else
+        d_stdout("        lv2:name \"%s %d\" ;", name.c_str(), channel + 1);
+}
+
 DISTRHO_PLUGIN_EXPORT
 void lv2_generate_ttl()
 {
@@ -47,60 +64,81 @@ void lv2_generate_ttl()
 
     for (int i=0, numAudio=0, numCV=0; i<module->getNumInputs(); ++i)
     {
-        d_stdout("    lv2:port [");
+        const std::string name = module->getInputInfo(i)->getFullName();
+
         if (kCvInputs[i])
+            ++numCV;
+        else
+            ++numAudio;
+
+        for (int c=0; c<getInputChannels(i); ++c)
         {
-            d_stdout("        a lv2:InputPort, lv2:CVPort, mod:CVPort ;");
-            d_stdout("        lv2:symbol \"lv2_cv_in_%d\" ;", ++numCV);
-            if (kCvOutputs[i] == Bi)
+            d_stdout("    lv2:port [");
+            if (kCvInputs[i])
             {
-                d_stdout("        lv2:minimum -5.0 ;");
-                d_stdout("        lv2:maximum 5.0 ;");
+                d_stdout("        a lv2:InputPort, lv2:CVPort, mod:CVPort ;");
+                printPortSymbol("lv2_cv_in", numCV, c);
+                d_stdout("        lv2:portProperty lv2:connectionOptional ;");
+                if (kCvInputs[i] == Bi)
+                {
+                    d_stdout("        lv2:minimum -5.0 ;");
+                    d_stdout("        lv2:maximum 5.0 ;");
+                }
+                else
+                {
+                    d_stdout("        lv2:minimum 0.0 ;");
+                    d_stdout("        lv2:maximum 10.0 ;");
+                }
             }
             else
             {
-                d_stdout("        lv2:minimum 0.0 ;");
-                d_stdout("        lv2:maximum 10.0 ;");
+                d_stdout("        a lv2:InputPort, lv2:AudioPort ;");
+                printPortSymbol("lv2_audio_in", numAudio, c);
             }
+            printPortName(name, getInputChannels(i), c);
+            d_stdout("        lv2:index %d ;", index++);
+            d_stdout("    ] ;");
+            d_stdout("");
         }
-        else
-        {
-            d_stdout("        a lv2:InputPort, lv2:AudioPort ;");
-            d_stdout("        lv2:symbol \"lv2_audio_in_%d\" ;", ++numAudio);
-        }
-        d_stdout("        lv2:name \"%s\" ;", module->getInputInfo(i)->getFullName().c_str());
-        d_stdout("        lv2:index %d ;", index++);
-        d_stdout("    ] ;");
-        d_stdout("");
     }
 
     for (int i=0, numAudio=0, numCV=0; i<module->getNumOutputs(); ++i)
     {
-        d_stdout("    lv2:port [");
+        const std::string name = module->getOutputInfo(i)->getFullName();
+
         if (kCvOutputs[i])
+            ++numCV;
+        else
+            ++numAudio;
+
+        for (int c=0; c<getOutputChannels(i); ++c)
         {
-            d_stdout("        a lv2:OutputPort, lv2:CVPort, mod:CVPort ;");
-            d_stdout("        lv2:symbol \"lv2_cv_out_%d\" ;", ++numCV);
-            if (kCvOutputs[i] == Bi)
+            d_stdout("    lv2:port [");
+            if (kCvOutputs[i])
             {
-                d_stdout("        lv2:minimum -5.0 ;");
-                d_stdout("        lv2:maximum 5.0 ;");
+                d_stdout("        a lv2:OutputPort, lv2:CVPort, mod:CVPort ;");
+                printPortSymbol("lv2_cv_out", numCV, c);
+                if (kCvOutputs[i] == Bi)
+                {
+                    d_stdout("        lv2:minimum -5.0 ;");
+                    d_stdout("        lv2:maximum 5.0 ;");
+                }
+                else
+                {
+                    d_stdout("        lv2:minimum 0.0 ;");
+                    d_stdout("        lv2:maximum 10.0 ;");
+                }
             }
             else
             {
-                d_stdout("        lv2:minimum 0.0 ;");
-                d_stdout("        lv2:maximum 10.0 ;");
+                d_stdout("        a lv2:OutputPort, lv2:AudioPort ;");
+                printPortSymbol("lv2_audio_out", numAudio, c);
             }
+            printPortName(name, getOutputChannels(i), c);
+            d_stdout("        lv2:index %d ;", index++);
+            d_stdout("    ] ;");
+            d_stdout("");
         }
-        else
-        {
-            d_stdout("        a lv2:OutputPort, lv2:AudioPort ;");
-            d_stdout("        lv2:symbol \"lv2_audio_out_%d\" ;", ++numAudio);
-        }
-        d_stdout("        lv2:name \"%s\" ;", module->getOutputInfo(i)->getFullName().c_str());
-        d_stdout("        lv2:index %d ;", index++);
-        d_stdout("    ] ;");
-        d_stdout("");
     }
 
     for (int i=0; i<module->getNumParams(); ++i)
@@ -52,13 +52,50 @@ Xoroshiro128Plus& local() {
 
 }
 
+// frames processed per chunk, inputs are converted a whole chunk at a time
+static constexpr const uint32_t kChunkSize = 128;
+
+static inline void scaleBuffer(float* const __restrict out, const float* const __restrict in, const float scale, const uint32_t frames)
+{
+    for (uint32_t s=0; s<frames; ++s)
+        out[s] = in[s] * scale;
+}
+
+static inline void scaleBufferInPlace(float* const buffer, const float scale, const uint32_t frames)
+{
+    for (uint32_t s=0; s<frames; ++s)
+        buffer[s] *= scale;
+}
+
+static inline bool isBufferConstant(const float* const buffer, const uint32_t frames)
+{
+    const float first = buffer[0];
+
+    for (uint32_t s=1; s<frames; ++s)
+    {
+        if (buffer[s] != first)
+            return false;
+    }
+
+    return true;
+}
+
 struct PluginLv2 {
     Context context;
     engine::Module* module;
     int frameCount = 0;
     int numInputs, numOutputs, numParams, numLights;
+    // LV2 ports for inputs and outputs, one per channel
+    int numInputPorts, numOutputPorts;
     void** ports;
 
+    // scaled voltages of the inputs that change within the current chunk, and where they go
+    float* inputBuffers;
+    float** inputTargets;
+    // output voltages and the LV2 buffers they go into
+    const float** outputSources;
+    float** outputTargets;
+
     PluginLv2(double sr)
     {
         rack::random::Xoroshiro128Plus& rng(rack::random::local());
@@ -84,31 +121,40 @@ struct PluginLv2 {
         numOutputs = module->getNumOutputs();
         numParams = module->getNumParams();
         numLights = module->getNumLights();
-        ports = new void*[numInputs+numOutputs+numParams+numLights];
+
+        numInputPorts = 0;
+        for (int i=0; i<numInputs; ++i)
+            numInputPorts += getInputChannels(i);
+
+        numOutputPorts = 0;
+        for (int i=0; i<numOutputs; ++i)
+            numOutputPorts += getOutputChannels(i);
+
+        ports = new void*[numInputPorts+numOutputPorts+numParams+numLights]();
+        inputBuffers = new float[numInputPorts*kChunkSize];
+        inputTargets = new float*[numInputPorts];
+        outputSources = new const float*[numOutputPorts];
+        outputTargets = new float*[numOutputPorts];
 
         Module::SampleRateChangeEvent e = { context._engine.sampleRate, 1.0f / context._engine.sampleRate };
         module->onSampleRateChange(e);
 
-        // FIXME for CV ports we need to detect if something is connected
-        for (int i=numInputs; --i >=0;)
-        {
-            // if (!kCvInputs[i])
-            module->inputs[i].channels = 1;
-        }
+        // inputs are connected or not depending on their LV2 port, see updateInputConnections()
         for (int i=numOutputs; --i >=0;)
-        {
-            // if (!kCvOutputs[i])
-            module->outputs[i].channels = 1;
-        }
+            module->outputs[i].channels = getOutputChannels(i);
 
         d_stdout("Loaded " SLUG " :: %i inputs, %i outputs, %i params and %i lights",
                  numInputs, numOutputs, numParams, numLights);
     }
 
-    PluginLv2()
+    ~PluginLv2()
     {
         contextSet(&context);
         delete[] ports;
+        delete[] inputBuffers;
+        delete[] inputTargets;
+        delete[] outputSources;
+        delete[] outputTargets;
         delete module;
     }
 
@@ -117,6 +163,56 @@ struct PluginLv2 {
         ports[port] = dataLocation;
     }
 
+    // inputs without a host buffer are disconnected, so modules fall back to their normalled values
+    void updateInputConnections()
+    {
+        for (int i=0, p=0; i<numInputs; p += getInputChannels(i++))
+        {
+            Input& input(module->inputs[i]);
+            const uint8_t channels = ports[p] != nullptr ? getInputChannels(i) : 0;
+
+            if (input.channels == channels)
+                continue;
+
+            if (channels == 0)
+                std::memset(input.voltages, 0, sizeof(input.voltages));
+
+            input.channels = channels;
+        }
+    }
+
+    // converts the inputs of a chunk, constant ones are written once instead of on every frame.
+    // returns the number of inputs that need to be updated on every frame.
+    int prepareInputs(const uint32_t offset, const uint32_t frames)
+    {
+        int numVarying = 0;
+
+        for (int i=0, p=0; i<numInputs; ++i)
+        {
+            const float scale = kCvInputs[i] ? 1.0f : 10.0f;
+            float* const voltages = module->inputs[i].voltages;
+
+            for (int c=0; c<getInputChannels(i); ++c, ++p)
+            {
+                const float* const in = static_cast<const float*>(ports[p]);
+
+                if (in == nullptr)
+                    continue;
+
+                if (isBufferConstant(in + offset, frames))
+                {
+                    voltages[c] = in[offset] * scale;
+                    continue;
+                }
+
+                scaleBuffer(inputBuffers + numVarying * kChunkSize, in + offset, scale, frames);
+                inputTargets[numVarying++] = &voltages[c];
+            }
+        }
+
+        return numVarying;
+    }
+
     void lv2_run(const uint32_t sampleCount)
     {
         if (sampleCount == 0)
@@ -127,33 +223,55 @@ struct PluginLv2 {
         Module::ProcessArgs args = { context._engine.sampleRate, 1.0f / context._engine.sampleRate, frameCount };
 
         for (int i=numParams; --i >=0;)
-            module->params[i].setValue(*static_cast<const float*>(ports[numInputs+numOutputs+i]));
+            module->params[i].setValue(*static_cast<const float*>(ports[numInputPorts+numOutputPorts+i]));
 
-        for (uint32_t s=0; s<sampleCount; ++s)
+        updateInputConnections();
+
+        int numConnectedOutputs = 0;
+        for (int i=0, p=numInputPorts; i<numOutputs; ++i)
         {
-            for (int i=numInputs; --i >=0;)
+            for (int c=0; c<getOutputChannels(i); ++c, ++p)
             {
-                if (kCvInputs[i])
-                    module->inputs[i].setVoltage(static_cast<const float*>(ports[i])[s]);
-                else
-                    module->inputs[i].setVoltage(static_cast<const float*>(ports[i])[s] * 10.0f);
+                if (ports[p] == nullptr)
+                    continue;
+
+                outputSources[numConnectedOutputs] = &module->outputs[i].voltages[c];
+                outputTargets[numConnectedOutputs] = static_cast<float*>(ports[p]);
+                ++numConnectedOutputs;
             }
+        }
 
-            module->doProcess(args);
+        for (uint32_t offset=0; offset<sampleCount; offset += kChunkSize)
+        {
+            const uint32_t frames = std::min(sampleCount - offset, kChunkSize);
+            const int numVarying = prepareInputs(offset, frames);
 
-            for (int i=numOutputs; --i >=0;)
+            for (uint32_t s=0; s<frames; ++s)
             {
-                if (kCvOutputs[i])
-                    static_cast<float*>(ports[numInputs+i])[s] = module->outputs[i].getVoltage();
-                else
-                    static_cast<float*>(ports[numInputs+i])[s] = module->outputs[i].getVoltage() * 0.1f;
+                for (int i=0; i<numVarying; ++i)
+                    *inputTargets[i] = inputBuffers[i * kChunkSize + s];
+
+                module->doProcess(args);
+
+                for (int i=0; i<numConnectedOutputs; ++i)
+                    outputTargets[i][offset + s] = *outputSources[i];
+
+                ++args.frame;
             }
+        }
 
-            ++args.frame;
+        // voltages were written as-is, bring audio outputs into range for the whole buffer at once
+        for (int i=0, p=numInputPorts; i<numOutputs; ++i)
+        {
+            for (int c=0; c<getOutputChannels(i); ++c, ++p)
+            {
+                if (ports[p] != nullptr && ! kCvOutputs[i])
+                    scaleBufferInPlace(static_cast<float*>(ports[p]), 0.1f, sampleCount);
+            }
         }
 
         for (int i=numLights; --i >=0;)
-            *static_cast<float*>(ports[numInputs+numOutputs+numParams+i]) = module->lights[i].getBrightness();
+            *static_cast<float*>(ports[numInputPorts+numOutputPorts+numParams+i]) = module->lights[i].getBrightness();
 
         frameCount += sampleCount;
     }
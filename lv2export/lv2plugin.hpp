@@ -45,3 +45,20 @@ enum PortType {
 
 static constexpr const PortType kCvInputs[] = PLUGIN_CV_INPUTS;
 static constexpr const PortType kCvOutputs[] = PLUGIN_CV_OUTPUTS;
+
+// Optional number of channels per port, each channel is exposed as its own LV2 port.
+// Meant for polyphonic CV, ports not listed are mono.
+
+#ifdef PLUGIN_INPUT_CHANNELS
+static constexpr const uint8_t kInputChannels[] = PLUGIN_INPUT_CHANNELS;
+static constexpr uint8_t getInputChannels(const int index) { return kInputChannels[index]; }
+#else
+static constexpr uint8_t getInputChannels(int) { return 1; }
+#endif
+
+#ifdef PLUGIN_OUTPUT_CHANNELS
+static constexpr const uint8_t kOutputChannels[] = PLUGIN_OUTPUT_CHANNELS;
+static constexpr uint8_t getOutputChannels(const int index) { return kOutputChannels[index]; }
+#else
+static constexpr uint8_t getOutputChannels(int) { return 1; }
+#endif
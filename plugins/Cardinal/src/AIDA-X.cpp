@@ -6,8 +6,12 @@
  */
 
 #include "plugin.hpp"
+#include "plugincontext.hpp"
 #include "ModuleWidgets.hpp"
 
+#include <dsp/biquadbank.hpp>
+#include <dsp/fastmath.hpp>
+
 #ifndef HEADLESS
 # include "ImGuiWidget.hpp"
 # include "ghc/filesystem.hpp"
@@ -16,17 +20,20 @@
 // #define QUICK_BUILD_TESTING
 
 #ifndef QUICK_BUILD_TESTING
-# include "extra/Sleep.hpp"
+# include "extra/Mutex.hpp"
+# include "extra/Thread.hpp"
+# include "../../src/extra/SharedResourcePointer.hpp"
 # include "AIDA-X/Biquad.cpp"
 # include "AIDA-X/model_variant.hpp"
+# include <unordered_map>
 
 template class RTNeural::Model<float>;
 template class RTNeural::Layer<float>;
 
 // --------------------------------------------------------------------------------------------------------------------
 
-/* Define a constexpr for converting a gain in dB to a coefficient */
-static constexpr float DB_CO(const float g) { return g > -90.f ? std::pow(10.f, g * 0.05f) : 0.f; }
+/* Define a function for converting a gain in dB to a coefficient */
+static inline float DB_CO(const float g) { return g > -90.f ? rack::dsp::fastDbToGain(g) : 0.f; }
 
 /* Define a macro to re-maps a number from one range to another  */
 static constexpr float MAP(const float x, const float in_min, const float in_max, const float out_min, const float out_max)
@@ -39,6 +46,19 @@ static constexpr const float COMMON_Q = 0.707f;
 static constexpr const float DEPTH_FREQ = 75.f;
 static constexpr const float PRESENCE_FREQ = 900.f;
 
+/* Defines for running models at their training sample rate */
+static constexpr const float DEFAULT_MODEL_SAMPLERATE = 48000.f;
+static constexpr const uint RESAMPLER_TAPS = 48; /* Taps per polyphase branch */
+
+/* Defines for model changes */
+static constexpr const uint32_t MODEL_CROSSFADE_FRAMES = 1024;
+static constexpr const int MAX_RETIRED_MODELS = 8;
+static constexpr const uint MODEL_WORKER_INTERVAL_MS = 20;
+
+/* Defines for the binary model format */
+static constexpr const char BINARY_MODEL_MAGIC[8] = { 'A', 'I', 'D', 'A', 'X', 'B', 'I', 'N' };
+static constexpr const uint32_t BINARY_MODEL_VERSION = 1;
+
 /* Defines for antialiasing filter */
 static constexpr const float INLPF_MAX_CO = 0.99f * 0.5f; /* coeff * ((samplerate / 2) / samplerate) */
 static constexpr const float INLPF_MIN_CO = 0.25f * 0.5f; /* coeff * ((samplerate / 2) / samplerate) */
@@ -50,6 +70,146 @@ struct DynamicModel {
     bool input_skip; /* Means the model has been trained with first input element skipped to the output */
     float input_gain;
     float output_gain;
+    float samplerate; /* Sample rate used during training */
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Compact binary model, a fixed header followed by raw little-endian float weights.
+// Weights use the same order and layout as the json "weights" arrays, that is:
+// rnn kernel [input][gates * hidden], rnn recurrent kernel [hidden][gates * hidden],
+// rnn bias [2][3 * hidden] for GRU or [4 * hidden] for LSTM, dense kernel [hidden][1] and dense bias [1]
+
+enum BinaryModelLayerType : uint32_t {
+    kBinaryModelGRU,
+    kBinaryModelLSTM
+};
+
+struct BinaryModelHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t layerType;
+    uint32_t inputSize;
+    uint32_t hiddenSize;
+    uint32_t inputSkip;
+    float inputGain; /* dB */
+    float outputGain; /* dB */
+    float samplerate;
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Parsed models are shared by all instances that load the same file contents, keyed by the contents themselves
+
+struct AidaModelCache {
+    Mutex mutex;
+    std::unordered_map<std::string, std::weak_ptr<const DynamicModel>> models;
+};
+
+static AidaModelCache& getAidaModelCache()
+{
+    static AidaModelCache cache;
+    return cache;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Polyphase decimator and interpolator for integer ratios, using a Kaiser-windowed sinc lowpass kernel.
+// The cutoff sits at the lower nyquist, which makes the kernel halfband for a ratio of 2.
+// With 48 taps per phase the transition band is about 4kHz wide for a lower rate of 44.1 or 48kHz,
+// so the response is flat to 20kHz (0.005dB ripple) and anything that would alias or image into it is rejected by 69dB.
+// Decimating and then interpolating delays the signal by RATIO * (TAPS - 1) samples at the higher rate.
+
+template<uint RATIO, uint TAPS>
+struct PolyphaseResampler {
+    static constexpr const uint kKernelSize = RATIO * TAPS;
+    static constexpr const uint kLatency = RATIO * (TAPS - 1);
+
+    float kernel[kKernelSize];
+    float phaseKernels[RATIO][TAPS];
+    float decimatorBuffer[kKernelSize * 2];
+    float interpolatorBuffer[TAPS * 2];
+    uint decimatorIndex;
+    uint interpolatorIndex;
+
+    PolyphaseResampler()
+    {
+        const double cutoff = 0.5 / RATIO;
+        const double beta = 6.76; /* 0.1102 * (70dB - 8.7) */
+        const double window0 = besselI0(beta);
+        double sum = 0.0;
+
+        for (uint i=0; i<kKernelSize; ++i)
+        {
+            const double t = i - (kKernelSize - 1) * 0.5;
+            const double x = 2.0 * i / (kKernelSize - 1) - 1.0;
+            const double sinc = d_isZero(t) ? 2.0 * cutoff : std::sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+            const double window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - x * x))) / window0;
+            kernel[i] = sinc * window;
+            sum += kernel[i];
+        }
+
+        // unity gain at DC
+        for (uint i=0; i<kKernelSize; ++i)
+            kernel[i] /= sum;
+
+        // interpolator phases, ordered oldest to newest input and scaled for the zero-stuffed samples
+        for (uint p=0; p<RATIO; ++p)
+            for (uint j=0; j<TAPS; ++j)
+                phaseKernels[p][TAPS - 1 - j] = kernel[p + j * RATIO] * RATIO;
+
+        reset();
+    }
+
+    void reset()
+    {
+        std::memset(decimatorBuffer, 0, sizeof(decimatorBuffer));
+        std::memset(interpolatorBuffer, 0, sizeof(interpolatorBuffer));
+        decimatorIndex = interpolatorIndex = 0;
+    }
+
+    // consumes RATIO samples, returns 1
+    float decimate(const float* const in)
+    {
+        for (uint i=0; i<RATIO; ++i)
+        {
+            decimatorBuffer[decimatorIndex] = decimatorBuffer[decimatorIndex + kKernelSize] = in[i];
+
+            if (++decimatorIndex == kKernelSize)
+                decimatorIndex = 0;
+        }
+
+        // the kernel is symmetric, so history order does not matter here
+        const float* const history = decimatorBuffer + decimatorIndex;
+
+        return simd::kernels.dot(kernel, history, kKernelSize);
+    }
+
+    // consumes 1 sample, writes RATIO
+    void interpolate(const float in, float* const out)
+    {
+        interpolatorBuffer[interpolatorIndex] = interpolatorBuffer[interpolatorIndex + TAPS] = in;
+
+        if (++interpolatorIndex == TAPS)
+            interpolatorIndex = 0;
+
+        // oldest to newest
+        const float* const history = interpolatorBuffer + interpolatorIndex;
+
+        for (uint p=0; p<RATIO; ++p)
+            out[p] = simd::kernels.dot(phaseKernels[p], history, TAPS);
+    }
+
+private:
+    static double besselI0(const double x)
+    {
+        double sum = 1.0, term = 1.0;
+
+        for (int k=1; k<50 && term > sum * 1e-12; ++k)
+        {
+            term *= (x * x) / (4.0 * k * k);
+            sum += term;
+        }
+
+        return sum;
+    }
 };
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -146,64 +306,553 @@ void applyModelOffline(DynamicModel* model, float* const out, uint32_t numSample
 }
 
 static inline
-float applyModel(DynamicModel* model, float sample, const float param1, const float param2)
+void applyModel(const DynamicModel* model, ModelVariantType& variant, float* const out, uint32_t numSamples,
+                const float param1, const float param2)
 {
     const bool input_skip = model->input_skip;
     const float input_gain = model->input_gain;
     const float output_gain = model->output_gain;
 
-    sample *= input_gain;
-
     std::visit(
-        [&sample, input_skip, output_gain, param1, param2] (auto&& custom_model)
+        [out, numSamples, input_skip, input_gain, output_gain, param1, param2] (auto&& custom_model)
         {
             using ModelType = std::decay_t<decltype (custom_model)>;
 
-            if constexpr (ModelType::input_size == 1)
-            {
-                float* out = &sample;
-                if (input_skip)
-                {
-                    sample += custom_model.forward(out);
-                    sample *= output_gain;
-                }
-                else
-                {
-                    sample = custom_model.forward(out) * output_gain;
-                }
-            }
-            else if constexpr (ModelType::input_size == 2)
+            if constexpr (ModelType::input_size != 0)
             {
-                float inArray1 alignas(RTNEURAL_DEFAULT_ALIGNMENT)[2] = {sample, param1};
+                float inArray alignas(RTNEURAL_DEFAULT_ALIGNMENT)[ModelType::input_size];
+
+                if constexpr (ModelType::input_size > 1)
+                    inArray[1] = param1;
+                if constexpr (ModelType::input_size > 2)
+                    inArray[2] = param2;
+
                 if (input_skip)
                 {
-                    sample += custom_model.forward(inArray1);
-                    sample *= output_gain;
+                    for (uint32_t i=0; i<numSamples; ++i)
+                    {
+                        inArray[0] = out[i] * input_gain;
+                        out[i] = (inArray[0] + custom_model.forward(inArray)) * output_gain;
+                    }
                 }
                 else
                 {
-                    sample = custom_model.forward(inArray1) * output_gain;
+                    for (uint32_t i=0; i<numSamples; ++i)
+                    {
+                        inArray[0] = out[i] * input_gain;
+                        out[i] = custom_model.forward(inArray) * output_gain;
+                    }
                 }
             }
-            else if constexpr (ModelType::input_size == 3)
+        },
+        variant
+    );
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Model file handling, these functions throw on failure
+
+static float getModelSampleRate(nlohmann::json& model_json)
+{
+    if (model_json["samplerate"].is_number())
+        return model_json["samplerate"].get<float>();
+
+    if (model_json["metadata"].is_object() && model_json["metadata"]["samplerate"].is_number())
+        return model_json["metadata"]["samplerate"].get<float>();
+
+    return DEFAULT_MODEL_SAMPLERATE;
+}
+
+static void flattenModelWeights(const nlohmann::json& weights_json, std::vector<float>& weights)
+{
+    if (weights_json.is_array())
+    {
+        for (const nlohmann::json& value : weights_json)
+            flattenModelWeights(value, weights);
+    }
+    else
+    {
+        weights.push_back(weights_json.get<float>());
+    }
+}
+
+static std::string writeBinaryModel(nlohmann::json& model_json)
+{
+    const nlohmann::json& layers = model_json.at("layers");
+
+    if (layers.size() != 2 || layers.at(1).at("type").get<std::string>() != "dense")
+        throw std::invalid_argument("Only single recurrent layer models can be converted");
+
+    const std::string layerType = layers.at(0).at("type").get<std::string>();
+
+    BinaryModelHeader header = {};
+    std::memcpy(header.magic, BINARY_MODEL_MAGIC, sizeof(header.magic));
+    header.version = BINARY_MODEL_VERSION;
+
+    if (layerType == "gru")
+        header.layerType = kBinaryModelGRU;
+    else if (layerType == "lstm")
+        header.layerType = kBinaryModelLSTM;
+    else
+        throw std::invalid_argument("Unsupported recurrent layer type");
+
+    header.inputSize = model_json.at("in_shape").back().get<uint32_t>();
+    header.hiddenSize = layers.at(0).at("shape").back().get<uint32_t>();
+    header.inputSkip = model_json["in_skip"].is_number() ? model_json["in_skip"].get<uint32_t>() : 0;
+    header.inputGain = model_json["in_gain"].is_number() ? model_json["in_gain"].get<float>() : 0.f;
+    header.outputGain = model_json["out_gain"].is_number() ? model_json["out_gain"].get<float>() : 0.f;
+    header.samplerate = getModelSampleRate(model_json);
+
+    const uint32_t cols = (header.layerType == kBinaryModelGRU ? 3 : 4) * header.hiddenSize;
+    const uint32_t biasRows = header.layerType == kBinaryModelGRU ? 2 : 1;
+    const size_t sizes[5] = {
+        header.inputSize * cols,
+        header.hiddenSize * cols,
+        biasRows * cols,
+        header.hiddenSize,
+        1
+    };
+
+    std::vector<float> weights;
+    size_t expectedSize = 0;
+
+    for (int i = 0; i < 5; ++i)
+    {
+        flattenModelWeights(layers.at(i < 3 ? 0 : 1).at("weights").at(i < 3 ? i : i - 3), weights);
+        expectedSize += sizes[i];
+
+        if (weights.size() != expectedSize)
+            throw std::invalid_argument("Unexpected model weights size");
+    }
+
+    std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+    data.append(reinterpret_cast<const char*>(weights.data()), sizeof(float) * weights.size());
+    return data;
+}
+
+// Picks the variant matching the binary model layout, throws if none does
+template <size_t I = 1>
+static void emplaceBinaryModel(ModelVariantType& variant, const BinaryModelHeader& header)
+{
+    if constexpr (I < std::variant_size_v<ModelVariantType>)
+    {
+        using ModelType = std::variant_alternative_t<I, ModelVariantType>;
+        using RecurrentLayerType = std::decay_t<decltype(std::declval<ModelType&>().template get<0>())>;
+
+        constexpr uint32_t layerType = std::is_same_v<RecurrentLayerType,
+                                                      RTNeural::GRULayerT<float, RecurrentLayerType::in_size,
+                                                                                 RecurrentLayerType::out_size>>
+                                     ? kBinaryModelGRU
+                                     : kBinaryModelLSTM;
+
+        if (header.layerType == layerType &&
+            header.inputSize == static_cast<uint32_t>(RecurrentLayerType::in_size) &&
+            header.hiddenSize == static_cast<uint32_t>(RecurrentLayerType::out_size))
+        {
+            variant.emplace<I>();
+            return;
+        }
+
+        emplaceBinaryModel<I + 1>(variant, header);
+    }
+    else
+    {
+        throw std::runtime_error("Unable to identify a known model architecture!");
+    }
+}
+
+// Copies weights straight into the model layers, in the same way RTNeural does for keras json models
+static void loadBinaryModelWeights(ModelVariantType& variant, const BinaryModelHeader& header, const float* w)
+{
+    const uint32_t cols = (header.layerType == kBinaryModelGRU ? 3 : 4) * header.hiddenSize;
+
+    const auto readMatrix = [&w](const uint32_t rows, const uint32_t cols) {
+        std::vector<std::vector<float>> matrix(rows);
+        for (uint32_t r = 0; r < rows; ++r, w += cols)
+            matrix[r].assign(w, w + cols);
+        return matrix;
+    };
+
+    std::visit (
+        [&] (auto&& custom_model)
+        {
+            using ModelType = std::decay_t<decltype (custom_model)>;
+            if constexpr (! std::is_same_v<ModelType, NullModel>)
             {
-                float inArray2 alignas(RTNEURAL_DEFAULT_ALIGNMENT)[3] = {sample, param1, param2};
-                if (input_skip)
-                {
-                    sample += custom_model.forward(inArray2);
-                    sample *= output_gain;
-                }
+                auto& rnn = custom_model.template get<0>();
+                auto& dense = custom_model.template get<1>();
+
+                using RecurrentLayerType = std::decay_t<decltype (rnn)>;
+                rnn.setWVals(readMatrix(header.inputSize, cols));
+                rnn.setUVals(readMatrix(header.hiddenSize, cols));
+
+                if constexpr (std::is_same_v<RecurrentLayerType,
+                                             RTNeural::GRULayerT<float, RecurrentLayerType::in_size,
+                                                                        RecurrentLayerType::out_size>>)
+                    rnn.setBVals(readMatrix(2, cols));
                 else
-                {
-                    sample = custom_model.forward(inArray2) * output_gain;
-                }
+                    rnn.setBVals(readMatrix(1, cols)[0]);
+
+                // a [hidden][1] kernel has the same layout as the [1][hidden] weights RTNeural expects
+                dense.setWeights(readMatrix(1, header.hiddenSize));
+                dense.setBias(w);
             }
         },
-        model->variant
-    );
-    
-    return sample;
+        variant);
+}
+
+// Runs a new model for a little while, to avoid "clicks" during initialization
+static std::shared_ptr<const DynamicModel> prepareModel(std::unique_ptr<DynamicModel> newmodel)
+{
+    std::visit (
+        [] (auto&& custom_model)
+        {
+            using ModelType = std::decay_t<decltype (custom_model)>;
+            if constexpr (! std::is_same_v<ModelType, NullModel>)
+                custom_model.reset();
+        },
+        newmodel->variant);
+
+    float out[2048] = {};
+    applyModelOffline(newmodel.get(), out, ARRAY_SIZE(out));
+
+    return std::shared_ptr<const DynamicModel>(std::move(newmodel));
+}
+
+static std::shared_ptr<const DynamicModel> createBinaryModel(const std::string& data)
+{
+    BinaryModelHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    if (header.version != BINARY_MODEL_VERSION)
+        throw std::invalid_argument("Unsupported binary model version");
+    if (header.layerType != kBinaryModelGRU && header.layerType != kBinaryModelLSTM)
+        throw std::invalid_argument("Unsupported recurrent layer type");
+    if (header.inputSize == 0 || header.inputSize > MAX_INPUT_SIZE || header.hiddenSize == 0 || header.hiddenSize > 1024)
+        throw std::invalid_argument("Invalid binary model layer sizes");
+    if (header.inputSkip > 1)
+        throw std::invalid_argument("Values for in_skip > 1 are not supported");
+
+    const uint32_t cols = (header.layerType == kBinaryModelGRU ? 3 : 4) * header.hiddenSize;
+    const uint32_t biasRows = header.layerType == kBinaryModelGRU ? 2 : 1;
+    const size_t numWeights = (header.inputSize + header.hiddenSize + biasRows) * cols + header.hiddenSize + 1;
+
+    if (data.size() != sizeof(header) + sizeof(float) * numWeights)
+        throw std::invalid_argument("Unexpected binary model size");
+
+    // the data buffer has no alignment guarantees
+    std::vector<float> weights(numWeights);
+    std::memcpy(weights.data(), data.data() + sizeof(header), sizeof(float) * numWeights);
+
+    std::unique_ptr<DynamicModel> newmodel = std::make_unique<DynamicModel>();
+
+    emplaceBinaryModel(newmodel->variant, header);
+    loadBinaryModelWeights(newmodel->variant, header, weights.data());
+
+    // gains are stored in dB, 0 when the original model had none
+    newmodel->input_skip = header.inputSkip != 0;
+    newmodel->input_gain = DB_CO(header.inputGain);
+    newmodel->output_gain = DB_CO(header.outputGain);
+    newmodel->samplerate = header.samplerate;
+
+    return prepareModel(std::move(newmodel));
+}
+
+static std::shared_ptr<const DynamicModel> createModel(nlohmann::json& model_json)
+{
+    int input_size;
+    int input_skip;
+    float input_gain;
+    float output_gain;
+    float samplerate;
+
+    /* Understand which model type to load */
+    input_size = model_json["in_shape"].back().get<int>();
+    if (input_size > MAX_INPUT_SIZE) {
+        throw std::invalid_argument("Value for input_size not supported");
+    }
+
+    if (model_json["in_skip"].is_number()) {
+        input_skip = model_json["in_skip"].get<int>();
+        if (input_skip > 1)
+            throw std::invalid_argument("Values for in_skip > 1 are not supported");
+    }
+    else {
+        input_skip = 0;
+    }
+
+    if (model_json["in_gain"].is_number()) {
+        input_gain = DB_CO(model_json["in_gain"].get<float>());
+    }
+    else {
+        input_gain = 1.0f;
+    }
+
+    if (model_json["out_gain"].is_number()) {
+        output_gain = DB_CO(model_json["out_gain"].get<float>());
+    }
+    else {
+        output_gain = 1.0f;
+    }
+
+    samplerate = getModelSampleRate(model_json);
+
+    std::unique_ptr<DynamicModel> newmodel = std::make_unique<DynamicModel>();
+
+    if (! custom_model_creator(model_json, newmodel->variant))
+        throw std::runtime_error("Unable to identify a known model architecture!");
+
+    std::visit (
+        [&model_json] (auto&& custom_model)
+        {
+            using ModelType = std::decay_t<decltype (custom_model)>;
+            if constexpr (! std::is_same_v<ModelType, NullModel>)
+                custom_model.parseJson (model_json, true);
+        },
+        newmodel->variant);
+
+    // save extra info
+    newmodel->input_skip = input_skip != 0;
+    newmodel->input_gain = input_gain;
+    newmodel->output_gain = output_gain;
+    newmodel->samplerate = samplerate;
+
+    return prepareModel(std::move(newmodel));
 }
+
+static std::shared_ptr<const DynamicModel> createModelFromData(const std::string& data)
+{
+    if (data.size() >= sizeof(BinaryModelHeader) && std::memcmp(data.data(), BINARY_MODEL_MAGIC, 8) == 0)
+        return createBinaryModel(data);
+
+    nlohmann::json model_json = nlohmann::json::parse(data);
+    return createModel(model_json);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// A model as used by a single module instance, running at its training rate when possible.
+// Each channel runs its own copy of the shared model, weights included, as RTNeural keeps the recurrent state
+// inside the same layers as the weights. ModelVariantType is as big as its largest model type (LSTM, 64 hidden units,
+// 3 inputs), so each channel takes around 70KB whatever the loaded model, about 1MB for 16 channels.
+// Copies are only made for the channels in use at creation time, more channels need a new instance.
+
+struct DynamicModelChannel {
+    ModelVariantType variant;
+    PolyphaseResampler<2, RESAMPLER_TAPS> resampler2;
+    PolyphaseResampler<4, RESAMPLER_TAPS> resampler4;
+
+    DynamicModelChannel(const ModelVariantType& v)
+        : variant(v) {}
+};
+
+struct DynamicModelChannels {
+    const std::shared_ptr<const DynamicModel> model;
+    std::vector<DynamicModelChannel> channels;
+
+    // models run at their training rate when the engine runs at 2 or 4 times it, or the closest rate to it otherwise
+    float modelDataIn[MODULE_BLOCK_SIZE_MAX / 2];
+    uint resampleRatio = 1;
+    float lastSampleRate = 0.f;
+
+    DynamicModelChannels(const std::shared_ptr<const DynamicModel>& m, const int numChannels)
+        : model(m)
+    {
+        channels.reserve(numChannels);
+
+        for (int c = 0; c < numChannels; ++c)
+            channels.emplace_back(model->variant);
+    }
+
+    int getNumChannels() const
+    {
+        return static_cast<int>(channels.size());
+    }
+
+    void setSampleRate(const float sampleRate)
+    {
+        if (d_isEqual(lastSampleRate, sampleRate))
+            return;
+
+        lastSampleRate = sampleRate;
+
+        // pick the engine rate divider that brings the model closest to its training rate,
+        // e.g. 48kHz models run at 44.1kHz on 88.2 and 176.4kHz engines, about 8% off
+        const float distance = std::abs(std::log(sampleRate / model->samplerate));
+        const float distance2 = std::abs(std::log(sampleRate / (2.f * model->samplerate)));
+        const float distance4 = std::abs(std::log(sampleRate / (4.f * model->samplerate)));
+        const uint newResampleRatio = distance4 < distance2 && distance4 < distance ? 4
+                                    : distance2 < distance ? 2
+                                    : 1;
+
+        if (resampleRatio == newResampleRatio)
+            return;
+
+        resampleRatio = newResampleRatio;
+
+        for (DynamicModelChannel& channel : channels)
+        {
+            channel.resampler2.reset();
+            channel.resampler4.reset();
+        }
+    }
+
+    // group delay of decimating and interpolating back, in engine frames
+    uint32_t getLatency() const
+    {
+        switch (resampleRatio)
+        {
+        case 2:
+            return PolyphaseResampler<2, RESAMPLER_TAPS>::kLatency;
+        case 4:
+            return PolyphaseResampler<4, RESAMPLER_TAPS>::kLatency;
+        default:
+            return 0;
+        }
+    }
+
+    void process(const int c, float* const audioData, const uint32_t frames, const float param1, const float param2)
+    {
+        // channel added after this instance was made, silent until a bigger one arrives
+        if (c >= getNumChannels())
+        {
+            std::memset(audioData, 0, sizeof(float) * frames);
+            return;
+        }
+
+        const DynamicModel* const dynmodel = model.get();
+        DynamicModelChannel& channel(channels[c]);
+
+        switch (resampleRatio)
+        {
+        case 2:
+            for (uint32_t i=0, j=0; i<frames; i+=2, ++j)
+                modelDataIn[j] = channel.resampler2.decimate(audioData + i);
+            applyModel(dynmodel, channel.variant, modelDataIn, frames / 2, param1, param2);
+            for (uint32_t i=0, j=0; i<frames; i+=2, ++j)
+                channel.resampler2.interpolate(modelDataIn[j], audioData + i);
+            break;
+        case 4:
+            for (uint32_t i=0, j=0; i<frames; i+=4, ++j)
+                modelDataIn[j] = channel.resampler4.decimate(audioData + i);
+            applyModel(dynmodel, channel.variant, modelDataIn, frames / 4, param1, param2);
+            for (uint32_t i=0, j=0; i<frames; i+=4, ++j)
+                channel.resampler4.interpolate(modelDataIn[j], audioData + i);
+            break;
+        default:
+            applyModel(dynmodel, channel.variant, audioData, frames, param1, param2);
+            break;
+        }
+    }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Background thread shared by all instances, for model work that must stay out of the audio and UI threads.
+// Requests from the audio thread are polled, so that it never has to wake up the worker.
+
+struct AidaPluginModule;
+
+struct AidaModelWorker : Thread {
+    AidaModelWorker()
+        : Thread("AidaModelWorker")
+    {
+        startThread();
+    }
+
+    ~AidaModelWorker() override
+    {
+        signalThreadShouldExit();
+        signal.signal();
+        stopThread(-1);
+    }
+
+    void addModule(AidaPluginModule* const module)
+    {
+        {
+            const MutexLocker cml(mutex);
+            modules.push_back(module);
+        }
+
+        signal.signal();
+    }
+
+    // the worker no longer touches the module once this returns
+    void removeModule(AidaPluginModule* const module)
+    {
+        mutex.lock();
+        modules.erase(std::remove(modules.begin(), modules.end(), module), modules.end());
+
+        // jobs run outside the lock, wait for the ones of this module to finish
+        while (busyModule == module)
+        {
+            mutex.unlock();
+            d_msleep(1);
+            mutex.lock();
+        }
+
+        mutex.unlock();
+    }
+
+protected:
+    void run() override;
+
+private:
+    Mutex mutex;
+    Signal signal;
+    std::vector<AidaPluginModule*> modules;
+    AidaPluginModule* busyModule = nullptr; // module whose jobs are running, guarded by mutex
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Biquad filter with the same settings for all channels
+
+struct PolyBiquad {
+    Biquad channels[PORT_MAX_CHANNELS];
+
+    PolyBiquad(const int type, const double Fc, const double Q, const double peakGainDB)
+    {
+        setBiquad(type, Fc, Q, peakGainDB);
+    }
+
+    void setFc(const double Fc)
+    {
+        for (int c = 0; c < PORT_MAX_CHANNELS; ++c)
+            channels[c].setFc(Fc);
+    }
+
+    void setPeakGain(const double peakGainDB)
+    {
+        for (int c = 0; c < PORT_MAX_CHANNELS; ++c)
+            channels[c].setPeakGain(peakGainDB);
+    }
+
+    void setBiquad(const int type, const double Fc, const double Q, const double peakGainDB)
+    {
+        for (int c = 0; c < PORT_MAX_CHANNELS; ++c)
+            channels[c].setBiquad(type, Fc, Q, peakGainDB);
+    }
+
+    void process(const int c, float* const buffer, const uint32_t frames)
+    {
+        channels[c].process(buffer, frames);
+    }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Biquad used only to compute coefficients, filtering is done by a SIMD biquad bank
+
+struct BiquadDesign : Biquad {
+    BiquadDesign(const int type, const double Fc, const double Q, const double peakGainDB)
+        : Biquad(type, Fc, Q, peakGainDB) {}
+
+    void getCoefficients(float b[3], float a[2]) const
+    {
+        b[0] = a0;
+        b[1] = a1;
+        b[2] = a2;
+        a[0] = b1;
+        a[1] = b2;
+    }
+};
 #endif
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -228,6 +877,7 @@ struct AidaPluginModule : Module {
         kParameterOUTLEVEL,
         kParameterPARAM1,
         kParameterPARAM2,
+        kParameterBLOCKSIZE,
         NUM_PARAMS
     };
     enum EqPos {
@@ -250,27 +900,65 @@ struct AidaPluginModule : Module {
         NUM_LIGHTS
     };
 
+    CardinalPluginContext* const pcontext;
+
     bool fileChanged = false;
     std::string currentFile;
 
 #ifndef QUICK_BUILD_TESTING
-    Biquad dc_blocker { bq_type_highpass, 0.5f, COMMON_Q, 0.0f };
-    Biquad in_lpf { bq_type_lowpass, 0.5f, COMMON_Q, 0.0f };
-    Biquad bass { bq_type_lowshelf, 0.5f, COMMON_Q, 0.0f };
-    Biquad mid { bq_type_peak, 0.5f, COMMON_Q, 0.0f };
-    Biquad treble { bq_type_highshelf, 0.5f, COMMON_Q, 0.0f };
-    Biquad depth { bq_type_peak, 0.5f, COMMON_Q, 0.0f };
-    Biquad presence { bq_type_highshelf, 0.5f, COMMON_Q, 0.0f };
+    // audio is buffered and processed in blocks, output lags behind input by one block
+    float audioDataIn[PORT_MAX_CHANNELS][MODULE_BLOCK_SIZE_MAX];
+    float audioDataOut[PORT_MAX_CHANNELS][MODULE_BLOCK_SIZE_MAX];
+    float levelData[MODULE_BLOCK_SIZE_MAX];
+    unsigned audioDataFill = 0;
+    uint32_t blockSize;
+    uint32_t latency = 0;
+    int numChannels = 1;
+
+    PolyBiquad dc_blocker { bq_type_highpass, 0.5f, COMMON_Q, 0.0f };
+    PolyBiquad in_lpf { bq_type_lowpass, 0.5f, COMMON_Q, 0.0f };
+    BiquadDesign bass { bq_type_lowshelf, 0.5f, COMMON_Q, 0.0f };
+    BiquadDesign mid { bq_type_peak, 0.5f, COMMON_Q, 0.0f };
+    BiquadDesign treble { bq_type_highshelf, 0.5f, COMMON_Q, 0.0f };
+    BiquadDesign depth { bq_type_peak, 0.5f, COMMON_Q, 0.0f };
+    BiquadDesign presence { bq_type_highshelf, 0.5f, COMMON_Q, 0.0f };
+
+    // tone controls run as a single cascade, one section per filter
+    dsp::TBiquadBank<simd::float_8> toneStack[PORT_MAX_CHANNELS];
 
     float cachedParams[NUM_PARAMS] = {};
 
     dsp::ExponentialFilter inlevel;
     dsp::ExponentialFilter outlevel;
-    DynamicModel* model = nullptr;
-    std::atomic<bool> activeModel { false };
+
+    // the audio thread owns the active and fading models, new ones arrive through pendingModel.
+    // replaced models are handed back through retiredModels and deleted by the worker thread.
+    DynamicModelChannels* model = nullptr;
+    DynamicModelChannels* fadingModel = nullptr;
+    std::atomic<DynamicModelChannels*> pendingModel { nullptr };
+    std::atomic<DynamicModelChannels*> retiredModels[MAX_RETIRED_MODELS] = {};
+
+    float crossfadeData[MODULE_BLOCK_SIZE_MAX];
+    float crossfadeGain[MODULE_BLOCK_SIZE_MAX];
+    uint32_t crossfadePosition = MODEL_CROSSFADE_FRAMES;
+
+    // last loaded model, so the worker can make an instance with more channels when the audio thread asks for it.
+    // loadedModelMutex also guards handing over models to pendingModel, so an older model never replaces a newer one.
+    SharedResourcePointer<AidaModelWorker> worker;
+    Mutex loadedModelMutex;
+    std::shared_ptr<const DynamicModel> loadedModel;
+    std::atomic<int> channelsNeeded { 0 };
+    std::atomic<int> channelsInUse { 1 }; // numChannels as last seen by the audio thread
+    int channelsRequested = 0; // audio thread only
+
+    // file to load in the worker thread and its error message, guarded by loadedModelMutex
+    std::string pendingLoadFile;
+    std::string loadError;
+    bool pendingLoadShowError = false;
 #endif
 
     AidaPluginModule()
+        : pcontext(static_cast<CardinalPluginContext*>(APP))
     {
         config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 
@@ -294,8 +982,14 @@ struct AidaPluginModule : Module {
         configParam(kParameterOUTLEVEL, -15.f, 15.f, 0.f, "OUTPUT", " dB");
         configParam(kParameterPARAM1, 0.f, 1.f, 0.f, "PARAM1");
         configParam(kParameterPARAM2, 0.f, 1.f, 0.f, "PARAM2");
+        configSwitch(kParameterBLOCKSIZE, 0.f, 5.f, 0.f, "Block size", getModuleBlockSizeLabels())->randomizeEnabled = false;
 
 #ifndef QUICK_BUILD_TESTING
+        blockSize = getModuleBlockSize(pcontext->bufferSize, 0);
+        blockSize -= blockSize % 4;
+        std::memset(audioDataOut, 0, sizeof(audioDataOut));
+        std::memset(levelData, 0, sizeof(levelData));
+
         cachedParams[kParameterINLPF] = 66.216f;
         cachedParams[kParameterBASSGAIN] = 0.f;
         cachedParams[kParameterBASSFREQ] = 75.f;
@@ -308,15 +1002,23 @@ struct AidaPluginModule : Module {
         cachedParams[kParameterPRESENCE] = 0.f;
 
         in_lpf.setFc(MAP(66.216f, 0.0f, 100.0f, INLPF_MAX_CO, INLPF_MIN_CO));
+        updateToneStack(0);
         inlevel.setTau(1 / 30.f);
         outlevel.setTau(1 / 30.f);
+
+        worker->addModule(this);
 #endif
     }
 
     ~AidaPluginModule() override
     {
 #ifndef QUICK_BUILD_TESTING
+        worker->removeModule(this);
+
         delete model;
+        delete fadingModel;
+        delete pendingModel.exchange(nullptr);
+        reclaimRetiredModels();
 #endif
     }
 
@@ -354,120 +1056,225 @@ struct AidaPluginModule : Module {
         }
     }
 
+    // loading happens in the worker thread, errors to show are picked up by the UI through takeLoadError()
     void loadModelFromFile(const char* const filename, const bool showError)
     {
+#ifndef QUICK_BUILD_TESTING
+        const MutexLocker cml(loadedModelMutex);
+        pendingLoadFile = filename;
+        pendingLoadShowError = showError;
+#endif
+    }
+
+    std::string takeLoadError()
+    {
+        std::string error;
+#ifndef QUICK_BUILD_TESTING
+        const MutexLocker cml(loadedModelMutex);
+        error.swap(loadError);
+#endif
+        return error;
+    }
+
+#ifndef QUICK_BUILD_TESTING
+    // called from the worker thread
+    void loadPendingModelFile()
+    {
+        std::string filename;
+        bool showError;
+
+        {
+            const MutexLocker cml(loadedModelMutex);
+            filename.swap(pendingLoadFile);
+            showError = pendingLoadShowError;
+        }
+
+        if (filename.empty())
+            return;
+
         try {
-            std::ifstream jsonStream(filename, std::ifstream::binary);
-            loadModelFromStream(jsonStream);
+            std::ifstream stream(filename, std::ifstream::binary);
+            const std::string data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+            loadModelFromData(data);
         }
         catch (const std::exception& e) {
-            d_stderr2("Unable to load aida-x file: %s\nError: %s", filename, e.what());
+            d_stderr2("Unable to load aida-x file: %s\nError: %s", filename.c_str(), e.what());
 
             if (showError)
-                async_dialog_message((std::string("Unable to load aida-x file: ") + e.what()).c_str());
+            {
+                const MutexLocker cml(loadedModelMutex);
+                loadError = std::string("Unable to load aida-x file: ") + e.what();
+            }
         };
     }
 
-    void loadModelFromStream(std::istream& jsonStream)
+    void loadModelFromData(const std::string& data)
     {
-#ifndef QUICK_BUILD_TESTING
-        int input_size;
-        int input_skip;
-        float input_gain;
-        float output_gain;
-        nlohmann::json model_json;
+        // identical files loaded in several instances share the same parsed model
+        AidaModelCache& cache(getAidaModelCache());
+        std::shared_ptr<const DynamicModel> sharedmodel;
 
-        jsonStream >> model_json;
-
-        /* Understand which model type to load */
-        input_size = model_json["in_shape"].back().get<int>();
-        if (input_size > MAX_INPUT_SIZE) {
-            throw std::invalid_argument("Value for input_size not supported");
-        }
+        {
+            const MutexLocker cml(cache.mutex);
 
-        if (model_json["in_skip"].is_number()) {
-            input_skip = model_json["in_skip"].get<int>();
-            if (input_skip > 1)
-                throw std::invalid_argument("Values for in_skip > 1 are not supported");
-        }
-        else {
-            input_skip = 0;
+            const auto it = cache.models.find(data);
+            if (it != cache.models.end())
+                sharedmodel = it->second.lock();
         }
 
-        if (model_json["in_gain"].is_number()) {
-            input_gain = DB_CO(model_json["in_gain"].get<float>());
-        }
-        else {
-            input_gain = 1.0f;
-        }
+        if (! sharedmodel)
+        {
+            sharedmodel = createModelFromData(data);
 
-        if (model_json["out_gain"].is_number()) {
-            output_gain = DB_CO(model_json["out_gain"].get<float>());
-        }
-        else {
-            output_gain = 1.0f;
-        }
+            const MutexLocker cml(cache.mutex);
 
-        std::unique_ptr<DynamicModel> newmodel = std::make_unique<DynamicModel>();
+            // drop models no longer used by any instance
+            for (auto it = cache.models.begin(); it != cache.models.end();)
+            {
+                if (it->second.expired())
+                    it = cache.models.erase(it);
+                else
+                    ++it;
+            }
 
-        if (! custom_model_creator(model_json, newmodel->variant))
-            throw std::runtime_error("Unable to identify a known model architecture!");
+            cache.models[data] = sharedmodel;
+        }
 
-        std::visit (
-            [&model_json] (auto&& custom_model)
-            {
-                using ModelType = std::decay_t<decltype (custom_model)>;
-                if constexpr (! std::is_same_v<ModelType, NullModel>)
-                {
-                    custom_model.parseJson (model_json, true);
-                    custom_model.reset();
-                }
-            },
-            newmodel->variant);
+        // hand over to the audio thread, a previous model it did not pick up yet is never used
+        const int channels = channelsInUse.load();
 
-        // save extra info
-        newmodel->input_skip = input_skip != 0;
-        newmodel->input_gain = input_gain;
-        newmodel->output_gain = output_gain;
+        const MutexLocker cml(loadedModelMutex);
+        loadedModel = sharedmodel;
+        delete pendingModel.exchange(new DynamicModelChannels(sharedmodel, channels));
+    }
+#endif
 
-        // Pre-buffer to avoid "clicks" during initialization
-        float out[2048] = {};
-        applyModelOffline(newmodel.get(), out, ARRAY_SIZE(out));
+    void saveBinaryModel(const std::string& jsonFilename, const std::string& binaryFilename)
+    {
+#ifndef QUICK_BUILD_TESTING
+        std::ifstream jsonStream(jsonFilename, std::ifstream::binary);
+        nlohmann::json model_json;
+        jsonStream >> model_json;
 
-        // swap active model
-        DynamicModel* const oldmodel = model;
-        model = newmodel.release();
+        const std::string data = writeBinaryModel(model_json);
 
-        // if processing, wait for process cycle to complete
-        using DISTRHO_NAMESPACE::d_msleep;
-        while (oldmodel != nullptr && activeModel.load())
-            d_msleep(1);
+        std::ofstream binaryStream(binaryFilename, std::ofstream::binary);
+        binaryStream.write(data.data(), data.size());
 
-        delete oldmodel;
+        if (! binaryStream.good())
+            throw std::runtime_error("Failed to write file");
 #endif
     }
 
 #ifndef QUICK_BUILD_TESTING
+    void retireModel(DynamicModelChannels* const oldmodel)
+    {
+        for (int i = 0; i < MAX_RETIRED_MODELS; ++i)
+        {
+            DynamicModelChannels* expected = nullptr;
+
+            if (retiredModels[i].compare_exchange_strong(expected, oldmodel))
+                return;
+        }
+
+        // the worker reclaims models every few ms, we can never retire more than a few in between
+        DISTRHO_SAFE_ASSERT(false);
+    }
+
+    void reclaimRetiredModels()
+    {
+        for (int i = 0; i < MAX_RETIRED_MODELS; ++i)
+            delete retiredModels[i].exchange(nullptr);
+    }
+
+    // called periodically from the worker thread
+    void runModelJobs()
+    {
+        reclaimRetiredModels();
+        loadPendingModelFile();
+
+        const int channels = channelsNeeded.exchange(0);
+
+        if (channels == 0)
+            return;
+
+        const MutexLocker cml(loadedModelMutex);
+
+        if (loadedModel != nullptr)
+            delete pendingModel.exchange(new DynamicModelChannels(loadedModel, channels));
+    }
+
     MidEqType getMidType() const
     {
         return cachedParams[kParameterMTYPE] > 0.5f ? kMidEqBandpass : kMidEqPeak;
     }
 
-    float applyToneControls(float sample)
+    // copy tone control coefficients into the per-channel cascades, in processing order.
+    // changes are interpolated over `rampLength` frames.
+    void updateToneStack(const int rampLength)
     {
-        return getMidType() == kMidEqBandpass
-            ? mid.process(sample)
-            : presence.process(
-                treble.process(
-                    mid.process(
-                        bass.process(
-                            depth.process(sample)))));
+        BiquadDesign* const filters[5] = { &depth, &bass, &mid, &treble, &presence };
+        float b[5][3], a[5][2];
+        int numFilters;
+
+        if (getMidType() == kMidEqBandpass)
+        {
+            mid.getCoefficients(b[0], a[0]);
+            numFilters = 1;
+        }
+        else
+        {
+            for (int i = 0; i < 5; ++i)
+                filters[i]->getCoefficients(b[i], a[i]);
+            numFilters = 5;
+        }
+
+        for (int c = 0; c < PORT_MAX_CHANNELS; ++c)
+        {
+            dsp::TBiquadBank<simd::float_8>& bank(toneStack[c]);
+            bank.setRampLength(rampLength);
+
+            for (int i = 0; i < numFilters; ++i)
+                bank.setSection(i, b[i], a[i]);
+            for (int i = numFilters; i < bank.SECTIONS; ++i)
+                bank.setSectionIdentity(i);
+        }
+    }
+
+    void applyToneControls(const int c, float* const buffer, const uint32_t frames)
+    {
+        toneStack[c].processCascade(buffer, frames);
     }
 #endif
 
     void process(const ProcessArgs& args) override
     {
 #ifndef QUICK_BUILD_TESTING
+        const unsigned k = audioDataFill++;
+        const int channels = numChannels;
+
+        outputs[AUDIO_OUTPUT].setChannels(channels);
+
+        for (int c = 0; c < channels; ++c)
+        {
+            audioDataIn[c][k] = inputs[AUDIO_INPUT].getVoltage(c) * 0.1f;
+            outputs[AUDIO_OUTPUT].setVoltage(audioDataOut[c][k] * 10.f, c);
+        }
+
+        const uint32_t newLatency = blockSize + (model != nullptr ? model->getLatency() : 0);
+
+        if (latency != newLatency)
+        {
+            latency = newLatency;
+            pcontext->setModuleLatency(this, latency);
+        }
+
+        if (audioDataFill < blockSize)
+            return;
+
+        const uint32_t frames = blockSize;
+        audioDataFill = 0;
+
         const float stime = args.sampleTime;
         const float inlevelv = DB_CO(params[kParameterINLEVEL].getValue());
         const float outlevelv = DB_CO(params[kParameterOUTLEVEL].getValue());
@@ -478,6 +1285,7 @@ struct AidaPluginModule : Module {
 
         // update tone controls
         bool changed = false;
+        bool toneChanged = false;
         float value;
 
         value = params[kParameterINLPF].getValue();
@@ -504,6 +1312,7 @@ struct AidaPluginModule : Module {
         if (changed)
         {
             changed = false;
+            toneChanged = true;
             bass.setBiquad(bq_type_lowshelf,
                            cachedParams[kParameterBASSFREQ] / args.sampleRate,
                            COMMON_Q,
@@ -541,6 +1350,7 @@ struct AidaPluginModule : Module {
         if (changed)
         {
             changed = false;
+            toneChanged = true;
             mid.setBiquad(getMidType() == kMidEqBandpass ? bq_type_bandpass : bq_type_peak,
                           cachedParams[kParameterMIDFREQ] / args.sampleRate,
                           cachedParams[kParameterMIDQ],
@@ -564,6 +1374,7 @@ struct AidaPluginModule : Module {
         if (changed)
         {
             changed = false;
+            toneChanged = true;
             treble.setBiquad(bq_type_highshelf,
                              cachedParams[kParameterTREBLEFREQ] / args.sampleRate,
                              COMMON_Q,
@@ -575,6 +1386,7 @@ struct AidaPluginModule : Module {
         {
             cachedParams[kParameterDEPTH] = value;
             depth.setPeakGain(value);
+            toneChanged = true;
         }
 
         value = params[kParameterPRESENCE].getValue();
@@ -582,38 +1394,147 @@ struct AidaPluginModule : Module {
         {
             cachedParams[kParameterPRESENCE] = value;
             presence.setPeakGain(value);
+            toneChanged = true;
+        }
+
+        if (toneChanged)
+            updateToneStack(frames);
+
+        // level smoothing is shared by all channels
+        for (uint32_t i=0; i<frames; ++i)
+            levelData[i] = inlevel.process(stime, inlevelv);
+
+        for (int c = 0; c < channels; ++c)
+        {
+            // High frequencies roll-off (lowpass)
+            in_lpf.process(c, audioDataIn[c], frames);
+
+            for (uint32_t i=0; i<frames; ++i)
+                audioDataOut[c][i] = audioDataIn[c][i] * levelData[i];
+
+            // Equalizer section
+            if (!eq_bypass && eq_pos == kEqPre)
+                applyToneControls(c, audioDataOut[c], frames);
         }
 
-        // High frequencies roll-off (lowpass)
-        float sample = in_lpf.process(inputs[AUDIO_INPUT].getVoltage() * 0.1f) * inlevel.process(stime, inlevelv);
+        // pick up newly loaded model, crossfading from the previous one (or the dry signal if there was none)
+        if (DynamicModelChannels* const newmodel = pendingModel.exchange(nullptr))
+        {
+            if (fadingModel != nullptr)
+                retireModel(fadingModel);
+
+            fadingModel = model;
+            model = newmodel;
+            crossfadePosition = 0;
+            channelsRequested = model->getNumChannels();
+        }
 
-        // Equalizer section
-        if (!eq_bypass && eq_pos == kEqPre)
-            sample = applyToneControls(sample);
+        // nothing to crossfade while bypassed
+        if (net_bypass)
+            crossfadePosition = MODEL_CROSSFADE_FRAMES;
 
-        // run model
+        if (crossfadePosition >= MODEL_CROSSFADE_FRAMES && fadingModel != nullptr)
+        {
+            retireModel(fadingModel);
+            fadingModel = nullptr;
+        }
+
+        // run model, all channels at once while its weights are hot in cache
         if (!net_bypass && model != nullptr)
+            applyModels(channels, frames, args.sampleRate);
+
+        for (uint32_t i=0; i<frames; ++i)
+            levelData[i] = outlevel.process(stime, outlevelv);
+
+        for (int c = 0; c < channels; ++c)
+        {
+            // DC blocker filter (highpass)
+            dc_blocker.process(c, audioDataOut[c], frames);
+
+            // Equalizer section
+            if (!eq_bypass && eq_pos == kEqPost)
+                applyToneControls(c, audioDataOut[c], frames);
+
+            // Output volume
+            for (uint32_t i=0; i<frames; ++i)
+                audioDataOut[c][i] *= levelData[i];
+        }
+
+        // channel count changes are only applied in between blocks, new channels start from silence
+        const int newNumChannels = std::max(1, inputs[AUDIO_INPUT].getChannels());
+
+        for (int c = numChannels; c < newNumChannels; ++c)
+            std::memset(audioDataOut[c], 0, sizeof(audioDataOut[c]));
+
+        numChannels = newNumChannels;
+        channelsInUse.store(numChannels);
+
+        // models only keep state for the channels they were made for, ask the worker for a bigger one when needed
+        if (model != nullptr && model->getNumChannels() < numChannels && channelsRequested < numChannels)
         {
-            activeModel.store(true);
-            sample = applyModel(model, sample,
-                                params[kParameterPARAM1].getValue(),
-                                params[kParameterPARAM2].getValue());
-            activeModel.store(false);
+            channelsRequested = numChannels;
+            channelsNeeded.store(numChannels);
         }
 
-        // DC blocker filter (highpass)
-        sample = dc_blocker.process(sample);
+        // block size changes are only applied in between blocks, keep them a multiple of the resampling ratio
+        uint32_t newBlockSize = getModuleBlockSize(pcontext->bufferSize, params[kParameterBLOCKSIZE].getValue() + 0.5f);
+        newBlockSize -= newBlockSize % 4;
 
-        // Equalizer section
-        if (!eq_bypass && eq_pos == kEqPost)
-            sample = applyToneControls(sample);
+        if (blockSize != newBlockSize)
+        {
+            if (newBlockSize > blockSize)
+            {
+                for (int c = 0; c < PORT_MAX_CHANNELS; ++c)
+                    std::memset(audioDataOut[c] + blockSize, 0, sizeof(float) * (newBlockSize - blockSize));
+            }
 
-        // Output volume
-        outputs[AUDIO_OUTPUT].setVoltage(sample * outlevel.process(stime, outlevelv) * 10.f);
+            blockSize = newBlockSize;
+        }
 #endif
     }
 
 #ifndef QUICK_BUILD_TESTING
+    void applyModels(const int channels, const uint32_t frames, const float sampleRate)
+    {
+        const float param1 = params[kParameterPARAM1].getValue();
+        const float param2 = params[kParameterPARAM2].getValue();
+        const bool crossfading = crossfadePosition < MODEL_CROSSFADE_FRAMES;
+
+        model->setSampleRate(sampleRate);
+
+        if (fadingModel != nullptr)
+            fadingModel->setSampleRate(sampleRate);
+
+        if (crossfading)
+        {
+            for (uint32_t i=0; i<frames; ++i)
+                crossfadeGain[i] = std::min(1.f, static_cast<float>(crossfadePosition + i) / MODEL_CROSSFADE_FRAMES);
+
+            crossfadePosition += frames;
+        }
+
+        for (int c = 0; c < channels; ++c)
+        {
+            float* const audioData = audioDataOut[c];
+
+            if (crossfading)
+            {
+                std::memcpy(crossfadeData, audioData, sizeof(float) * frames);
+
+                if (fadingModel != nullptr)
+                    fadingModel->process(c, crossfadeData, frames, param1, param2);
+            }
+
+            model->process(c, audioData, frames, param1, param2);
+
+            if (crossfading)
+            {
+                for (uint32_t i=0; i<frames; ++i)
+                    audioData[i] = crossfadeData[i] + (audioData[i] - crossfadeData[i]) * crossfadeGain[i];
+            }
+        }
+    }
+
     void onSampleRateChange(const SampleRateChangeEvent& e) override
     {
         cachedParams[kParameterBASSGAIN] = params[kParameterBASSGAIN].getValue();
@@ -653,12 +1574,53 @@ struct AidaPluginModule : Module {
                            PRESENCE_FREQ / e.sampleRate,
                            COMMON_Q,
                            cachedParams[kParameterPRESENCE]);
+
+        updateToneStack(0);
     }
 #endif
 };
 
 // --------------------------------------------------------------------------------------------------------------------
 
+#ifndef QUICK_BUILD_TESTING
+void AidaModelWorker::run()
+{
+    while (! shouldThreadExit())
+    {
+        bool idle = true;
+
+        // jobs can take a while to load and parse files, so they run without holding the lock.
+        // modules added or removed during a pass may be skipped until the next one.
+        for (size_t i = 0;; ++i)
+        {
+            AidaPluginModule* module;
+
+            {
+                const MutexLocker cml(mutex);
+
+                if (i >= modules.size())
+                    break;
+
+                module = busyModule = modules[i];
+                idle = false;
+            }
+
+            module->runModelJobs();
+
+            const MutexLocker cml(mutex);
+            busyModule = nullptr;
+        }
+
+        if (idle)
+            signal.wait();
+        else
+            d_msleep(MODEL_WORKER_INTERVAL_MS);
+    }
+}
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+
 #ifndef HEADLESS
 struct AidaModelListWidget : ImGuiWidget {
     AidaPluginModule* const module;
@@ -744,6 +1706,10 @@ struct AidaModelListWidget : ImGuiWidget {
         if (module->fileChanged)
             reloadDir();
 
+        const std::string loadError = module->takeLoadError();
+        if (! loadError.empty())
+            async_dialog_message(loadError.c_str());
+
         ImGuiWidget::step();
     }
 
@@ -755,7 +1721,8 @@ struct AidaModelListWidget : ImGuiWidget {
         selectedFile = (size_t)-1;
 
         static constexpr const char* const supportedExtensions[] = {
-            ".json"
+            ".json",
+            ".aidabin"
         };
 
         using namespace ghc::filesystem;
@@ -1089,6 +2056,26 @@ struct AidaWidget : ModuleWidgetWithSideScrews<23> {
         };
 
         menu->addChild(new LoadModelFileItem(module));
+
+        const std::string currentFile = module->currentFile;
+        const bool canSaveBinary = !currentFile.empty() && system::getExtension(currentFile) == ".json";
+
+        menu->addChild(createMenuItem("Save as binary model", "", [=]() {
+            const std::string binaryFile = system::join(system::getDirectory(currentFile),
+                                                        system::getStem(currentFile) + ".aidabin");
+
+            try {
+                module->saveBinaryModel(currentFile, binaryFile);
+            }
+            catch (const std::exception& e) {
+                async_dialog_message((std::string("Unable to save binary model: ") + e.what()).c_str());
+            }
+        }, !canSaveBinary));
+
+        menu->addChild(createIndexSubmenuItem("Block size", getModuleBlockSizeLabels(),
+            [=]() {return static_cast<size_t>(module->params[AidaPluginModule::kParameterBLOCKSIZE].getValue() + 0.5f);},
+            [=](size_t index) {module->params[AidaPluginModule::kParameterBLOCKSIZE].setValue(index);}
+        ));
     }
 };
 #else
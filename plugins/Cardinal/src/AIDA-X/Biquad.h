@@ -40,6 +40,7 @@ public:
     void setPeakGain(double peakGainDB);
     void setBiquad(int type, double Fc, double Q, double peakGainDB);
     float process(float in);
+    void process(float* buffer, unsigned count);
 
 protected:
     void calcBiquad(void);
@@ -57,4 +58,18 @@ inline float Biquad::process(float in) {
     return out;
 }
 
+inline void Biquad::process(float* buffer, unsigned count) {
+    double lz1 = z1;
+    double lz2 = z2;
+    for (unsigned i = 0; i < count; ++i) {
+        const double in = buffer[i];
+        const double out = in * a0 + lz1;
+        lz1 = in * a1 + lz2 - b1 * out;
+        lz2 = in * a2 - b2 * out;
+        buffer[i] = out;
+    }
+    z1 = lz1;
+    z2 = lz2;
+}
+
 #endif // Biquad_h
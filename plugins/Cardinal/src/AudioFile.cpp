@@ -18,49 +18,22 @@
 #include "plugin.hpp"
 #include "plugincontext.hpp"
 #include "ModuleWidgets.hpp"
-#include "extra/Runner.hpp"
-
-#include "CarlaNativePlugin.h"
+#include "SampleCache.hpp"
+#include "../../src/extra/SharedResourcePointer.hpp"
 
 #ifndef HEADLESS
 # include "ImGuiWidget.hpp"
 # include "ghc/filesystem.hpp"
+# include <map>
 #endif
 
-#define BUFFER_SIZE 128
-
-// generates a warning if this is defined as anything else
-#define CARLA_API
-
-// --------------------------------------------------------------------------------------------------------------------
-
-std::size_t carla_getNativePluginCount() noexcept;
-const NativePluginDescriptor* carla_getNativePluginDescriptor(const std::size_t index) noexcept;
-
 // --------------------------------------------------------------------------------------------------------------------
 
-using namespace CARLA_BACKEND_NAMESPACE;
 using namespace DISTRHO_NAMESPACE;
 
-static uint32_t host_get_buffer_size(NativeHostHandle);
-static double host_get_sample_rate(NativeHostHandle);
-static bool host_is_offline(NativeHostHandle);
-static const NativeTimeInfo* host_get_time_info(NativeHostHandle handle);
-static bool host_write_midi_event(NativeHostHandle handle, const NativeMidiEvent* event);
-static void host_ui_midi_program_changed(NativeHostHandle handle, uint8_t channel, uint32_t bank, uint32_t program);
-static void host_ui_custom_data_changed(NativeHostHandle handle, const char* key, const char* value);
-static intptr_t host_dispatcher(NativeHostHandle handle, NativeHostDispatcherOpcode opcode, int32_t index, intptr_t value, void* ptr, float opt);
-
-static void host_ui_parameter_changed(NativeHostHandle, uint32_t, float) {}
-static void host_ui_midi_program_changed(NativeHostHandle, uint8_t, uint32_t, uint32_t) {}
-static void host_ui_custom_data_changed(NativeHostHandle, const char*, const char*) {}
-static const char* host_ui_open_file(NativeHostHandle, bool, const char*, const char*) { return nullptr; }
-static const char* host_ui_save_file(NativeHostHandle, bool, const char*, const char*) { return nullptr; }
-static void host_ui_closed(NativeHostHandle) {}
-
 // --------------------------------------------------------------------------------------------------------------------
 
-struct CarlaInternalPluginModule : Module, Runner {
+struct AudioFileModule : Module {
     enum ParamIds {
         NUM_PARAMS
     };
@@ -76,38 +49,26 @@ struct CarlaInternalPluginModule : Module, Runner {
         NUM_LIGHTS
     };
 
-    enum Parameters {
-        kParameterLooping,
-        kParameterHostSync,
-        kParameterVolume,
-        kParameterEnabled,
-        kParameterQuadChannels,
-        kParameterInfoChannels,
-        kParameterInfoBitRate,
-        kParameterInfoBitDepth,
-        kParameterInfoSampleRate,
-        kParameterInfoLength,
-        kParameterInfoPosition,
-        kParameterInfoPoolFill,
-        kParameterCount
-    };
-
     CardinalPluginContext* const pcontext;
 
-    const NativePluginDescriptor* fCarlaPluginDescriptor = nullptr;
-    NativePluginHandle fCarlaPluginHandle = nullptr;
-    NativeHostDescriptor fCarlaHostDescriptor = {};
-    NativeTimeInfo fCarlaTimeInfo;
+    // file contents are shared with other instances and streamed in the background
+    SharedResourcePointer<SampleCache> cache;
+    SampleStream stream;
 
-    float dataOut[NUM_OUTPUTS+1][BUFFER_SIZE];
-    float* dataOutPtr[NUM_OUTPUTS+1];
+    float dataOut[NUM_OUTPUTS][MODULE_BLOCK_SIZE_MAX];
     unsigned audioDataFill = 0;
+    uint32_t blockSize;
     uint32_t lastProcessCounter = 0;
+    uint64_t hostFrame = 0;
+    bool hostPlaying = false;
+    bool looping = true;
+    bool hostSync = false;
     bool fileChanged = false;
+    bool previewReady = false;
     std::string currentFile;
 
     struct {
-        float preview[108];
+        float preview[kSamplePreviewSize];
         uint channels;
         uint bitDepth;
         uint sampleRate;
@@ -115,7 +76,7 @@ struct CarlaInternalPluginModule : Module, Runner {
         float position;
     } audioInfo;
 
-    CarlaInternalPluginModule()
+    AudioFileModule()
         : pcontext(static_cast<CardinalPluginContext*>(APP))
     {
         config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -123,109 +84,26 @@ struct CarlaInternalPluginModule : Module, Runner {
         configOutput(0, "Audio Left");
         configOutput(1, "Audio Right");
 
-        dataOutPtr[0] = dataOut[0];
-        dataOutPtr[1] = dataOut[1];
-        dataOutPtr[2] = dataOut[2];
+        blockSize = getModuleBlockSize(pcontext->bufferSize, 0);
 
         std::memset(dataOut, 0, sizeof(dataOut));
         std::memset(&audioInfo, 0, sizeof(audioInfo));
 
-        for (std::size_t i=0, count=carla_getNativePluginCount(); i<count; ++i)
-        {
-            const NativePluginDescriptor* const desc = carla_getNativePluginDescriptor(i);
-
-            if (std::strcmp(desc->label, "audiofile") != 0)
-                continue;
-
-            fCarlaPluginDescriptor = desc;
-            break;
-        }
-
-        DISTRHO_SAFE_ASSERT_RETURN(fCarlaPluginDescriptor != nullptr,);
-
-        memset(&fCarlaHostDescriptor, 0, sizeof(fCarlaHostDescriptor));
-        memset(&fCarlaTimeInfo, 0, sizeof(fCarlaTimeInfo));
-
-        fCarlaHostDescriptor.handle = this;
-        fCarlaHostDescriptor.resourceDir = "";
-        fCarlaHostDescriptor.uiName = "Cardinal";
-
-        fCarlaHostDescriptor.get_buffer_size = host_get_buffer_size;
-        fCarlaHostDescriptor.get_sample_rate = host_get_sample_rate;
-        fCarlaHostDescriptor.is_offline = host_is_offline;
-
-        fCarlaHostDescriptor.get_time_info = host_get_time_info;
-        fCarlaHostDescriptor.write_midi_event = host_write_midi_event;
-        fCarlaHostDescriptor.ui_parameter_changed = host_ui_parameter_changed;
-        fCarlaHostDescriptor.ui_midi_program_changed = host_ui_midi_program_changed;
-        fCarlaHostDescriptor.ui_custom_data_changed = host_ui_custom_data_changed;
-        fCarlaHostDescriptor.ui_closed = host_ui_closed;
-        fCarlaHostDescriptor.ui_open_file = host_ui_open_file;
-        fCarlaHostDescriptor.ui_save_file = host_ui_save_file;
-        fCarlaHostDescriptor.dispatcher = host_dispatcher;
-
-        fCarlaPluginHandle = fCarlaPluginDescriptor->instantiate(&fCarlaHostDescriptor);
-        DISTRHO_SAFE_ASSERT_RETURN(fCarlaPluginHandle != nullptr,);
-
-        fCarlaPluginDescriptor->activate(fCarlaPluginHandle);
-
-        // host-sync disabled by default
-        fCarlaPluginDescriptor->set_parameter_value(fCarlaPluginHandle, kParameterHostSync, 0.0f);
-
-        startRunner(500);
+        cache->addStream(&stream);
     }
 
-    ~CarlaInternalPluginModule() override
+    ~AudioFileModule() override
     {
-        if (fCarlaPluginHandle == nullptr)
-            return;
-
-        stopRunner();
-        fCarlaPluginDescriptor->deactivate(fCarlaPluginHandle);
-        fCarlaPluginDescriptor->cleanup(fCarlaPluginHandle);
-    }
-
-    bool run() override
-    {
-        fCarlaPluginDescriptor->dispatcher(fCarlaPluginHandle, NATIVE_PLUGIN_OPCODE_IDLE, 0, 0, nullptr, 0.0f);
-        return true;
+        cache->removeStream(&stream);
     }
 
-    const NativeTimeInfo* hostGetTimeInfo() const noexcept
+    // must not be called from the audio thread, the file is loaded in the background
+    void setFile(const char* const filepath)
     {
-        return &fCarlaTimeInfo;
-    }
-
-    intptr_t hostDispatcher(const NativeHostDispatcherOpcode opcode,
-                            const int32_t index, const intptr_t value, void* const ptr, const float opt)
-    {
-        switch (opcode)
-        {
-        // cannot be supported
-        case NATIVE_HOST_OPCODE_HOST_IDLE:
-            break;
-        // other stuff
-        case NATIVE_HOST_OPCODE_NULL:
-        case NATIVE_HOST_OPCODE_UPDATE_PARAMETER:
-        case NATIVE_HOST_OPCODE_UPDATE_MIDI_PROGRAM:
-        case NATIVE_HOST_OPCODE_RELOAD_PARAMETERS:
-        case NATIVE_HOST_OPCODE_RELOAD_MIDI_PROGRAMS:
-        case NATIVE_HOST_OPCODE_RELOAD_ALL:
-        case NATIVE_HOST_OPCODE_UI_UNAVAILABLE:
-        case NATIVE_HOST_OPCODE_INTERNAL_PLUGIN:
-        case NATIVE_HOST_OPCODE_QUEUE_INLINE_DISPLAY:
-        case NATIVE_HOST_OPCODE_UI_TOUCH_PARAMETER:
-        case NATIVE_HOST_OPCODE_UI_RESIZE:
-            break;
-        case NATIVE_HOST_OPCODE_PREVIEW_BUFFER_DATA:
-            std::memcpy(audioInfo.preview, ptr, sizeof(audioInfo.preview));
-            break;
-        case NATIVE_HOST_OPCODE_GET_FILE_PATH:
-        case NATIVE_HOST_OPCODE_REQUEST_IDLE:
-            break;
-        }
-
-        return 0;
+        currentFile = filepath;
+        fileChanged = true;
+        previewReady = false;
+        cache->setStreamFile(&stream, currentFile);
     }
 
     json_t* dataToJson() override
@@ -234,17 +112,8 @@ struct CarlaInternalPluginModule : Module, Runner {
         DISTRHO_SAFE_ASSERT_RETURN(rootJ != nullptr, nullptr);
 
         json_object_set_new(rootJ, "filepath", json_string(currentFile.c_str()));
-
-        if (fCarlaPluginHandle != nullptr)
-        {
-            const bool looping = fCarlaPluginDescriptor->get_parameter_value(fCarlaPluginHandle,
-                                                                             kParameterLooping) > 0.5f;
-            const bool hostSync = fCarlaPluginDescriptor->get_parameter_value(fCarlaPluginHandle,
-                                                                              kParameterHostSync) > 0.5f;
-
-            json_object_set_new(rootJ, "looping", json_boolean(looping));
-            json_object_set_new(rootJ, "hostSync", json_boolean(hostSync));
-        }
+        json_object_set_new(rootJ, "looping", json_boolean(looping));
+        json_object_set_new(rootJ, "hostSync", json_boolean(hostSync));
 
         return rootJ;
     }
@@ -258,48 +127,27 @@ struct CarlaInternalPluginModule : Module, Runner {
             const char* const filepath = json_string_value(filepathJ);
 
             if (filepath[0] != '\0')
-            {
-                currentFile = filepath;
-                fileChanged = true;
-
-                if (fCarlaPluginHandle != nullptr)
-                    fCarlaPluginDescriptor->set_custom_data(fCarlaPluginHandle, "file", filepath);
-            }
+                setFile(filepath);
         }
 
         if (! fileChanged)
-        {
-            currentFile.clear();
-            fileChanged = true;
-        }
-
-        if (fCarlaPluginHandle == nullptr)
-            return;
+            setFile("");
 
         if (json_t* const loopingJ = json_object_get(rootJ, "looping"))
-        {
-            const float value = json_boolean_value(loopingJ) ? 1.0f : 0.0f;
-            fCarlaPluginDescriptor->set_parameter_value(fCarlaPluginHandle, kParameterLooping, value);
-        }
+            looping = json_boolean_value(loopingJ);
 
         if (json_t* const hostSyncJ = json_object_get(rootJ, "hostSync"))
-        {
-            const float value = json_boolean_value(hostSyncJ) ? 1.0f : 0.0f;
-            fCarlaPluginDescriptor->set_parameter_value(fCarlaPluginHandle, kParameterHostSync, value);
-        }
+            hostSync = json_boolean_value(hostSyncJ);
     }
 
     void process(const ProcessArgs&) override
     {
-        if (fCarlaPluginHandle == nullptr)
-            return;
-
         const unsigned k = audioDataFill++;
 
         outputs[0].setVoltage(dataOut[0][k] * 10.0f);
         outputs[1].setVoltage(dataOut[1][k] * 10.0f);
 
-        if (audioDataFill == BUFFER_SIZE)
+        if (audioDataFill >= blockSize)
         {
             const uint32_t processCounter = pcontext->processCounter;
 
@@ -307,91 +155,209 @@ struct CarlaInternalPluginModule : Module, Runner {
             if (lastProcessCounter != processCounter)
             {
                 lastProcessCounter = processCounter;
-                fCarlaTimeInfo.playing = pcontext->playing;
-                fCarlaTimeInfo.frame = pcontext->frame;
+                hostPlaying = pcontext->playing;
+                hostFrame = pcontext->frame;
             }
-            // or advance time by BUFFER_SIZE frames if still under the same audio block
-            else if (fCarlaTimeInfo.playing)
+            // or advance time by blockSize frames if still under the same audio block
+            else if (hostPlaying)
             {
-                fCarlaTimeInfo.frame += BUFFER_SIZE;
+                hostFrame += blockSize;
             }
 
             audioDataFill = 0;
-            fCarlaPluginDescriptor->process(fCarlaPluginHandle, nullptr, dataOutPtr, BUFFER_SIZE, nullptr, 0);
 
-            audioInfo.channels = fCarlaPluginDescriptor->get_parameter_value(fCarlaPluginHandle, kParameterInfoChannels);
-            audioInfo.bitDepth = fCarlaPluginDescriptor->get_parameter_value(fCarlaPluginHandle, kParameterInfoBitDepth);
-            audioInfo.sampleRate = fCarlaPluginDescriptor->get_parameter_value(fCarlaPluginHandle, kParameterInfoSampleRate);
-            audioInfo.length = fCarlaPluginDescriptor->get_parameter_value(fCarlaPluginHandle,  kParameterInfoLength);
-            audioInfo.position = fCarlaPluginDescriptor->get_parameter_value(fCarlaPluginHandle, kParameterInfoPosition);
+            // with host sync the file follows the host transport, otherwise it plays all the time
+            stream.process(dataOut[0], dataOut[1], blockSize, pcontext->sampleRate, looping,
+                           hostSync ? hostPlaying : true,
+                           hostSync ? static_cast<int64_t>(hostFrame) : -1);
+
+            // nothing feeds into this module, so blocks can always follow the host buffer size
+            const uint32_t newBlockSize = getModuleBlockSize(pcontext->bufferSize, 0);
+
+            if (blockSize != newBlockSize)
+            {
+                if (newBlockSize > blockSize)
+                {
+                    for (uint i=0; i<NUM_OUTPUTS; ++i)
+                        std::memset(dataOut[i] + blockSize, 0, sizeof(float) * (newBlockSize - blockSize));
+                }
+
+                blockSize = newBlockSize;
+            }
+
+            const uint64_t numFrames = stream.getNumFrames();
+
+            audioInfo.channels = stream.getChannels();
+            audioInfo.bitDepth = stream.getBitDepth();
+            audioInfo.sampleRate = stream.getSampleRate();
+            audioInfo.length = audioInfo.sampleRate != 0 ? numFrames / audioInfo.sampleRate : 0;
+            audioInfo.position = numFrames != 0 ? stream.getPosition() * 100.0f / numFrames : 0.0f;
         }
     }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
 
-    void onSampleRateChange(const SampleRateChangeEvent& e) override
+#ifndef HEADLESS
+// Lists audio files per directory on a background thread, shared between all AudioFile instances.
+// Listings are kept in memory and only re-read when the directory modification time changes.
+struct AudioFileDirectoryLister : Thread {
+    struct ghcFile {
+        std::string full, base;
+        bool operator<(const ghcFile& other) const noexcept { return base < other.base; }
+    };
+
+    struct Listing {
+        std::vector<ghcFile> files;
+        ghc::filesystem::file_time_type mtime;
+        bool valid = false;
+        bool pending = false;
+    };
+
+    Mutex mutex;
+    Signal signal;
+    std::map<std::string, Listing> listings;
+    std::vector<std::string> requests;
+
+    AudioFileDirectoryLister()
+        : Thread("AudioFileDirectoryLister")
     {
-        if (fCarlaPluginHandle == nullptr)
-            return;
+        startThread();
+    }
 
-        fCarlaPluginDescriptor->deactivate(fCarlaPluginHandle);
-        fCarlaPluginDescriptor->dispatcher(fCarlaPluginHandle, NATIVE_PLUGIN_OPCODE_SAMPLE_RATE_CHANGED,
-                                           0, 0, nullptr, e.sampleRate);
-        fCarlaPluginDescriptor->activate(fCarlaPluginHandle);
+    ~AudioFileDirectoryLister() override
+    {
+        signalThreadShouldExit();
+        signal.signal();
+        stopThread(-1);
     }
-};
 
-// -----------------------------------------------------------------------------------------------------------
-
-static uint32_t host_get_buffer_size(NativeHostHandle)
-{
-    return BUFFER_SIZE;
-}
-
-static double host_get_sample_rate(const NativeHostHandle handle)
-{
-    CardinalPluginContext* const pcontext = static_cast<CarlaInternalPluginModule*>(handle)->pcontext;
-    DISTRHO_SAFE_ASSERT_RETURN(pcontext != nullptr, 48000.0);
-    return pcontext->sampleRate;
-}
-
-static bool host_is_offline(NativeHostHandle)
-{
-    return false;
-}
-
-static const NativeTimeInfo* host_get_time_info(const NativeHostHandle handle)
-{
-    return static_cast<CarlaInternalPluginModule*>(handle)->hostGetTimeInfo();
-}
-
-static bool host_write_midi_event(NativeHostHandle, const NativeMidiEvent*)
-{
-    return false;
-}
-
-static intptr_t host_dispatcher(const NativeHostHandle handle, const NativeHostDispatcherOpcode opcode,
-                                const int32_t index, const intptr_t value, void* const ptr, const float opt)
-{
-    return static_cast<CarlaInternalPluginModule*>(handle)->hostDispatcher(opcode, index, value, ptr, opt);
-}
+    // asks for a directory to be checked for changes, getListing() fails until that is done
+    void requestListing(const std::string& directory)
+    {
+        {
+            const MutexLocker cml(mutex);
+            Listing& listing(listings[directory]);
 
-// --------------------------------------------------------------------------------------------------------------------
+            if (listing.pending)
+                return;
+
+            listing.pending = true;
+            requests.push_back(directory);
+        }
+
+        signal.signal();
+    }
+
+    bool getListing(const std::string& directory, std::vector<ghcFile>& files)
+    {
+        const MutexLocker cml(mutex);
+        const std::map<std::string, Listing>::const_iterator it = listings.find(directory);
+
+        if (it == listings.end() || it->second.pending || ! it->second.valid)
+            return false;
+
+        files = it->second.files;
+        return true;
+    }
+
+protected:
+    void run() override
+    {
+        while (! shouldThreadExit())
+        {
+            std::string directory;
+            Listing listing;
+
+            {
+                const MutexLocker cml(mutex);
+
+                if (! requests.empty())
+                {
+                    directory = requests.front();
+                    requests.erase(requests.begin());
+                    listing = listings[directory];
+                }
+            }
+
+            if (directory.empty())
+            {
+                signal.wait();
+                continue;
+            }
+
+            using namespace ghc::filesystem;
+            std::error_code ec;
+            const file_time_type mtime = last_write_time(u8path(directory), ec);
+
+            if (ec || ! listing.valid || listing.mtime != mtime)
+            {
+                listing.files.clear();
+                listing.valid = ! ec && readDirectory(directory, listing.files);
+                listing.mtime = mtime;
+            }
+
+            listing.pending = false;
+
+            const MutexLocker cml(mutex);
+            listings[directory] = std::move(listing);
+        }
+    }
+
+    static bool readDirectory(const std::string& directory, std::vector<ghcFile>& files)
+    {
+        static constexpr const char* const supportedExtensions[] = {
+           #ifdef HAVE_SNDFILE
+            ".au",".bwf",".flac",".htk",".iff",".mat4",".mat5",".oga",".ogg",".opus",
+            ".paf",".pvf",".pvf5",".sd2",".sf",".snd",".svx",".vcc",".w64",".xi",
+           #endif
+            // uncompressed WAV and AIFF are read by the sample cache itself
+            ".aif",".aifc",".aiff",".wav",
+            ".mp3"
+        };
+
+        using namespace ghc::filesystem;
+        directory_iterator it;
+
+        try {
+            it = directory_iterator(u8path(directory));
+        } DISTRHO_SAFE_EXCEPTION_RETURN("Failed to open current directory", false);
+
+        for (directory_iterator itb = begin(it), ite=end(it); itb != ite; ++itb)
+        {
+            if (! itb->is_regular_file())
+                continue;
+            const path filepath = itb->path();
+            const path extension = filepath.extension();
+            for (size_t i=0; i<ARRAY_SIZE(supportedExtensions); ++i)
+            {
+                if (extension.compare(supportedExtensions[i]) == 0)
+                {
+                    files.push_back({ filepath.generic_u8string(), filepath.filename().generic_u8string() });
+                    break;
+                }
+            }
+        }
+
+        std::sort(files.begin(), files.end());
+        return true;
+    }
+};
 
-#ifndef HEADLESS
 struct AudioFileListWidget : ImGuiWidget {
-    CarlaInternalPluginModule* const module;
+    AudioFileModule* const module;
+    SharedResourcePointer<AudioFileDirectoryLister> lister;
 
     bool showError = false;
+    bool listingPending = false;
     String errorMessage;
 
-    struct ghcFile {
-        std::string full, base;
-        bool operator<(const ghcFile& other) const noexcept { return base < other.base; }
-    };
+    typedef AudioFileDirectoryLister::ghcFile ghcFile;
     std::string currentDirectory;
     std::vector<ghcFile> currentFiles;
     size_t selectedFile = (size_t)-1;
 
-    AudioFileListWidget(CarlaInternalPluginModule* const m)
+    AudioFileListWidget(AudioFileModule* const m)
         : ImGuiWidget(),
           module(m)
     {
@@ -445,8 +411,7 @@ struct AudioFileListWidget : ImGuiWidget {
                     if (selected && ! wasSelected)
                     {
                         selectedFile = i;
-                        module->currentFile = currentFiles[i].full;
-                        module->fCarlaPluginDescriptor->set_custom_data(module->fCarlaPluginHandle, "file", currentFiles[i].full.c_str());
+                        module->setFile(currentFiles[i].full.c_str());
                     }
                 }
 
@@ -462,6 +427,12 @@ struct AudioFileListWidget : ImGuiWidget {
         if (module->fileChanged)
             reloadDir();
 
+        if (listingPending && lister->getListing(currentDirectory, currentFiles))
+        {
+            listingPending = false;
+            selectCurrentFile();
+        }
+
         ImGuiWidget::step();
     }
 
@@ -472,45 +443,22 @@ struct AudioFileListWidget : ImGuiWidget {
         currentFiles.clear();
         selectedFile = (size_t)-1;
 
-        static constexpr const char* const supportedExtensions[] = {
-           #ifdef HAVE_SNDFILE
-            ".aif",".aifc",".aiff",".au",".bwf",".flac",".htk",".iff",".mat4",".mat5",".oga",".ogg",".opus",
-            ".paf",".pvf",".pvf5",".sd2",".sf",".snd",".svx",".vcc",".w64",".wav",".xi",
-           #endif
-            ".mp3"
-        };
+        currentDirectory = ghc::filesystem::u8path(module->currentFile).parent_path().generic_u8string();
 
-        using namespace ghc::filesystem;
-        const path currentFile = u8path(module->currentFile);
-        currentDirectory = currentFile.parent_path().generic_u8string();
-
-        directory_iterator it;
-
-        try {
-            it = directory_iterator(u8path(currentDirectory));
-        } DISTRHO_SAFE_EXCEPTION_RETURN("Failed to open current directory",);
+        // cached listings are still checked for changes, the file list is filled in once that is done
+        listingPending = true;
+        lister->requestListing(currentDirectory);
+    }
 
-        for (directory_iterator itb = begin(it), ite=end(it); itb != ite; ++itb)
-        {
-            if (! itb->is_regular_file())
-                continue;
-            const path filepath = itb->path();
-            const path extension = filepath.extension();
-            for (size_t i=0; i<ARRAY_SIZE(supportedExtensions); ++i)
-            {
-                if (extension.compare(supportedExtensions[i]) == 0)
-                {
-                    currentFiles.push_back({ filepath.generic_u8string(), filepath.filename().generic_u8string() });
-                    break;
-                }
-            }
-        }
+    void selectCurrentFile()
+    {
+        selectedFile = (size_t)-1;
 
-        std::sort(currentFiles.begin(), currentFiles.end());
+        const std::string currentFile = ghc::filesystem::u8path(module->currentFile).generic_u8string();
 
         for (size_t index = 0; index < currentFiles.size(); ++index)
         {
-            if (currentFiles[index].full.compare(currentFile) == 0)
+            if (currentFiles[index].full == currentFile)
             {
                 selectedFile = index;
                 break;
@@ -530,12 +478,12 @@ struct AudioFileWidget : ModuleWidgetWithSideScrews<23> {
     static constexpr const float fileListHeight = 380.0f - startY_list - previewBoxHeight - previewBoxBottom * 1.5f;
     static constexpr const float startY_preview = startY_list + fileListHeight;
 
-    CarlaInternalPluginModule* const module;
+    AudioFileModule* const module;
     bool idleCallbackActive = false;
     bool visible = false;
     float lastPosition = 0.0f;
 
-    AudioFileWidget(CarlaInternalPluginModule* const m)
+    AudioFileWidget(AudioFileModule* const m)
         : module(m)
     {
         setModule(module);
@@ -558,6 +506,15 @@ struct AudioFileWidget : ModuleWidgetWithSideScrews<23> {
         }
     }
 
+    void step() override
+    {
+        // the waveform overview is ready some time after loading, depending on file size
+        if (module != nullptr && ! module->previewReady)
+            module->previewReady = module->cache->getStreamPreview(&module->stream, module->audioInfo.preview);
+
+        ModuleWidgetWithSideScrews<23>::step();
+    }
+
     void drawLayer(const DrawArgs& args, int layer) override
     {
         if (layer != 1)
@@ -638,24 +595,17 @@ struct AudioFileWidget : ModuleWidgetWithSideScrews<23> {
     {
         menu->addChild(new ui::MenuSeparator);
 
-        const bool looping = module->fCarlaPluginDescriptor->get_parameter_value(module->fCarlaPluginHandle,
-            CarlaInternalPluginModule::kParameterLooping) > 0.5f;
-        const bool hostSync = module->fCarlaPluginDescriptor->get_parameter_value(module->fCarlaPluginHandle,
-            CarlaInternalPluginModule::kParameterHostSync) > 0.5f;
-
-        menu->addChild(createMenuItem("Looping", looping ? CHECKMARK_STRING : "",
-            [=]() { module->fCarlaPluginDescriptor->set_parameter_value(module->fCarlaPluginHandle,
-                        CarlaInternalPluginModule::kParameterLooping, looping ? 0.0f : 1.0f); }
+        menu->addChild(createMenuItem("Looping", module->looping ? CHECKMARK_STRING : "",
+            [=]() { module->looping = ! module->looping; }
         ));
-        menu->addChild(createMenuItem("Host sync", hostSync ? CHECKMARK_STRING : "",
-            [=]() { module->fCarlaPluginDescriptor->set_parameter_value(module->fCarlaPluginHandle,
-                        CarlaInternalPluginModule::kParameterHostSync, hostSync ? 0.0f : 1.0f); }
+        menu->addChild(createMenuItem("Host sync", module->hostSync ? CHECKMARK_STRING : "",
+            [=]() { module->hostSync = ! module->hostSync; }
         ));
 
         struct LoadAudioFileItem : MenuItem {
-            CarlaInternalPluginModule* const module;
+            AudioFileModule* const module;
 
-            LoadAudioFileItem(CarlaInternalPluginModule* const m)
+            LoadAudioFileItem(AudioFileModule* const m)
                 : module(m)
             {
                 text = "Load audio file...";
@@ -663,15 +613,13 @@ struct AudioFileWidget : ModuleWidgetWithSideScrews<23> {
 
             void onAction(const event::Action&) override
             {
-                CarlaInternalPluginModule* const module = this->module;
+                AudioFileModule* const module = this->module;
                 async_dialog_filebrowser(false, nullptr, nullptr, text.c_str(), [module](char* path)
                 {
                     if (path == nullptr)
                         return;
 
-                    module->currentFile = path;
-                    module->fileChanged = true;
-                    module->fCarlaPluginDescriptor->set_custom_data(module->fCarlaPluginHandle, "file", path);
+                    module->setFile(path);
                     std::free(path);
                 });
             }
@@ -682,7 +630,7 @@ struct AudioFileWidget : ModuleWidgetWithSideScrews<23> {
 };
 #else
 struct AudioFileWidget : ModuleWidget {
-    AudioFileWidget(CarlaInternalPluginModule* const module) {
+    AudioFileWidget(AudioFileModule* const module) {
         setModule(module);
 
         addOutput(createOutput<PJ301MPort>({}, module, 0));
@@ -693,6 +641,6 @@ struct AudioFileWidget : ModuleWidget {
 
 // --------------------------------------------------------------------------------------------------------------------
 
-Model* modelAudioFile = createModel<CarlaInternalPluginModule, AudioFileWidget>("AudioFile");
+Model* modelAudioFile = createModel<AudioFileModule, AudioFileWidget>("AudioFile");
 
 // --------------------------------------------------------------------------------------------------------------------
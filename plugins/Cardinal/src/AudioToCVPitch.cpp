@@ -17,9 +17,12 @@
  */
 
 #include "plugin.hpp"
+#include "BlockPipeline.hpp"
 #include "ModuleWidgets.hpp"
 #include "Widgets.hpp"
 
+#include "extra/ScopedPointer.hpp"
+
 extern "C" {
 #include "aubio.h"
 }
@@ -35,12 +38,21 @@ static constexpr const float kDefaultSensitivity = 50.f;
 static constexpr const float kDefaultTolerance = 6.25f;
 static constexpr const float kDefaultThreshold = 12.5f;
 
+// results are applied once the next buffer is complete, so the analysis has a full buffer period to run.
+// if the worker thread could not be started the analysis runs inline, with results applied at the end of each buffer.
+static constexpr const uint32_t kDetectionLatency = kAubioBufferSize * 2;
+static constexpr const uint32_t kInlineDetectionLatency = kAubioBufferSize;
+
 // static checks
 static_assert(sizeof(smpl_t) == sizeof(float), "smpl_t is float");
 static_assert(kAubioBufferSize % kAubioHopSize == 0, "kAubioBufferSize / kAubioHopSize has no remainder");
 
 // --------------------------------------------------------------------------------------------------------------------
 
+static void pipeline_process_block(void* handle);
+
+// --------------------------------------------------------------------------------------------------------------------
+
 struct AudioToCVPitch : Module {
     enum ParamIds {
         PARAM_SENSITIVITY,
@@ -66,20 +78,35 @@ struct AudioToCVPitch : Module {
     bool smooth = true;
     int octave = 0;
 
+    // first channel only, used for display
     float lastKnownPitchInHz = 0.f;
     float lastKnownPitchConfidence = 0.f;
 
-    float lastUsedTolerance = kDefaultTolerance;
-    float lastUsedOutputPitch = 0.f;
-    float lastUsedOutputSignal = 0.f;
+    float lastUsedOutputPitch[PORT_MAX_CHANNELS] = {};
+    float lastUsedOutputSignal[PORT_MAX_CHANNELS] = {};
+    dsp::SlewLimiter smoothOutputSignal[PORT_MAX_CHANNELS];
 
-    fvec_t* const detectedPitch = new_fvec(1);
-    fvec_t* const inputBuffer = new_fvec(kAubioBufferSize);
+    // filled by the audio thread, channel count changes are only applied in between buffers
+    float inputBuffer[PORT_MAX_CHANNELS][kAubioBufferSize];
     uint32_t inputBufferPos = 0;
+    int numChannels = 1;
+
+    // owned by the pipeline worker while it is busy.
+    // detectors are only created for channels that have been in use, by the worker or on sample rate changes.
+    fvec_t* analysisBuffer[PORT_MAX_CHANNELS];
+    fvec_t* detectedPitch[PORT_MAX_CHANNELS];
+    aubio_pitch_t* pitchDetector[PORT_MAX_CHANNELS] = {};
+    float detectedPitchInHz[PORT_MAX_CHANNELS] = {};
+    float detectedPitchConfidence[PORT_MAX_CHANNELS] = {};
+    int analysisChannels = 0;
+    int numDetectors = 0;
+    float analysisTolerance = kDefaultTolerance;
+    float lastUsedTolerance = kDefaultTolerance;
+    float sampleRate = 0.f;
 
-    aubio_pitch_t* pitchDetector = nullptr;
-
-    dsp::SlewLimiter smoothOutputSignal;
+    // runs for the lifetime of the module and sleeps while there is nothing to analyse,
+    // so that starting and stopping it never happens in the engine's port or cable changes
+    ScopedPointer<BlockPipelineWorker> pipelineWorker;
 
     AudioToCVPitch()
     {
@@ -91,61 +118,172 @@ struct AudioToCVPitch : Module {
         configParam(PARAM_SENSITIVITY, 0.1f, 99.f, kDefaultSensitivity, "Sensitivity", " %");
         configParam(PARAM_CONFIDENCETHRESHOLD, 0.f, 99.f, kDefaultThreshold, "Confidence Threshold", " %");
         configParam(PARAM_TOLERANCE, 0.f, 99.f,  kDefaultTolerance, "Tolerance", " %");
+
+        for (int c = 0; c < PORT_MAX_CHANNELS; ++c)
+        {
+            analysisBuffer[c] = new_fvec(kAubioBufferSize);
+            detectedPitch[c] = new_fvec(1);
+        }
+
+        std::memset(inputBuffer, 0, sizeof(inputBuffer));
+
+        pipelineWorker = new BlockPipelineWorker(pipeline_process_block, this);
+        pipelineWorker->start();
     }
 
     ~AudioToCVPitch() override
     {
-        if (pitchDetector != nullptr)
-            del_aubio_pitch(pitchDetector);
-        del_fvec(detectedPitch);
-        del_fvec(inputBuffer);
+        pipelineWorker = nullptr;
+
+        for (int c = 0; c < PORT_MAX_CHANNELS; ++c)
+        {
+            if (pitchDetector[c] != nullptr)
+                del_aubio_pitch(pitchDetector[c]);
+            del_fvec(analysisBuffer[c]);
+            del_fvec(detectedPitch[c]);
+        }
     }
 
     void process(const ProcessArgs& args) override
     {
-        float cvPitch = lastUsedOutputPitch;
-        float cvSignal = lastUsedOutputSignal;
+        const float sensitivity = params[PARAM_SENSITIVITY].getValue();
 
-        inputBuffer->data[inputBufferPos] = inputs[AUDIO_INPUT].getVoltage() * 0.1f
-                                          * params[PARAM_SENSITIVITY].getValue();
+        for (int c = 0; c < numChannels; ++c)
+            inputBuffer[c][inputBufferPos] = inputs[AUDIO_INPUT].getVoltage(c) * 0.1f * sensitivity;
 
         if (++inputBufferPos == kAubioBufferSize)
         {
             inputBufferPos = 0;
 
-            const float tolerance = params[PARAM_TOLERANCE].getValue();
-            if (d_isNotEqual(lastUsedTolerance, tolerance))
+            // results from the previous buffer, analysed while this one was being filled
+            const bool pipelined = pipelineWorker->isRunning();
+
+            if (pipelined)
             {
-                lastUsedTolerance = tolerance;
-                aubio_pitch_set_tolerance(pitchDetector, tolerance * 0.01f);
+                pipelineWorker->waitForBlock();
+                applyDetectedPitch();
             }
 
-            aubio_pitch_do(pitchDetector, inputBuffer, detectedPitch);
-            const float detectedPitchInHz = fvec_get_sample(detectedPitch, 0);
-            const float pitchConfidence = aubio_pitch_get_confidence(pitchDetector);
+            for (int c = 0; c < numChannels; ++c)
+                std::memcpy(analysisBuffer[c]->data, inputBuffer[c], sizeof(float) * kAubioBufferSize);
+
+            analysisChannels = numChannels;
+            analysisTolerance = params[PARAM_TOLERANCE].getValue();
+
+            if (pipelined)
+            {
+                pipelineWorker->startBlock();
+            }
+            else
+            {
+                detectPitch(false);
+                applyDetectedPitch();
+            }
+
+            numChannels = std::max(1, inputs[AUDIO_INPUT].getChannels());
+        }
+
+        outputs[CV_PITCH].setChannels(numChannels);
+        outputs[CV_GATE].setChannels(numChannels);
+
+        for (int c = 0; c < numChannels; ++c)
+        {
+            const float cvPitch = lastUsedOutputPitch[c];
+            outputs[CV_PITCH].setVoltage(smooth ? smoothOutputSignal[c].process(args.sampleTime, cvPitch) : cvPitch, c);
+            outputs[CV_GATE].setVoltage(lastUsedOutputSignal[c], c);
+        }
+    }
+
+    void applyDetectedPitch()
+    {
+        const float threshold = params[PARAM_CONFIDENCETHRESHOLD].getValue() * 0.01f;
+
+        for (int c = 0; c < analysisChannels; ++c)
+        {
+            const float pitchInHz = detectedPitchInHz[c];
+            const float pitchConfidence = detectedPitchConfidence[c];
+            float cvPitch = lastUsedOutputPitch[c];
+            float cvSignal;
 
-            if (detectedPitchInHz > 0.f && pitchConfidence >=  params[PARAM_CONFIDENCETHRESHOLD].getValue() * 0.01f)
+            if (pitchInHz > 0.f && pitchConfidence >= threshold)
             {
-                const float linearPitch = 12.f * (log2f(detectedPitchInHz / 440.f) + octave - 5) + 69.f;
+                const float linearPitch = 12.f * (log2f(pitchInHz / 440.f) + octave - 5) + 69.f;
                 cvPitch = std::max(-10.f, std::min(10.f, linearPitch * (1.f/12.f)));
-                lastKnownPitchInHz = detectedPitchInHz;
                 cvSignal = 10.f;
+
+                if (c == 0)
+                    lastKnownPitchInHz = pitchInHz;
             }
             else
             {
                 if (! holdOutputPitch)
-                    lastKnownPitchInHz = cvPitch = 0.0f;
+                {
+                    cvPitch = 0.f;
+
+                    if (c == 0)
+                        lastKnownPitchInHz = 0.f;
+                }
 
                 cvSignal = 0.f;
             }
 
-            lastKnownPitchConfidence = pitchConfidence;
-            lastUsedOutputPitch = cvPitch;
-            lastUsedOutputSignal = cvSignal;
+            if (c == 0)
+                lastKnownPitchConfidence = pitchConfidence;
+
+            lastUsedOutputPitch[c] = cvPitch;
+            lastUsedOutputSignal[c] = cvSignal;
         }
+    }
+
+    // in effect at the moment, depending on whether the worker thread is running
+    uint32_t getDetectionLatency() const
+    {
+        return pipelineWorker->isRunning() ? kDetectionLatency : kInlineDetectionLatency;
+    }
+
+    aubio_pitch_t* createPitchDetector(const float tolerance) const
+    {
+        aubio_pitch_t* const detector = new_aubio_pitch("yinfast", kAubioBufferSize, kAubioHopSize, sampleRate);
+        DISTRHO_SAFE_ASSERT_RETURN(detector != nullptr, nullptr);
 
-        outputs[CV_PITCH].setVoltage(smooth ? smoothOutputSignal.process(args.sampleTime, cvPitch) : cvPitch);
-        outputs[CV_GATE].setVoltage(cvSignal);
+        aubio_pitch_set_silence(detector, -30.0f);
+        aubio_pitch_set_tolerance(detector, tolerance);
+        aubio_pitch_set_unit(detector, "Hz");
+        return detector;
+    }
+
+    // called from the pipeline worker, or inline from the audio thread which must not create detectors
+    void detectPitch(const bool canCreateDetectors = true)
+    {
+        const bool toleranceChanged = d_isNotEqual(lastUsedTolerance, analysisTolerance);
+        lastUsedTolerance = analysisTolerance;
+
+        if (canCreateDetectors && d_isNotZero(sampleRate))
+        {
+            for (; numDetectors < analysisChannels; ++numDetectors)
+                pitchDetector[numDetectors] = createPitchDetector(analysisTolerance * 0.01f);
+        }
+
+        for (int c = 0; c < PORT_MAX_CHANNELS; ++c)
+        {
+            aubio_pitch_t* const detector = pitchDetector[c];
+
+            if (detector == nullptr)
+            {
+                detectedPitchInHz[c] = detectedPitchConfidence[c] = 0.f;
+                continue;
+            }
+
+            if (toleranceChanged)
+                aubio_pitch_set_tolerance(detector, analysisTolerance * 0.01f);
+
+            if (c >= analysisChannels)
+                continue;
+
+            aubio_pitch_do(detector, analysisBuffer[c], detectedPitch[c]);
+            detectedPitchInHz[c] = fvec_get_sample(detectedPitch[c], 0);
+            detectedPitchConfidence[c] = aubio_pitch_get_confidence(detector);
+        }
     }
 
     void onReset() override
@@ -158,28 +296,25 @@ struct AudioToCVPitch : Module {
 
     void onSampleRateChange(const SampleRateChangeEvent& e) override
     {
-        float tolerance;
+        pipelineWorker->waitForBlock();
+        analysisChannels = 0;
 
-        if (pitchDetector != nullptr)
-        {
-            tolerance = aubio_pitch_get_tolerance(pitchDetector);
-            del_aubio_pitch(pitchDetector);
-        }
-        else
-        {
-            tolerance = kDefaultTolerance * 0.01f;
-        }
+        sampleRate = e.sampleRate;
 
-        pitchDetector = new_aubio_pitch("yinfast", kAubioBufferSize, kAubioHopSize, e.sampleRate);
-        DISTRHO_SAFE_ASSERT_RETURN(pitchDetector != nullptr,);
+        const float tolerance = lastUsedTolerance * 0.01f;
+        const double fall = 1.0 / (double(kAubioBufferSize) / e.sampleRate);
 
-        aubio_pitch_set_silence(pitchDetector, -30.0f);
-        aubio_pitch_set_tolerance(pitchDetector, tolerance);
-        aubio_pitch_set_unit(pitchDetector, "Hz");
+        for (int c = 0; c < PORT_MAX_CHANNELS; ++c)
+        {
+            smoothOutputSignal[c].reset();
+            smoothOutputSignal[c].setRiseFall(fall, fall);
 
-        const double fall = 1.0 / (double(kAubioBufferSize) / e.sampleRate);
-        smoothOutputSignal.reset();
-        smoothOutputSignal.setRiseFall(fall, fall);
+            if (pitchDetector[c] != nullptr)
+                del_aubio_pitch(pitchDetector[c]);
+
+            // only recreate detectors for channels used so far, the worker creates the others when needed
+            pitchDetector[c] = c < numDetectors ? createPitchDetector(tolerance) : nullptr;
+        }
     }
 
     json_t* dataToJson() override
@@ -207,6 +342,11 @@ struct AudioToCVPitch : Module {
     }
 };
 
+static void pipeline_process_block(void* const handle)
+{
+    static_cast<AudioToCVPitch*>(handle)->detectPitch();
+}
+
 #ifndef HEADLESS
 struct SmallPercentageNanoKnob : NanoKnob<2, 0> {
     SmallPercentageNanoKnob() {
@@ -347,6 +487,7 @@ struct AudioToCVPitchWidget : ModuleWidgetWith9HP {
     {
         menu->addChild(new MenuSeparator);
 
+        menu->addChild(createMenuLabel(string::f("Detection latency: %u samples", module->getDetectionLatency())));
         menu->addChild(createBoolPtrMenuItem("Hold Output Pitch", "", &module->holdOutputPitch));
         menu->addChild(createBoolPtrMenuItem("Smooth Output Pitch", "", &module->smooth));
 
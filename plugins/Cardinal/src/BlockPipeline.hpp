@@ -0,0 +1,131 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE file.
+ */
+
+#pragma once
+
+#include "extra/Mutex.hpp"
+#include "extra/Thread.hpp"
+
+#include <atomic>
+
+// --------------------------------------------------------------------------------------------------------------------
+// Worker thread for running a module's block processing one block behind the engine.
+// The audio thread hands over a filled block with `startBlock()` and must call `waitForBlock()` before touching any
+// data the worker uses, typically right before handing over the next block.
+// The thread only runs in between `start()` and `stop()` or `requestStop()`, so that modules only have it while needed.
+
+struct BlockPipelineWorker : Thread {
+    typedef void (*ProcessBlockFunc)(void* handle);
+
+    BlockPipelineWorker(const ProcessBlockFunc func, void* const handle)
+        : Thread("BlockPipelineWorker"),
+          processBlockFunc(func),
+          processBlockHandle(handle),
+          busy(false),
+          stopRequested(true) {}
+
+    ~BlockPipelineWorker() override
+    {
+        stop();
+    }
+
+    // whether blocks can be handed over
+    bool isRunning() const noexcept
+    {
+        return ! stopRequested && isThreadRunning();
+    }
+
+    bool isBusy() const noexcept
+    {
+        return busy;
+    }
+
+    // starts the thread if not running yet, must not be called from the audio thread
+    void start()
+    {
+        if (! stopRequested)
+            return;
+
+        // a thread asked to stop by requestStop() may still be on its way out
+        while (isThreadRunning())
+            d_msleep(1);
+
+        busy = false;
+        stopRequested = false;
+        startThread(true);
+    }
+
+    // finishes the block in flight and stops the thread, must not be called from the audio thread
+    void stop()
+    {
+        waitForBlock();
+        stopRequested = true;
+        requestSignal.signal();
+        stopThread(-1);
+    }
+
+    // lets the thread exit without waiting for it, can be called from the audio thread once no block is in flight
+    void requestStop() noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(! busy,);
+
+        stopRequested = true;
+        requestSignal.signal();
+    }
+
+    void startBlock() noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(! busy,);
+
+        busy = true;
+        requestSignal.signal();
+    }
+
+    void waitForBlock() noexcept
+    {
+        if (! busy)
+            return;
+
+        doneSignal.wait();
+        busy = false;
+    }
+
+protected:
+    void run() override
+    {
+        for (;;)
+        {
+            requestSignal.wait();
+
+            if (stopRequested)
+                break;
+
+            processBlockFunc(processBlockHandle);
+            doneSignal.signal();
+        }
+    }
+
+private:
+    const ProcessBlockFunc processBlockFunc;
+    void* const processBlockHandle;
+    Signal requestSignal;
+    Signal doneSignal;
+    bool busy;
+    std::atomic<bool> stopRequested;
+};
+
+// --------------------------------------------------------------------------------------------------------------------
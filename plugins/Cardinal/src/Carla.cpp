@@ -17,9 +17,12 @@
 
 #include "plugin.hpp"
 #include "plugincontext.hpp"
+#include "BlockPipeline.hpp"
 #include "Expander.hpp"
 #include "ModuleWidgets.hpp"
 
+#include "extra/ScopedPointer.hpp"
+
 #include "CarlaNativePlugin.h"
 #include "CarlaBackendUtils.hpp"
 #include "CarlaEngine.hpp"
@@ -33,8 +36,6 @@ json_t *jsonp_stringn_nocheck_own(const char* value, size_t len);
 }
 #endif
 
-#define BUFFER_SIZE 128
-
 // generates a warning if this is defined as anything else
 #define CARLA_API
 
@@ -54,6 +55,7 @@ static void host_ui_closed(NativeHostHandle handle);
 static const char* host_ui_open_file(NativeHostHandle handle, bool isDir, const char* title, const char* filter);
 static const char* host_ui_save_file(NativeHostHandle handle, bool isDir, const char* title, const char* filter);
 static intptr_t host_dispatcher(NativeHostHandle handle, NativeHostDispatcherOpcode opcode, int32_t index, intptr_t value, void* ptr, float opt);
+static void pipeline_process_block(void* handle);
 
 // --------------------------------------------------------------------------------------------------------------------
 
@@ -61,6 +63,8 @@ struct CarlaModule : Module {
     enum ParamIds {
         BIPOLAR_INPUTS,
         BIPOLAR_OUTPUTS,
+        BLOCK_SIZE,
+        PIPELINED,
         NUM_PARAMS
     };
     enum InputIds {
@@ -79,7 +83,7 @@ struct CarlaModule : Module {
         NUM_LIGHTS
     };
 
-    const CardinalPluginContext* const pcontext;
+    CardinalPluginContext* const pcontext;
 
     const NativePluginDescriptor* fCarlaPluginDescriptor = nullptr;
     NativePluginHandle fCarlaPluginHandle = nullptr;
@@ -91,13 +95,28 @@ struct CarlaModule : Module {
 
     void* fUI = nullptr;
 
-    float dataIn[NUM_INPUTS][BUFFER_SIZE];
-    float dataOut[NUM_OUTPUTS][BUFFER_SIZE];
-    float* dataInPtr[NUM_INPUTS];
-    float* dataOutPtr[NUM_OUTPUTS];
+    // double buffered, the audio thread uses dataIndex while the pipeline worker uses the other one
+    float dataIn[2][NUM_INPUTS][MODULE_BLOCK_SIZE_MAX];
+    float dataOut[2][NUM_OUTPUTS][MODULE_BLOCK_SIZE_MAX];
+    float* dataInPtr[2][NUM_INPUTS];
+    float* dataOutPtr[2][NUM_OUTPUTS];
     unsigned audioDataFill = 0;
+    uint dataIndex = 0;
+    uint32_t blockSize;
+    uint32_t latency = 0;
     uint32_t lastProcessCounter = 0;
     CardinalExpanderFromCarlaMIDIToCV* midiOutExpander = nullptr;
+
+    // MIDI is copied in and out of the expanders in between blocks, so the worker never touches them
+    uint midiInEventCount = 0;
+    uint midiOutEventCount = 0;
+    NativeMidiEvent midiInEvents[CardinalExpanderFromCVToCarlaMIDI::MAX_MIDI_EVENTS];
+    NativeMidiEvent midiOutEvents[CardinalExpanderFromCarlaMIDIToCV::MAX_MIDI_EVENTS];
+
+    ScopedPointer<BlockPipelineWorker> pipelineWorker;
+    bool pipelined = false;
+    uint pipelineIndex = 0;
+    uint32_t pipelineFrames = 0;
     std::string patchStorage;
 
 #ifdef CARLA_OS_WIN
@@ -111,11 +130,18 @@ struct CarlaModule : Module {
         config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
         configParam<SwitchQuantity>(BIPOLAR_INPUTS, 0.f, 1.f, 1.f, "Bipolar CV Inputs")->randomizeEnabled = false;
         configParam<SwitchQuantity>(BIPOLAR_OUTPUTS, 0.f, 1.f, 1.f, "Bipolar CV Outputs")->randomizeEnabled = false;
+        configSwitch(BLOCK_SIZE, 0.f, 5.f, 0.f, "Block size", getModuleBlockSizeLabels())->randomizeEnabled = false;
+        configParam<SwitchQuantity>(PIPELINED, 0.f, 1.f, 0.f, "Pipelined processing")->randomizeEnabled = false;
 
-        for (uint i=0; i<NUM_INPUTS; ++i)
-            dataInPtr[i] = dataIn[i];
-        for (uint i=0; i<NUM_OUTPUTS; ++i)
-            dataOutPtr[i] = dataOut[i];
+        blockSize = getModuleBlockSize(pcontext->bufferSize, 0);
+
+        for (uint j=0; j<2; ++j)
+        {
+            for (uint i=0; i<NUM_INPUTS; ++i)
+                dataInPtr[j][i] = dataIn[j][i];
+            for (uint i=0; i<NUM_OUTPUTS; ++i)
+                dataOutPtr[j][i] = dataOut[j][i];
+        }
 
         for (uint i=0; i<2; ++i)
         {
@@ -220,10 +246,15 @@ struct CarlaModule : Module {
                                            0, 0, nullptr, 0.0f);
 
         fCarlaPluginDescriptor->activate(fCarlaPluginHandle);
+
+        pipelineWorker = new BlockPipelineWorker(pipeline_process_block, this);
     }
 
     ~CarlaModule() override
     {
+        // must be stopped before the plugin goes away
+        pipelineWorker = nullptr;
+
         if (fCarlaPluginHandle != nullptr)
             fCarlaPluginDescriptor->deactivate(fCarlaPluginHandle);
 
@@ -290,8 +321,18 @@ struct CarlaModule : Module {
 #endif
     }
 
+    // starting the worker thread is not realtime safe, so it happens here instead of in process().
+    // called when loading and from the module widget step(), which picks up changes from automation or undo.
+    void startPipelineWorkerIfNeeded()
+    {
+        if (pipelineWorker != nullptr && params[PIPELINED].getValue() > 0.1f)
+            pipelineWorker->start();
+    }
+
     void dataFromJson(json_t* const rootJ) override
     {
+        startPipelineWorkerIfNeeded();
+
         if (fCarlaHostHandle == nullptr)
             return;
 
@@ -307,6 +348,7 @@ struct CarlaModule : Module {
     void onAdd(const AddEvent&) override
     {
         patchStorage = getPatchStorageDirectory();
+        startPipelineWorkerIfNeeded();
     }
 
     void process(const ProcessArgs& args) override
@@ -320,17 +362,30 @@ struct CarlaModule : Module {
         const unsigned k = audioDataFill++;
 
         for (uint i=0; i<2; ++i)
-            dataIn[i][k] = inputs[i].getVoltage() * 0.1f;
+            dataIn[dataIndex][i][k] = inputs[i].getVoltage() * 0.1f;
         for (uint i=2; i<NUM_INPUTS; ++i)
-            dataIn[i][k] = inputs[i].getVoltage() + inputOffset;
+            dataIn[dataIndex][i][k] = inputs[i].getVoltage() + inputOffset;
 
         for (uint i=0; i<2; ++i)
-            outputs[i].setVoltage(dataOut[i][k] * 10.0f);
+            outputs[i].setVoltage(dataOut[dataIndex][i][k] * 10.0f);
         for (uint i=2; i<NUM_OUTPUTS; ++i)
-            outputs[i].setVoltage(dataOut[i][k] + outputOffset);
+            outputs[i].setVoltage(dataOut[dataIndex][i][k] + outputOffset);
+
+        // pipelined processing adds one extra block of latency
+        const uint32_t newLatency = pipelined ? blockSize * 2 : blockSize;
+
+        if (latency != newLatency)
+        {
+            latency = newLatency;
+            pcontext->setModuleLatency(this, latency);
+        }
 
-        if (audioDataFill == BUFFER_SIZE)
+        if (audioDataFill >= blockSize)
         {
+            // the worker shares time and MIDI data with us, let it finish the previous block first
+            if (pipelined)
+                pipelineWorker->waitForBlock();
+
             const uint32_t processCounter = pcontext->processCounter;
 
             // Update time position if running a new audio block
@@ -349,10 +404,10 @@ struct CarlaModule : Module {
                 fCarlaTimeInfo.bbt.ticksPerBeat = pcontext->ticksPerBeat;
                 fCarlaTimeInfo.bbt.beatsPerMinute = pcontext->beatsPerMinute;
             }
-            // or advance time by BUFFER_SIZE frames if still under the same audio block
+            // or advance time by blockSize frames if still under the same audio block
             else if (fCarlaTimeInfo.playing)
             {
-                fCarlaTimeInfo.frame += BUFFER_SIZE;
+                fCarlaTimeInfo.frame += blockSize;
 
                 // adjust BBT as well
                 if (fCarlaTimeInfo.bbt.valid)
@@ -363,7 +418,7 @@ struct CarlaModule : Module {
 
                     int32_t newBar = fCarlaTimeInfo.bbt.bar;
                     int32_t newBeat = fCarlaTimeInfo.bbt.beat;
-                    double newTick = fCarlaTimeInfo.bbt.tick + (double)BUFFER_SIZE / samplesPerTick;
+                    double newTick = fCarlaTimeInfo.bbt.tick + (double)blockSize / samplesPerTick;
 
                     while (newTick >= fCarlaTimeInfo.bbt.ticksPerBeat)
                     {
@@ -384,31 +439,91 @@ struct CarlaModule : Module {
                 }
             }
 
-            NativeMidiEvent* midiEvents;
-            uint midiEventCount;
-
             if (CardinalExpanderFromCVToCarlaMIDI* const midiInExpander = leftExpander.module != nullptr && leftExpander.module->model == modelExpanderInputMIDI
                                                                         ? static_cast<CardinalExpanderFromCVToCarlaMIDI*>(leftExpander.module)
                                                                         : nullptr)
             {
-                midiEvents = midiInExpander->midiEvents;
-                midiEventCount = midiInExpander->midiEventCount;
+                midiInEventCount = midiInExpander->midiEventCount;
+                std::memcpy(midiInEvents, midiInExpander->midiEvents, sizeof(NativeMidiEvent) * midiInEventCount);
                 midiInExpander->midiEventCount = midiInExpander->frame = 0;
             }
             else
             {
-                midiEvents = nullptr;
-                midiEventCount = 0;
+                midiInEventCount = 0;
             }
 
-            if ((midiOutExpander = rightExpander.module != nullptr && rightExpander.module->model == modelExpanderOutputMIDI
-                                 ? static_cast<CardinalExpanderFromCarlaMIDIToCV*>(rightExpander.module)
-                                 : nullptr))
-                midiOutExpander->midiEventCount = 0;
+            midiOutExpander = rightExpander.module != nullptr && rightExpander.module->model == modelExpanderOutputMIDI
+                            ? static_cast<CardinalExpanderFromCarlaMIDIToCV*>(rightExpander.module)
+                            : nullptr;
 
+            const uint32_t frames = blockSize;
             audioDataFill = 0;
-            fCarlaPluginDescriptor->process(fCarlaPluginHandle, dataInPtr, dataOutPtr, BUFFER_SIZE, midiEvents, midiEventCount);
+
+            // block size changes are only applied in between blocks
+            const uint32_t newBlockSize = getModuleBlockSize(pcontext->bufferSize, params[BLOCK_SIZE].getValue() + 0.5f);
+
+            if (blockSize != newBlockSize)
+            {
+                if (newBlockSize > blockSize)
+                {
+                    for (uint j=0; j<2; ++j)
+                        for (uint i=0; i<NUM_OUTPUTS; ++i)
+                            std::memset(dataOut[j][i] + blockSize, 0, sizeof(float) * (newBlockSize - blockSize));
+                }
+
+                blockSize = newBlockSize;
+            }
+
+            // so are pipelining changes, the block still in flight is dropped when disabling
+            const bool wantsPipelining = params[PIPELINED].getValue() > 0.1f;
+            const bool newPipelined = wantsPipelining && pipelineWorker->isRunning();
+
+            if (pipelined != newPipelined)
+            {
+                pipelined = newPipelined;
+
+                if (newPipelined)
+                    std::memset(dataOut[1 - dataIndex], 0, sizeof(dataOut[0]));
+            }
+
+            // no block is in flight at this point, let the worker thread go while it is not needed
+            if (! wantsPipelining && pipelineWorker->isRunning())
+                pipelineWorker->requestStop();
+
+            if (pipelined)
+            {
+                // hand over this block and start outputting the one the worker has just finished
+                flushMidiOutput();
+                pipelineIndex = dataIndex;
+                pipelineFrames = frames;
+                pipelineWorker->startBlock();
+                dataIndex = 1 - dataIndex;
+            }
+            else
+            {
+                processBlock(dataIndex, frames);
+                flushMidiOutput();
+            }
+        }
+    }
+
+    // called from the audio thread, or from the pipeline worker when pipelined
+    void processBlock(const uint index, const uint32_t frames)
+    {
+        midiOutEventCount = 0;
+        fCarlaPluginDescriptor->process(fCarlaPluginHandle, dataInPtr[index], dataOutPtr[index], frames,
+                                        midiInEvents, midiInEventCount);
+    }
+
+    void flushMidiOutput()
+    {
+        if (midiOutExpander != nullptr)
+        {
+            std::memcpy(midiOutExpander->midiEvents, midiOutEvents, sizeof(NativeMidiEvent) * midiOutEventCount);
+            midiOutExpander->midiEventCount = midiOutEventCount;
         }
+
+        midiOutEventCount = 0;
     }
 
     void onReset() override
@@ -423,6 +538,9 @@ struct CarlaModule : Module {
 
         midiOutExpander = nullptr;
 
+        if (pipelined)
+            pipelineWorker->waitForBlock();
+
         fCarlaPluginDescriptor->deactivate(fCarlaPluginHandle);
         fCarlaPluginDescriptor->dispatcher(fCarlaPluginHandle, NATIVE_PLUGIN_OPCODE_SAMPLE_RATE_CHANGED,
                                            0, 0, nullptr, e.sampleRate);
@@ -436,7 +554,8 @@ static_assert((int)CarlaModule::NUM_INPUTS == (int)CarlaModule::NUM_OUTPUTS, "in
 
 static uint32_t host_get_buffer_size(const NativeHostHandle handle)
 {
-    return BUFFER_SIZE;
+    // processing happens in blocks of up to this size
+    return MODULE_BLOCK_SIZE_MAX;
 }
 
 static double host_get_sample_rate(const NativeHostHandle handle)
@@ -458,17 +577,19 @@ static const NativeTimeInfo* host_get_time_info(const NativeHostHandle handle)
 
 static bool host_write_midi_event(const NativeHostHandle handle, const NativeMidiEvent* const event)
 {
-    if (CardinalExpanderFromCarlaMIDIToCV* const expander = static_cast<CarlaModule*>(handle)->midiOutExpander)
-    {
-        if (expander->midiEventCount == CardinalExpanderFromCarlaMIDIToCV::MAX_MIDI_EVENTS)
-            return false;
+    CarlaModule* const module = static_cast<CarlaModule*>(handle);
 
-        NativeMidiEvent& expanderEvent(expander->midiEvents[expander->midiEventCount++]);
-        carla_copyStruct(expanderEvent, *event);
-        return true;
-    }
+    if (module->midiOutEventCount == CardinalExpanderFromCarlaMIDIToCV::MAX_MIDI_EVENTS)
+        return false;
 
-    return false;
+    carla_copyStruct(module->midiOutEvents[module->midiOutEventCount++], *event);
+    return true;
+}
+
+static void pipeline_process_block(void* const handle)
+{
+    CarlaModule* const module = static_cast<CarlaModule*>(handle);
+    module->processBlock(module->pipelineIndex, module->pipelineFrames);
 }
 
 static void host_ui_midi_program_changed(NativeHostHandle handle, uint8_t channel, uint32_t bank, uint32_t program)
@@ -674,6 +795,9 @@ struct CarlaModuleWidget : ModuleWidgetWith9HP, IdleCallback {
                              && module->rightExpander.module != nullptr
                              && module->rightExpander.module->model == modelExpanderOutputMIDI;
 
+        if (module != nullptr)
+            module->startPipelineWorkerIfNeeded();
+
         ModuleWidgetWith9HP::step();
     }
 
@@ -704,6 +828,19 @@ struct CarlaModuleWidget : ModuleWidgetWith9HP, IdleCallback {
             [=]() {return module->params[CarlaModule::BIPOLAR_OUTPUTS].getValue() > 0.1f;},
             [=]() {module->params[CarlaModule::BIPOLAR_OUTPUTS].setValue(1.0f - module->params[CarlaModule::BIPOLAR_OUTPUTS].getValue());}
         ));
+
+        menu->addChild(createIndexSubmenuItem("Block size", getModuleBlockSizeLabels(),
+            [=]() {return static_cast<size_t>(module->params[CarlaModule::BLOCK_SIZE].getValue() + 0.5f);},
+            [=](size_t index) {module->params[CarlaModule::BLOCK_SIZE].setValue(index);}
+        ));
+
+        menu->addChild(createCheckMenuItem("Pipelined processing", "+1 block latency",
+            [=]() {return module->params[CarlaModule::PIPELINED].getValue() > 0.1f;},
+            [=]() {
+                module->params[CarlaModule::PIPELINED].setValue(1.0f - module->params[CarlaModule::PIPELINED].getValue());
+                module->startPipelineWorkerIfNeeded();
+            }
+        ));
     }
 
     void onDoubleClick(const DoubleClickEvent& e) override
@@ -756,6 +893,6 @@ static const char* host_ui_open_file(const NativeHostHandle handle,
 
 // --------------------------------------------------------------------------------------------------------------------
 
-Model* modelCarla = createModel<CarlaModule, CarlaModuleWidget>("Carla");
+Model* modelCarla = createModelWithWidgetOnEngineLoad<CarlaModule, CarlaModuleWidget>("Carla");
 
 // --------------------------------------------------------------------------------------------------------------------
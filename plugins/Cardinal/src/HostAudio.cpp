@@ -20,6 +20,7 @@
 #include "ModuleWidgets.hpp"
 #include "Widgets.hpp"
 #include "engine/TerminalModule.hpp"
+#include "engine/VisualStateProvider.hpp"
 
 // -----------------------------------------------------------------------------------------------------------
 
@@ -125,18 +126,16 @@ struct HostAudio : TerminalModule {
     }
 };
 
-struct HostAudio2 : HostAudio<2> {
-#ifndef HEADLESS
-    // for stereo meter
+struct HostAudio2 : HostAudio<2>, VisualStateProvider {
+    // for stereo meter, also computed in the headless DSP side of the Mini variant, which publishes it to its UI
     uint32_t internalDataFrame = 0;
     float internalDataBufferL[128] = {};
     float internalDataBufferR[128] = {};
     volatile bool resetMeters = true;
     float gainMeterL = 0.0f;
     float gainMeterR = 0.0f;
-#endif
+    bool visualSilenceSent = false;
 
-#ifndef HEADLESS
     void onReset() override
     {
         HostAudio<2>::onReset();
@@ -148,20 +147,48 @@ struct HostAudio2 : HostAudio<2> {
         HostAudio<2>::onSampleRateChange(e);
         resetMeters = true;
     }
-#endif
+
+    // meter values since the previous call, which are then reset as the meter widget does
+    void getVisualState(std::vector<uint8_t>& data) override
+    {
+        if (resetMeters)
+            return;
+
+        // silence only needs to be sent once
+        const bool silent = d_isZero(gainMeterL) && d_isZero(gainMeterR);
+        if (silent && visualSilenceSent)
+            return;
+        visualSilenceSent = silent;
+
+        const float values[2] = { gainMeterL, gainMeterR };
+        const uint8_t* const bytes = reinterpret_cast<const uint8_t*>(values);
+        data.insert(data.end(), bytes, bytes + sizeof(values));
+
+        resetMeters = true;
+    }
+
+    void setVisualState(const uint8_t* const data, const size_t size) override
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(size == sizeof(float) * 2,);
+
+        float values[2];
+        std::memcpy(values, data, sizeof(values));
+
+        gainMeterL = values[0];
+        gainMeterR = values[1];
+        resetMeters = false;
+    }
 
     void processTerminalOutput(const ProcessArgs&) override
     {
         if (pcontext->bypassed || (!in1connected && !in2connected))
         {
-#ifndef HEADLESS
             if (resetMeters)
             {
                 internalDataFrame = 0;
                 gainMeterL = gainMeterR = 0.0f;
                 resetMeters = false;
             }
-#endif
             return;
         }
 
@@ -177,7 +204,8 @@ struct HostAudio2 : HostAudio<2> {
         float** const dataOuts = pcontext->dataOuts;
 
         // gain (stereo variant only)
-        const float gain = std::pow(params[0].getValue(), 2.f);
+        const float gainParam = params[0].getValue();
+        const float gain = gainParam * gainParam;
 
         // read stereo values
         float valueL, valueR;
@@ -224,7 +252,6 @@ struct HostAudio2 : HostAudio<2> {
             valueR = valueL;
             dataOuts[1][k] += valueL;
         }
-#ifndef HEADLESS
         else
         {
             valueR = 0.0f;
@@ -253,6 +280,7 @@ struct HostAudio2 : HostAudio<2> {
                 resetMeters = false;
             }
         }
+#ifndef HEADLESS
         else
         {
             const uint32_t j = internalDataFrame++;
@@ -27,6 +27,7 @@
 
 #include "plugin.hpp"
 #include "plugincontext.hpp"
+#include "BlockPipeline.hpp"
 #include "Expander.hpp"
 
 #ifndef HEADLESS
@@ -40,6 +41,7 @@
 # include "../../src/extra/SharedResourcePointer.hpp"
 #else
 # include "extra/Mutex.hpp"
+# include "extra/ScopedPointer.hpp"
 # include "extra/String.hpp"
 #endif
 
@@ -49,6 +51,7 @@
 #include "water/streams/MemoryOutputStream.h"
 #include "water/xml/XmlDocument.h"
 
+#include <map>
 #include <string>
 
 #ifndef CARDINAL_SYSDEPS
@@ -73,8 +76,6 @@ std::string getSpecialPath(const SpecialPath type);
 std::string homeDir();
 }
 
-#define BUFFER_SIZE 128
-
 // generates a warning if this is defined as anything else
 #define CARLA_API
 
@@ -113,6 +114,7 @@ static void host_ui_closed(NativeHostHandle handle);
 static const char* host_ui_open_file(NativeHostHandle handle, bool isDir, const char* title, const char* filter);
 static const char* host_ui_save_file(NativeHostHandle handle, bool isDir, const char* title, const char* filter);
 static intptr_t host_dispatcher(NativeHostHandle h, NativeHostDispatcherOpcode op, int32_t, intptr_t, void*, float);
+static void pipeline_process_block(void* handle);
 static void projectLoadedFromDSP(void* ui);
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -381,6 +383,8 @@ struct JuceInitializer {
 
 struct IldaeilModule : Module {
     enum ParamIds {
+        BLOCK_SIZE,
+        PIPELINED,
         NUM_PARAMS
     };
     enum InputIds {
@@ -403,7 +407,7 @@ struct IldaeilModule : Module {
 #endif
     */
 
-    const CardinalPluginContext* const pcontext;
+    CardinalPluginContext* const pcontext;
 
     const NativePluginDescriptor* fCarlaPluginDescriptor = nullptr;
     NativePluginHandle fCarlaPluginHandle = nullptr;
@@ -418,14 +422,29 @@ struct IldaeilModule : Module {
     void* fUI = nullptr;
     bool canUseBridges = true;
 
-    float audioDataIn1[BUFFER_SIZE];
-    float audioDataIn2[BUFFER_SIZE];
-    float audioDataOut1[BUFFER_SIZE];
-    float audioDataOut2[BUFFER_SIZE];
+    // double buffered, the audio thread uses audioDataIndex while the pipeline worker uses the other one
+    float audioDataIn[2][2][MODULE_BLOCK_SIZE_MAX];
+    float audioDataOut[2][2][MODULE_BLOCK_SIZE_MAX];
+    float* audioDataInPtr[2][2];
+    float* audioDataOutPtr[2][2];
     unsigned audioDataFill = 0;
+    uint audioDataIndex = 0;
+    uint32_t blockSize;
+    uint32_t latency = 0;
     uint32_t lastProcessCounter = 0;
     CardinalExpanderFromCarlaMIDIToCV* midiOutExpander = nullptr;
 
+    // MIDI is copied in and out of the expanders in between blocks, so the worker never touches them
+    uint midiInEventCount = 0;
+    uint midiOutEventCount = 0;
+    NativeMidiEvent midiInEvents[CardinalExpanderFromCVToCarlaMIDI::MAX_MIDI_EVENTS];
+    NativeMidiEvent midiOutEvents[CardinalExpanderFromCarlaMIDIToCV::MAX_MIDI_EVENTS];
+
+    ScopedPointer<BlockPipelineWorker> pipelineWorker;
+    bool pipelined = false;
+    uint pipelineIndex = 0;
+    uint32_t pipelineFrames = 0;
+
     volatile bool resetMeterIn = true;
     volatile bool resetMeterOut = true;
     float meterInL = 0.0f;
@@ -437,14 +456,25 @@ struct IldaeilModule : Module {
         : pcontext(static_cast<CardinalPluginContext*>(APP))
     {
         config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+        configSwitch(BLOCK_SIZE, 0.f, 5.f, 0.f, "Block size", getModuleBlockSizeLabels())->randomizeEnabled = false;
+        configParam<SwitchQuantity>(PIPELINED, 0.f, 1.f, 0.f, "Pipelined processing")->randomizeEnabled = false;
         for (uint i=0; i<2; ++i)
         {
             const char name[] = { 'A','u','d','i','o',' ','#',static_cast<char>('0'+i+1),'\0' };
             configInput(i, name);
             configOutput(i, name);
         }
-        std::memset(audioDataOut1, 0, sizeof(audioDataOut1));
-        std::memset(audioDataOut2, 0, sizeof(audioDataOut2));
+        blockSize = getModuleBlockSize(pcontext->bufferSize, 0);
+        std::memset(audioDataOut, 0, sizeof(audioDataOut));
+
+        for (uint j=0; j<2; ++j)
+        {
+            for (uint i=0; i<2; ++i)
+            {
+                audioDataInPtr[j][i] = audioDataIn[j][i];
+                audioDataOutPtr[j][i] = audioDataOut[j][i];
+            }
+        }
 
         fCarlaPluginDescriptor = carla_get_native_rack_plugin();
         DISTRHO_SAFE_ASSERT_RETURN(fCarlaPluginDescriptor != nullptr,);
@@ -551,10 +581,15 @@ struct IldaeilModule : Module {
                                            0, 0, nullptr, 0.0f);
 
         fCarlaPluginDescriptor->activate(fCarlaPluginHandle);
+
+        pipelineWorker = new BlockPipelineWorker(pipeline_process_block, this);
     }
 
     ~IldaeilModule() override
     {
+        // must be stopped before the plugin goes away
+        pipelineWorker = nullptr;
+
         if (fCarlaPluginHandle != nullptr)
             fCarlaPluginDescriptor->deactivate(fCarlaPluginHandle);
 
@@ -619,8 +654,18 @@ struct IldaeilModule : Module {
        #endif
     }
 
+    // starting the worker thread is not realtime safe, so it happens here instead of in process().
+    // called when loading and from the module widget step(), which picks up changes from automation or undo.
+    void startPipelineWorkerIfNeeded()
+    {
+        if (pipelineWorker != nullptr && params[PIPELINED].getValue() > 0.1f)
+            pipelineWorker->start();
+    }
+
     void dataFromJson(json_t* const rootJ) override
     {
+        startPipelineWorkerIfNeeded();
+
         if (fCarlaHostHandle == nullptr)
             return;
 
@@ -646,13 +691,26 @@ struct IldaeilModule : Module {
 
         const unsigned i = audioDataFill++;
 
-        audioDataIn1[i] = inputs[INPUT1].getVoltage() * 0.1f;
-        audioDataIn2[i] = inputs[INPUT2].getVoltage() * 0.1f;
-        outputs[OUTPUT1].setVoltage(audioDataOut1[i] * 10.0f);
-        outputs[OUTPUT2].setVoltage(audioDataOut2[i] * 10.0f);
+        audioDataIn[audioDataIndex][0][i] = inputs[INPUT1].getVoltage() * 0.1f;
+        audioDataIn[audioDataIndex][1][i] = inputs[INPUT2].getVoltage() * 0.1f;
+        outputs[OUTPUT1].setVoltage(audioDataOut[audioDataIndex][0][i] * 10.0f);
+        outputs[OUTPUT2].setVoltage(audioDataOut[audioDataIndex][1][i] * 10.0f);
+
+        // pipelined processing adds one extra block of latency
+        const uint32_t newLatency = pipelined ? blockSize * 2 : blockSize;
+
+        if (latency != newLatency)
+        {
+            latency = newLatency;
+            pcontext->setModuleLatency(this, latency);
+        }
 
-        if (audioDataFill == BUFFER_SIZE)
+        if (audioDataFill >= blockSize)
         {
+            // the worker shares time and MIDI data with us, let it finish the previous block first
+            if (pipelined)
+                pipelineWorker->waitForBlock();
+
             const uint32_t processCounter = pcontext->processCounter;
 
             // Update time position if running a new audio block
@@ -671,10 +729,10 @@ struct IldaeilModule : Module {
                 fCarlaTimeInfo.bbt.ticksPerBeat = pcontext->ticksPerBeat;
                 fCarlaTimeInfo.bbt.beatsPerMinute = pcontext->beatsPerMinute;
             }
-            // or advance time by BUFFER_SIZE frames if still under the same audio block
+            // or advance time by blockSize frames if still under the same audio block
             else if (fCarlaTimeInfo.playing)
             {
-                fCarlaTimeInfo.frame += BUFFER_SIZE;
+                fCarlaTimeInfo.frame += blockSize;
 
                 // adjust BBT as well
                 if (fCarlaTimeInfo.bbt.valid)
@@ -685,7 +743,7 @@ struct IldaeilModule : Module {
 
                     int32_t newBar = fCarlaTimeInfo.bbt.bar;
                     int32_t newBeat = fCarlaTimeInfo.bbt.beat;
-                    double newTick = fCarlaTimeInfo.bbt.tick + (double)BUFFER_SIZE / samplesPerTick;
+                    double newTick = fCarlaTimeInfo.bbt.tick + (double)blockSize / samplesPerTick;
 
                     while (newTick >= fCarlaTimeInfo.bbt.ticksPerBeat)
                     {
@@ -706,51 +764,115 @@ struct IldaeilModule : Module {
                 }
             }
 
-            NativeMidiEvent* midiEvents;
-            uint midiEventCount;
-
             if (CardinalExpanderFromCVToCarlaMIDI* const midiInExpander
                     = leftExpander.module != nullptr && leftExpander.module->model == modelExpanderInputMIDI
                     ? static_cast<CardinalExpanderFromCVToCarlaMIDI*>(leftExpander.module)
                     : nullptr)
             {
-                midiEvents = midiInExpander->midiEvents;
-                midiEventCount = midiInExpander->midiEventCount;
+                midiInEventCount = midiInExpander->midiEventCount;
+                std::memcpy(midiInEvents, midiInExpander->midiEvents, sizeof(NativeMidiEvent) * midiInEventCount);
                 midiInExpander->midiEventCount = midiInExpander->frame = 0;
             }
             else
             {
-                midiEvents = nullptr;
-                midiEventCount = 0;
+                midiInEventCount = 0;
             }
 
-            if ((midiOutExpander = rightExpander.module != nullptr && rightExpander.module->model == modelExpanderOutputMIDI
-                                 ? static_cast<CardinalExpanderFromCarlaMIDIToCV*>(rightExpander.module)
-                                 : nullptr))
-                midiOutExpander->midiEventCount = 0;
+            midiOutExpander = rightExpander.module != nullptr && rightExpander.module->model == modelExpanderOutputMIDI
+                            ? static_cast<CardinalExpanderFromCarlaMIDIToCV*>(rightExpander.module)
+                            : nullptr;
 
+            const uint32_t frames = blockSize;
             audioDataFill = 0;
-            float* ins[2] = { audioDataIn1, audioDataIn2 };
-            float* outs[2] = { audioDataOut1, audioDataOut2 };
 
             if (resetMeterIn)
                 meterInL = meterInR = 0.0f;
 
-            meterInL = std::max(meterInL, d_findMaxNormalizedFloat128(audioDataIn1));
-            meterInR = std::max(meterInR, d_findMaxNormalizedFloat128(audioDataIn2));
+            meterInL = std::max(meterInL, d_findMaxNormalizedFloat(audioDataIn[audioDataIndex][0], frames));
+            meterInR = std::max(meterInR, d_findMaxNormalizedFloat(audioDataIn[audioDataIndex][1], frames));
 
-            fCarlaPluginDescriptor->process(fCarlaPluginHandle, ins, outs, BUFFER_SIZE, midiEvents, midiEventCount);
+            // block size changes are only applied in between blocks
+            const uint32_t newBlockSize = getModuleBlockSize(pcontext->bufferSize, params[BLOCK_SIZE].getValue() + 0.5f);
+
+            if (blockSize != newBlockSize)
+            {
+                if (newBlockSize > blockSize)
+                {
+                    for (uint j=0; j<2; ++j)
+                    {
+                        std::memset(audioDataOut[j][0] + blockSize, 0, sizeof(float) * (newBlockSize - blockSize));
+                        std::memset(audioDataOut[j][1] + blockSize, 0, sizeof(float) * (newBlockSize - blockSize));
+                    }
+                }
+
+                blockSize = newBlockSize;
+            }
+
+            // so are pipelining changes, the block still in flight is dropped when disabling
+            const bool wantsPipelining = params[PIPELINED].getValue() > 0.1f;
+            const bool newPipelined = wantsPipelining && pipelineWorker->isRunning();
+
+            if (pipelined != newPipelined)
+            {
+                pipelined = newPipelined;
+
+                if (newPipelined)
+                    std::memset(audioDataOut[1 - audioDataIndex], 0, sizeof(audioDataOut[0]));
+            }
+
+            // no block is in flight at this point, let the worker thread go while it is not needed
+            if (! wantsPipelining && pipelineWorker->isRunning())
+                pipelineWorker->requestStop();
+
+            if (pipelined)
+            {
+                // hand over this block and start outputting the one the worker has just finished
+                flushMidiOutput();
+                pipelineIndex = audioDataIndex;
+                pipelineFrames = frames;
+                pipelineWorker->startBlock();
+                audioDataIndex = 1 - audioDataIndex;
+            }
+            else
+            {
+                processBlock(audioDataIndex, frames);
+                flushMidiOutput();
+            }
 
             if (resetMeterOut)
                 meterOutL = meterOutR = 0.0f;
 
-            meterOutL = std::max(meterOutL, d_findMaxNormalizedFloat128(audioDataOut1));
-            meterOutR = std::max(meterOutR, d_findMaxNormalizedFloat128(audioDataOut2));
+            meterOutL = std::max(meterOutL, d_findMaxNormalizedFloat(audioDataOut[audioDataIndex][0], frames));
+            meterOutR = std::max(meterOutR, d_findMaxNormalizedFloat(audioDataOut[audioDataIndex][1], frames));
 
             resetMeterIn = resetMeterOut = false;
         }
     }
 
+    // called from the audio thread, or from the pipeline worker when pipelined
+    void processBlock(const uint index, const uint32_t frames)
+    {
+        midiOutEventCount = 0;
+        fCarlaPluginDescriptor->process(fCarlaPluginHandle, audioDataInPtr[index], audioDataOutPtr[index], frames,
+                                        midiInEvents, midiInEventCount);
+    }
+
+    void flushMidiOutput()
+    {
+        if (midiOutExpander != nullptr)
+        {
+            std::memcpy(midiOutExpander->midiEvents, midiOutEvents, sizeof(NativeMidiEvent) * midiOutEventCount);
+            midiOutExpander->midiEventCount = midiOutEventCount;
+        }
+
+        midiOutEventCount = 0;
+    }
+
+    void onAdd(const AddEvent&) override
+    {
+        startPipelineWorkerIfNeeded();
+    }
+
     void onReset() override
     {
         resetMeterIn = resetMeterOut = true;
@@ -765,6 +887,9 @@ struct IldaeilModule : Module {
         resetMeterIn = resetMeterOut = true;
         midiOutExpander = nullptr;
 
+        if (pipelined)
+            pipelineWorker->waitForBlock();
+
         fCarlaPluginDescriptor->deactivate(fCarlaPluginHandle);
         fCarlaPluginDescriptor->dispatcher(fCarlaPluginHandle, NATIVE_PLUGIN_OPCODE_SAMPLE_RATE_CHANGED,
                                            0, 0, nullptr, e.sampleRate);
@@ -776,7 +901,8 @@ struct IldaeilModule : Module {
 
 static uint32_t host_get_buffer_size(const NativeHostHandle handle)
 {
-    return BUFFER_SIZE;
+    // processing happens in blocks of up to this size
+    return MODULE_BLOCK_SIZE_MAX;
 }
 
 static double host_get_sample_rate(const NativeHostHandle handle)
@@ -798,17 +924,19 @@ static const NativeTimeInfo* host_get_time_info(const NativeHostHandle handle)
 
 static bool host_write_midi_event(const NativeHostHandle handle, const NativeMidiEvent* const event)
 {
-    if (CardinalExpanderFromCarlaMIDIToCV* const expander = static_cast<IldaeilModule*>(handle)->midiOutExpander)
-    {
-        if (expander->midiEventCount == CardinalExpanderFromCarlaMIDIToCV::MAX_MIDI_EVENTS)
-            return false;
+    IldaeilModule* const module = static_cast<IldaeilModule*>(handle);
 
-        NativeMidiEvent& expanderEvent(expander->midiEvents[expander->midiEventCount++]);
-        carla_copyStruct(expanderEvent, *event);
-        return true;
-    }
+    if (module->midiOutEventCount == CardinalExpanderFromCarlaMIDIToCV::MAX_MIDI_EVENTS)
+        return false;
 
-    return false;
+    carla_copyStruct(module->midiOutEvents[module->midiOutEventCount++], *event);
+    return true;
+}
+
+static void pipeline_process_block(void* const handle)
+{
+    IldaeilModule* const module = static_cast<IldaeilModule*>(handle);
+    module->processBlock(module->pipelineIndex, module->pipelineFrames);
 }
 
 static void host_ui_midi_program_changed(NativeHostHandle handle, uint8_t channel, uint32_t bank, uint32_t program)
@@ -837,6 +965,7 @@ static intptr_t host_dispatcher(const NativeHostHandle handle, const NativeHostD
 #ifndef HEADLESS
 struct IldaeilWidget : ImGuiWidget, IdleCallback, Runner {
     static constexpr const uint kButtonHeight = 20;
+    static constexpr const uint kMaxParallelDiscoveries = 4;
 
     struct PluginInfoCache {
         BinaryType btype;
@@ -846,6 +975,20 @@ struct IldaeilWidget : ImGuiWidget, IdleCallback, Runner {
         std::string label;
     };
 
+    // discovery results are shared between all Ildaeil instances, one list per plugin type
+    struct SharedPluginLists {
+        Mutex mutex;
+        std::vector<PluginInfoCache> plugins[PLUGIN_TYPE_COUNT];
+        bool valid[PLUGIN_TYPE_COUNT] = {};
+        bool scanning[PLUGIN_TYPE_COUNT] = {};
+    };
+
+    static SharedPluginLists& getSharedPluginLists()
+    {
+        static SharedPluginLists lists;
+        return lists;
+    }
+
     struct PluginGenericUI {
         char* title;
         uint parameterCount;
@@ -925,26 +1068,58 @@ struct IldaeilWidget : ImGuiWidget, IdleCallback, Runner {
         kIdleHidePluginUI,
         kIdleGiveIdleToUI,
         kIdleChangePluginType,
+        kIdleRescanPlugins,
         kIdleNothing
     } fIdleState = kIdleInit;
 
+    struct DiscoveryJob {
+        BinaryType btype;
+        String tool;
+        std::string path;
+    };
+
     struct RunnerData {
         bool needsReinit = true;
-        CarlaPluginDiscoveryHandle handle = nullptr;
+        bool waitingForSharedScan = false;
+        bool ownsSharedScan = false;
+        PluginType pluginType = PLUGIN_NONE;
+        std::vector<CarlaPluginDiscoveryHandle> handles;
+        std::vector<DiscoveryJob> pendingJobs;
+        // cache file for each binary being scanned, indexed by sha1sum
+        std::map<std::string, water::File> cacheFiles;
+
+        ~RunnerData()
+        {
+            clear();
+        }
 
         void init()
         {
             needsReinit = true;
+            clear();
+        }
 
-            if (handle != nullptr)
+        void clear()
+        {
+            if (ownsSharedScan)
             {
-                carla_plugin_discovery_stop(handle);
-                handle = nullptr;
+                ownsSharedScan = false;
+
+                SharedPluginLists& shared(getSharedPluginLists());
+                const MutexLocker cml(shared.mutex);
+                shared.scanning[pluginType] = false;
             }
+
+            for (CarlaPluginDiscoveryHandle handle : handles)
+                carla_plugin_discovery_stop(handle);
+
+            waitingForSharedScan = false;
+            handles.clear();
+            pendingJobs.clear();
+            cacheFiles.clear();
         }
     } fRunnerData;
 
-    BinaryType fBinaryType = BINARY_NATIVE;
    #ifdef CARLA_OS_WASM
     PluginType fPluginType = PLUGIN_JSFX;
    #else
@@ -968,7 +1143,7 @@ struct IldaeilWidget : ImGuiWidget, IdleCallback, Runner {
     bool fPluginSearchFirstShow = false;
     char fPluginSearchString[0xff] = {};
 
-    String fPopupError, fPluginFilename, fDiscoveryTool;
+    String fPopupError, fPluginFilename;
 
     bool idleCallbackActive = false;
     IldaeilModule* const module;
@@ -1476,6 +1651,18 @@ struct IldaeilWidget : ImGuiWidget, IdleCallback, Runner {
             }
             break;
 
+        case kIdleRescanPlugins:
+            fIdleState = kIdleNothing;
+            fPluginSelected = -1;
+            stopRunner();
+            {
+                SharedPluginLists& shared(getSharedPluginLists());
+                const MutexLocker cml(shared.mutex);
+                shared.valid[fPluginType] = false;
+            }
+            initAndStartRunner();
+            break;
+
         case kIdleNothing:
             break;
         }
@@ -1508,89 +1695,159 @@ struct IldaeilWidget : ImGuiWidget, IdleCallback, Runner {
 
     bool run() override
     {
+        SharedPluginLists& shared(getSharedPluginLists());
+
         if (fRunnerData.needsReinit)
         {
             fRunnerData.needsReinit = false;
+            fRunnerData.pluginType = fPluginType;
 
             {
                 const MutexLocker cml(fPluginsMutex);
                 fPlugins.clear();
             }
 
-            d_stdout("Will scan plugins now...");
-
-            const String& binaryPath(module->fBinaryPath);
-
-            if (binaryPath.isNotEmpty())
-            {
-                fBinaryType = BINARY_NATIVE;
-
-                fDiscoveryTool  = binaryPath;
-                fDiscoveryTool += DISTRHO_OS_SEP_STR "carla-discovery-native";
-               #ifdef CARLA_OS_WIN
-                fDiscoveryTool += ".exe";
-               #endif
-
-                fRunnerData.handle = carla_plugin_discovery_start(fDiscoveryTool,
-                                                                  fBinaryType,
-                                                                  fPluginType,
-                                                                  getPluginPath(fPluginType),
-                                                                  _binaryPluginSearchCallback,
-                                                                  _binaryPluginCheckCacheCallback,
-                                                                  this);
-
-            }
-
             if (fDrawingState == kDrawingLoading)
             {
                 fDrawingState = kDrawingPluginList;
                 fPluginSearchFirstShow = true;
             }
 
-            if (binaryPath.isEmpty() || (fRunnerData.handle == nullptr && !startNextDiscovery()))
+            {
+                const MutexLocker cml(shared.mutex);
+
+                if (! shared.valid[fPluginType])
+                {
+                    // let another instance finish scanning first, instead of duplicating its work
+                    if (shared.scanning[fPluginType])
+                    {
+                        fRunnerData.waitingForSharedScan = true;
+                        return true;
+                    }
+
+                    shared.scanning[fPluginType] = true;
+                    fRunnerData.ownsSharedScan = true;
+                }
+            }
+
+            if (! fRunnerData.ownsSharedScan)
+                return ! useSharedPluginList();
+
+            d_stdout("Will scan plugins now...");
+
+            if (module->fBinaryPath.isNotEmpty())
+                queueDiscoveryJobs();
+
+            if (! startPendingDiscoveries())
             {
                 d_stdout("Nothing found!");
+                storeSharedPluginList();
                 return false;
             }
         }
 
-        DISTRHO_SAFE_ASSERT_RETURN(fRunnerData.handle != nullptr, false);
+        if (fRunnerData.waitingForSharedScan)
+        {
+            bool scanning;
+            {
+                const MutexLocker cml(shared.mutex);
+                scanning = shared.scanning[fPluginType];
+            }
 
-        if (carla_plugin_discovery_idle(fRunnerData.handle))
+            if (scanning)
+                return true;
+
+            fRunnerData.waitingForSharedScan = false;
+
+            if (useSharedPluginList())
+                return false;
+
+            // the other instance gave up before finishing, so scan ourselves
+            fRunnerData.needsReinit = true;
             return true;
+        }
 
-        // stop here
-        carla_plugin_discovery_stop(fRunnerData.handle);
-        fRunnerData.handle = nullptr;
+        for (size_t i = 0; i < fRunnerData.handles.size();)
+        {
+            if (carla_plugin_discovery_idle(fRunnerData.handles[i]))
+            {
+                ++i;
+                continue;
+            }
+
+            carla_plugin_discovery_stop(fRunnerData.handles[i]);
+            fRunnerData.handles.erase(fRunnerData.handles.begin() + i);
+        }
 
-        if (startNextDiscovery())
+        if (startPendingDiscoveries())
             return true;
 
         d_stdout("Found %lu plugins!", (ulong)fPlugins.size());
+        storeSharedPluginList();
         return false;
     }
 
-    bool startNextDiscovery()
+    bool useSharedPluginList()
     {
-        if (! setNextDiscoveryTool())
+        SharedPluginLists& shared(getSharedPluginLists());
+        const MutexLocker cml(shared.mutex);
+
+        if (! shared.valid[fPluginType])
             return false;
 
-        fRunnerData.handle = carla_plugin_discovery_start(fDiscoveryTool,
-                                                          fBinaryType,
-                                                          fPluginType,
-                                                          getPluginPath(fPluginType),
-                                                          _binaryPluginSearchCallback,
-                                                          _binaryPluginCheckCacheCallback,
-                                                          this);
+        const MutexLocker cml2(fPluginsMutex);
+        fPlugins = shared.plugins[fPluginType];
+        return true;
+    }
 
-        if (fRunnerData.handle == nullptr)
-            return startNextDiscovery();
+    void storeSharedPluginList()
+    {
+        SharedPluginLists& shared(getSharedPluginLists());
+        const MutexLocker cml(shared.mutex);
 
-        return true;
+        {
+            const MutexLocker cml2(fPluginsMutex);
+            shared.plugins[fPluginType] = fPlugins;
+        }
+
+        shared.valid[fPluginType] = true;
+        shared.scanning[fPluginType] = false;
+        fRunnerData.ownsSharedScan = false;
+    }
+
+    // keeps up to kMaxParallelDiscoveries running, returns false once everything is done
+    bool startPendingDiscoveries()
+    {
+        while (fRunnerData.handles.size() < kMaxParallelDiscoveries && ! fRunnerData.pendingJobs.empty())
+        {
+            const DiscoveryJob job(fRunnerData.pendingJobs.front());
+            fRunnerData.pendingJobs.erase(fRunnerData.pendingJobs.begin());
+
+            if (const CarlaPluginDiscoveryHandle handle = carla_plugin_discovery_start(job.tool,
+                                                                                      job.btype,
+                                                                                      fPluginType,
+                                                                                      job.path.c_str(),
+                                                                                      _binaryPluginSearchCallback,
+                                                                                      _binaryPluginCheckCacheCallback,
+                                                                                      this))
+                fRunnerData.handles.push_back(handle);
+        }
+
+        return ! fRunnerData.handles.empty();
     }
 
-    bool setNextDiscoveryTool()
+    void queueDiscoveryJobs()
     {
+        const String& binaryPath(module->fBinaryPath);
+
+        String tool(binaryPath);
+        tool += DISTRHO_OS_SEP_STR "carla-discovery-native";
+       #ifdef CARLA_OS_WIN
+        tool += ".exe";
+       #endif
+
+        queueDiscoveryJobs(BINARY_NATIVE, tool);
+
         switch (fPluginType)
         {
         case PLUGIN_VST2:
@@ -1598,74 +1855,72 @@ struct IldaeilWidget : ImGuiWidget, IdleCallback, Runner {
         case PLUGIN_CLAP:
             break;
         default:
-            return false;
+            return;
         }
 
       #ifdef CARLA_OS_WIN
         #ifdef CARLA_OS_WIN64
         // look for win32 plugins on win64
-        if (fBinaryType == BINARY_NATIVE)
-        {
-            fBinaryType = BINARY_WIN32;
-            fDiscoveryTool = module->fBinaryPath;
-            fDiscoveryTool += CARLA_OS_SEP_STR "carla-discovery-win32.exe";
-
-            if (system::exists(fDiscoveryTool.buffer()))
-                return true;
-        }
+        queueDiscoveryJobs(BINARY_WIN32, binaryPath + CARLA_OS_SEP_STR "carla-discovery-win32.exe");
        #endif
-
-        // no other types to try
-        return false;
       #else // CARLA_OS_WIN
-
        #ifndef CARLA_OS_MAC
         // try 32bit plugins on 64bit systems, skipping macOS where 32bit is no longer supported
-        if (fBinaryType == BINARY_NATIVE)
-        {
-            fBinaryType = BINARY_POSIX32;
-            fDiscoveryTool = module->fBinaryPath;
-            fDiscoveryTool += CARLA_OS_SEP_STR "carla-discovery-posix32";
-
-            if (system::exists(fDiscoveryTool.buffer()))
-                return true;
-        }
+        queueDiscoveryJobs(BINARY_POSIX32, binaryPath + CARLA_OS_SEP_STR "carla-discovery-posix32");
        #endif
 
         // try wine bridges
        #ifdef CARLA_OS_64BIT
-        if (fBinaryType == BINARY_NATIVE || fBinaryType == BINARY_POSIX32)
-        {
-            fBinaryType = BINARY_WIN64;
-            fDiscoveryTool = module->fBinaryPath;
-            fDiscoveryTool += CARLA_OS_SEP_STR "carla-discovery-win64.exe";
-
-            if (system::exists(fDiscoveryTool.buffer()))
-                return true;
-        }
+        queueDiscoveryJobs(BINARY_WIN64, binaryPath + CARLA_OS_SEP_STR "carla-discovery-win64.exe");
        #endif
+        queueDiscoveryJobs(BINARY_WIN32, binaryPath + CARLA_OS_SEP_STR "carla-discovery-win32.exe");
+      #endif // CARLA_OS_WIN
+    }
+
+    void queueDiscoveryJobs(const BinaryType btype, const String& tool)
+    {
+        if (btype != BINARY_NATIVE && ! system::exists(tool.buffer()))
+            return;
+
+        const std::string paths(getPluginPath(fPluginType));
 
-        if (fBinaryType != BINARY_WIN32)
+        switch (fPluginType)
         {
-            fBinaryType = BINARY_WIN32;
-            fDiscoveryTool = module->fBinaryPath;
-            fDiscoveryTool += CARLA_OS_SEP_STR "carla-discovery-win32.exe";
+        case PLUGIN_LADSPA:
+        case PLUGIN_DSSI:
+        case PLUGIN_VST2:
+        case PLUGIN_VST3:
+        case PLUGIN_CLAP:
+            // these are scanned one binary at a time, so each search path entry gets its own discovery process
+            for (size_t start = 0, end; start < paths.size(); start = end + 1)
+            {
+                end = paths.find(CARLA_OS_SPLIT, start);
 
-            if (system::exists(fDiscoveryTool.buffer()))
-                return true;
-        }
+                if (end == std::string::npos)
+                    end = paths.size();
 
-        return false;
-      #endif // CARLA_OS_WIN
+                if (end != start)
+                    fRunnerData.pendingJobs.push_back({ btype, tool, paths.substr(start, end - start) });
+            }
+            break;
+        default:
+            // LV2, JSFX and SFZ are discovered by a single process for the whole search path.
+            // carla-discovery has no on-disk cache for these, so they are scanned in full every time.
+            fRunnerData.pendingJobs.push_back({ btype, tool, paths });
+            break;
+        }
     }
 
     void binaryPluginSearchCallback(const CarlaPluginDiscoveryInfo* const info, const char* const sha1sum)
     {
         // save plugin info into cache
-        if (sha1sum != nullptr)
+        const std::map<std::string, water::File>::const_iterator it = sha1sum != nullptr
+                                                                    ? fRunnerData.cacheFiles.find(sha1sum)
+                                                                    : fRunnerData.cacheFiles.end();
+
+        if (it != fRunnerData.cacheFiles.end())
         {
-            const String configDir(asset::config("Ildaeil").c_str());
-            const water::File cacheFile(configDir + CARLA_OS_SEP_STR "cache" CARLA_OS_SEP_STR + sha1sum);
+            const water::File& cacheFile(it->second);
 
             if (cacheFile.create().ok())
             {
@@ -1755,8 +2010,18 @@ struct IldaeilWidget : ImGuiWidget, IdleCallback, Runner {
         if (sha1sum == nullptr)
             return false;
 
-        const String configDir(asset::config("Ildaeil").c_str());
-        const water::File cacheFile(configDir + CARLA_OS_SEP_STR "cache" CARLA_OS_SEP_STR + sha1sum);
+        // sha1sum covers the binary path and modification time, include its size in the cache filename too
+        const String cacheDir(String(asset::config("Ildaeil").c_str()) + CARLA_OS_SEP_STR "cache" CARLA_OS_SEP_STR);
+        const String cacheFilename(String(sha1sum) + "-" + String(static_cast<long long>(water::File(filename).getSize())));
+        const water::File cacheFile(cacheDir + cacheFilename);
+
+        fRunnerData.cacheFiles[sha1sum] = cacheFile;
+
+        // older versions named cache files after the sha1sum only, nothing reads those anymore
+        const water::File legacyCacheFile(cacheDir + sha1sum);
+
+        if (legacyCacheFile.existsAsFile())
+            legacyCacheFile.deleteFile();
 
         if (cacheFile.existsAsFile())
         {
@@ -2169,6 +2434,11 @@ struct IldaeilWidget : ImGuiWidget, IdleCallback, Runner {
 
             ImGui::EndDisabled();
 
+            ImGui::SameLine();
+
+            if (ImGui::Button("Rescan"))
+                fIdleState = kIdleRescanPlugins;
+
             if (fPluginRunning)
             {
                 ImGui::SameLine();
@@ -2431,8 +2701,34 @@ struct IldaeilModuleWidget : ModuleWidgetWithSideScrews<26> {
                              && module->rightExpander.module != nullptr
                              && module->rightExpander.module->model == modelExpanderOutputMIDI;
 
+        if (module != nullptr)
+            static_cast<IldaeilModule*>(module)->startPipelineWorkerIfNeeded();
+
         ModuleWidgetWithSideScrews<26>::step();
     }
+
+    void appendContextMenu(ui::Menu* const menu) override
+    {
+        IldaeilModule* const ildaeilModule = static_cast<IldaeilModule*>(module);
+
+        if (ildaeilModule == nullptr)
+            return;
+
+        menu->addChild(new ui::MenuSeparator);
+
+        menu->addChild(createIndexSubmenuItem("Block size", getModuleBlockSizeLabels(),
+            [=]() {return static_cast<size_t>(ildaeilModule->params[IldaeilModule::BLOCK_SIZE].getValue() + 0.5f);},
+            [=](size_t index) {ildaeilModule->params[IldaeilModule::BLOCK_SIZE].setValue(index);}
+        ));
+
+        menu->addChild(createCheckMenuItem("Pipelined processing", "+1 block latency",
+            [=]() {return ildaeilModule->params[IldaeilModule::PIPELINED].getValue() > 0.1f;},
+            [=]() {
+                ildaeilModule->params[IldaeilModule::PIPELINED].setValue(1.0f - ildaeilModule->params[IldaeilModule::PIPELINED].getValue());
+                ildaeilModule->startPipelineWorkerIfNeeded();
+            }
+        ));
+    }
 };
 #else
 static void host_ui_parameter_changed(NativeHostHandle, uint32_t, float) {}
@@ -2453,6 +2749,6 @@ struct IldaeilModuleWidget : ModuleWidget {
 
 // --------------------------------------------------------------------------------------------------------------------
 
-Model* modelIldaeil = createModel<IldaeilModule, IldaeilModuleWidget>("Ildaeil");
+Model* modelIldaeil = createModelWithWidgetOnEngineLoad<IldaeilModule, IldaeilModuleWidget>("Ildaeil");
 
 // --------------------------------------------------------------------------------------------------------------------
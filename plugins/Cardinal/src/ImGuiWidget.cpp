@@ -19,6 +19,8 @@
 #include "DearImGui/imgui.h"
 #include "DistrhoUtils.hpp"
 
+#include <mutex>
+
 #ifndef DGL_NO_SHARED_RESOURCES
 # include "../../../dpf/dgl/src/Resources.hpp"
 #endif
@@ -73,11 +75,122 @@ static void setupIO()
     io.SetClipboardTextFn = SetClipboardTextFn;
 }
 
+// --------------------------------------------------------------------------------------------------------------------
+// Font atlases are shared between all ImGuiWidget instances, rasterizing fonts is too expensive to do per widget
+
+struct SharedFontAtlas {
+    ImFontAtlas* atlas;
+    bool monospace;
+    float scaleFactor;
+    uint refcount;
+};
+
+static std::mutex sharedFontAtlasesMutex;
+static std::vector<SharedFontAtlas> sharedFontAtlases;
+
+static void generateFonts(ImFontAtlas* const atlas, const bool monospace, const float scaleFactor)
+{
+    if (monospace)
+    {
+        const std::string fontPath = asset::system("res/fonts/ShareTechMono-Regular.ttf");
+        ImFontConfig fc;
+        fc.OversampleH = 1;
+        fc.OversampleV = 1;
+        fc.PixelSnapH = true;
+        atlas->AddFontFromFileTTF(fontPath.c_str(), 13.0f * scaleFactor, &fc);
+        atlas->Build();
+    }
+    else
+    {
+#ifndef DGL_NO_SHARED_RESOURCES
+        using namespace dpf_resources;
+        ImFontConfig fc;
+        fc.FontDataOwnedByAtlas = false;
+        fc.OversampleH = 1;
+        fc.OversampleV = 1;
+        fc.PixelSnapH = true;
+        atlas->AddFontFromMemoryTTF((void*)dejavusans_ttf, dejavusans_ttf_size, 13.0f * scaleFactor, &fc);
+
+        // extra fonts we can try loading for unicode support
+        static const char* extraFontPathsToTry[] = {
+           #if defined(ARCH_WIN)
+            // TODO
+            // "Meiryo.ttc",
+           #elif defined(ARCH_MAC)
+            // TODO
+           #elif defined(ARCH_LIN)
+            "/usr/share/fonts/opentype/noto/NotoSerifCJK-Regular.ttc",
+           #endif
+        };
+
+        fc.FontDataOwnedByAtlas = true;
+        fc.MergeMode = true;
+
+        for (size_t i=0; i<ARRAY_SIZE(extraFontPathsToTry); ++i)
+        {
+            if (rack::system::exists(extraFontPathsToTry[i]))
+                atlas->AddFontFromFileTTF(extraFontPathsToTry[i], 13.0f * scaleFactor, &fc,
+                                          atlas->GetGlyphRangesJapanese());
+        }
+
+        atlas->Build();
+#endif
+    }
+}
+
+static ImFontAtlas* acquireSharedFontAtlas(const bool monospace, const float scaleFactor)
+{
+    const std::lock_guard<std::mutex> lock(sharedFontAtlasesMutex);
+
+    for (SharedFontAtlas& shared : sharedFontAtlases)
+    {
+        if (shared.monospace == monospace && d_isEqual(shared.scaleFactor, scaleFactor))
+        {
+            ++shared.refcount;
+            return shared.atlas;
+        }
+    }
+
+    ImFontAtlas* const atlas = IM_NEW(ImFontAtlas)();
+    generateFonts(atlas, monospace, scaleFactor);
+
+    sharedFontAtlases.push_back({ atlas, monospace, scaleFactor, 1 });
+    return atlas;
+}
+
+static void releaseSharedFontAtlas(ImFontAtlas* const atlas)
+{
+    const std::lock_guard<std::mutex> lock(sharedFontAtlasesMutex);
+
+    for (std::vector<SharedFontAtlas>::iterator it = sharedFontAtlases.begin(); it != sharedFontAtlases.end(); ++it)
+    {
+        if (it->atlas != atlas)
+            continue;
+
+        if (--it->refcount == 0)
+        {
+            IM_DELETE(atlas);
+            sharedFontAtlases.erase(it);
+        }
+        return;
+    }
+
+    DISTRHO_SAFE_ASSERT(false);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+// contexts of widgets that have not been drawn for this long, that is off-screen, are released until drawn again
+static constexpr const double kOffscreenReleaseTime = 10.0;
+
+// --------------------------------------------------------------------------------------------------------------------
+
 struct ImGuiWidget::PrivateData {
     ImGuiContext* context = nullptr;
+    ImFontAtlas* fontAtlas = nullptr;
+    ImTextureID fontTexture = nullptr;
     bool created = false;
     bool darkMode = true;
-    bool fontGenerated = false;
     bool useMonospacedFont = false;
     float originalScaleFactor = 0.0f;
     float scaleFactor = 0.0f;
@@ -86,91 +199,38 @@ struct ImGuiWidget::PrivateData {
     PrivateData()
     {
         IMGUI_CHECKVERSION();
-        context = ImGui::CreateContext();
-        ImGui::SetCurrentContext(context);
-        setupIO();
     }
 
     ~PrivateData()
     {
-        // this should not happen
-        if (created)
-        {
-            ImGui::SetCurrentContext(context);
-#if defined(DGL_USE_OPENGL3)
-            ImGui_ImplOpenGL3_Shutdown();
-#else
-            ImGui_ImplOpenGL2_Shutdown();
-#endif
-        }
-
-        ImGui::DestroyContext(context);
+        destroyContext();
     }
 
-    void generateFontIfNeeded()
+    // the context is only created on first draw, once the scale factor (and thus font size) is known
+    void createContextIfNeeded(const float scaleFactor)
     {
-        if (fontGenerated)
+        if (context != nullptr)
             return;
 
         DISTRHO_SAFE_ASSERT_RETURN(scaleFactor != 0.0f,);
 
-        fontGenerated = true;
-
-        ImGuiIO& io(ImGui::GetIO());
-
-        if (useMonospacedFont)
-        {
-            const std::string fontPath = asset::system("res/fonts/ShareTechMono-Regular.ttf");
-            ImFontConfig fc;
-            fc.OversampleH = 1;
-            fc.OversampleV = 1;
-            fc.PixelSnapH = true;
-            io.Fonts->AddFontFromFileTTF(fontPath.c_str(), 13.0f * scaleFactor, &fc);
-            io.Fonts->Build();
-        }
-        else
-        {
-#ifndef DGL_NO_SHARED_RESOURCES
-            using namespace dpf_resources;
-            ImFontConfig fc;
-            fc.FontDataOwnedByAtlas = false;
-            fc.OversampleH = 1;
-            fc.OversampleV = 1;
-            fc.PixelSnapH = true;
-            io.Fonts->AddFontFromMemoryTTF((void*)dejavusans_ttf, dejavusans_ttf_size, 13.0f * scaleFactor, &fc);
-
-            // extra fonts we can try loading for unicode support
-            static const char* extraFontPathsToTry[] = {
-               #if defined(ARCH_WIN)
-                // TODO
-                // "Meiryo.ttc",
-               #elif defined(ARCH_MAC)
-                // TODO
-               #elif defined(ARCH_LIN)
-                "/usr/share/fonts/opentype/noto/NotoSerifCJK-Regular.ttc",
-               #endif
-            };
-
-            fc.FontDataOwnedByAtlas = true;
-            fc.MergeMode = true;
-
-            for (size_t i=0; i<ARRAY_SIZE(extraFontPathsToTry); ++i)
-            {
-                if (rack::system::exists(extraFontPathsToTry[i]))
-                    io.Fonts->AddFontFromFileTTF(extraFontPathsToTry[i], 13.0f * scaleFactor, &fc,
-                                                 io.Fonts->GetGlyphRangesJapanese());
-            }
+        originalScaleFactor = scaleFactor;
+        fontAtlas = acquireSharedFontAtlas(useMonospacedFont, scaleFactor);
 
-            io.Fonts->Build();
-#endif
-        }
+        context = ImGui::CreateContext(fontAtlas);
+        ImGui::SetCurrentContext(context);
+        setupIO();
     }
 
-    void resetEverything(const bool doInit)
+    void destroyContext()
     {
+        if (context == nullptr)
+            return;
+
+        ImGui::SetCurrentContext(context);
+
         if (created)
         {
-            ImGui::SetCurrentContext(context);
 #if defined(DGL_USE_OPENGL3)
             ImGui_ImplOpenGL3_Shutdown();
 #else
@@ -179,25 +239,21 @@ struct ImGuiWidget::PrivateData {
             created = false;
         }
 
-        fontGenerated = false;
-        originalScaleFactor = 0.0f;
-        scaleFactor = 0.0f;
-        lastFrameTime = 0.0;
         ImGui::DestroyContext(context);
+        context = nullptr;
 
-        context = ImGui::CreateContext();
-        ImGui::SetCurrentContext(context);
-        setupIO();
+        releaseSharedFontAtlas(fontAtlas);
+        fontAtlas = nullptr;
+        fontTexture = nullptr;
+    }
 
-        if (doInit)
-        {
-#if defined(DGL_USE_OPENGL3)
-            ImGui_ImplOpenGL3_Init();
-#else
-            ImGui_ImplOpenGL2_Init();
-#endif
-            created = true;
-        }
+    void resetEverything()
+    {
+        destroyContext();
+
+        originalScaleFactor = 0.0f;
+        scaleFactor = 0.0f;
+        lastFrameTime = 0.0;
     }
 
     void resetStyle()
@@ -261,6 +317,10 @@ void ImGuiWidget::onContextCreate(const ContextCreateEvent& e)
     OpenGlWidgetWithBrowserPreview::onContextCreate(e);
     DISTRHO_SAFE_ASSERT_RETURN(!imData->created,);
 
+    // nothing drawn yet, backend gets initialized together with the context on first draw
+    if (imData->context == nullptr)
+        return;
+
     ImGui::SetCurrentContext(imData->context);
 #if defined(DGL_USE_OPENGL3)
     ImGui_ImplOpenGL3_Init();
@@ -281,6 +341,7 @@ void ImGuiWidget::onContextDestroy(const ContextDestroyEvent& e)
         ImGui_ImplOpenGL2_Shutdown();
 #endif
         imData->created = false;
+        imData->fontTexture = nullptr;
     }
 
     OpenGlWidgetWithBrowserPreview::onContextDestroy(e);
@@ -293,13 +354,16 @@ void ImGuiWidget::setAsCurrentContext()
 
 void ImGuiWidget::setUseMonospaceFont(const bool useMonoFont)
 {
-    DISTRHO_SAFE_ASSERT_RETURN(!imData->fontGenerated,);
+    DISTRHO_SAFE_ASSERT_RETURN(imData->context == nullptr,);
 
     imData->useMonospacedFont = useMonoFont;
 }
 
 void ImGuiWidget::onHover(const HoverEvent& e)
 {
+    if (imData->context == nullptr)
+        return;
+
     ImGui::SetCurrentContext(imData->context);
 
     ImGuiIO& io(ImGui::GetIO());
@@ -315,6 +379,9 @@ void ImGuiWidget::onHover(const HoverEvent& e)
 
 void ImGuiWidget::onDragHover(const DragHoverEvent& e)
 {
+    if (imData->context == nullptr)
+        return;
+
     ImGui::SetCurrentContext(imData->context);
 
     ImGuiIO& io(ImGui::GetIO());
@@ -330,6 +397,9 @@ void ImGuiWidget::onDragHover(const DragHoverEvent& e)
 
 void ImGuiWidget::onDragEnd(const DragEndEvent& e)
 {
+    if (imData->context == nullptr)
+        return;
+
     ImGui::SetCurrentContext(imData->context);
 
     ImGuiIO& io(ImGui::GetIO());
@@ -338,6 +408,9 @@ void ImGuiWidget::onDragEnd(const DragEndEvent& e)
 
 void ImGuiWidget::onHoverScroll(const HoverScrollEvent& e)
 {
+    if (imData->context == nullptr)
+        return;
+
     ImGui::SetCurrentContext(imData->context);
 
     float deltaX = e.scrollDelta.x;
@@ -359,6 +432,9 @@ void ImGuiWidget::onHoverScroll(const HoverScrollEvent& e)
 
 void ImGuiWidget::onButton(const ButtonEvent& e)
 {
+    if (imData->context == nullptr)
+        return;
+
     ImGui::SetCurrentContext(imData->context);
 
     ImGuiIO& io(ImGui::GetIO());
@@ -393,6 +469,8 @@ void ImGuiWidget::onSelectKey(const SelectKeyEvent& e)
 {
     if (e.key < 0 || e.key >= IM_ARRAYSIZE(ImGuiIO::KeysDown))
         return;
+    if (imData->context == nullptr)
+        return;
 
     ImGui::SetCurrentContext(imData->context);
 
@@ -421,6 +499,9 @@ void ImGuiWidget::onSelectKey(const SelectKeyEvent& e)
 
 void ImGuiWidget::onSelectText(const SelectTextEvent& e)
 {
+    if (imData->context == nullptr)
+        return;
+
     ImGui::SetCurrentContext(imData->context);
 
     ImGuiIO& io(ImGui::GetIO());
@@ -435,7 +516,13 @@ void ImGuiWidget::step()
     if (imData->darkMode != settings::preferDarkPanels)
     {
         imData->darkMode = settings::preferDarkPanels;
-        imData->resetEverything(true);
+        imData->resetEverything();
+    }
+    // each context holds its own font texture and draw buffers, don't keep them for widgets out of view.
+    // like the reset above this drops ImGui-side state such as scroll positions, widgets keep their own data.
+    else if (imData->context != nullptr && glfwGetTime() - imData->lastFrameTime > kOffscreenReleaseTime)
+    {
+        imData->resetEverything();
     }
 
     OpenGlWidgetWithBrowserPreview::step();
@@ -445,20 +532,23 @@ void ImGuiWidget::drawFramebuffer()
 {
     const float scaleFactor = APP->window->pixelRatio * std::max(1.0f, APP->scene->rack->getAbsoluteZoom());
 
-    if (d_isNotEqual(imData->scaleFactor, scaleFactor))
-        imData->resetEverything(true);
+    if (imData->context != nullptr && d_isNotEqual(imData->scaleFactor, scaleFactor))
+        imData->resetEverything();
 
     drawFramebufferCommon(getFramebufferSize(), scaleFactor);
 }
 
 void ImGuiWidget::drawFramebufferForBrowserPreview()
 {
-    imData->resetEverything(true);
+    imData->resetEverything();
     drawFramebufferCommon(box.size.mult(oversample), oversample);
 }
 
 void ImGuiWidget::drawFramebufferCommon(const Vec& fbSize, const float scaleFactor)
 {
+    imData->createContextIfNeeded(scaleFactor);
+    DISTRHO_SAFE_ASSERT_RETURN(imData->context != nullptr,);
+
     ImGui::SetCurrentContext(imData->context);
     ImGuiIO& io(ImGui::GetIO());
 
@@ -470,15 +560,7 @@ void ImGuiWidget::drawFramebufferCommon(const Vec& fbSize, const float scaleFact
         new(&style)ImGuiStyle();
         imData->resetStyle();
 
-        if (! imData->fontGenerated)
-        {
-            imData->originalScaleFactor = scaleFactor;
-            imData->generateFontIfNeeded();
-        }
-        else
-        {
-            io.FontGlobalScale = scaleFactor / imData->originalScaleFactor;
-        }
+        io.FontGlobalScale = scaleFactor / imData->originalScaleFactor;
     }
 
 #if defined(DGL_USE_OPENGL3)
@@ -514,12 +596,18 @@ void ImGuiWidget::drawFramebufferCommon(const Vec& fbSize, const float scaleFact
     io.DeltaTime = time - imData->lastFrameTime;
     imData->lastFrameTime = time;
 
+    // the atlas is shared, but each context has its own backend font texture
+    if (imData->fontTexture != nullptr)
+        io.Fonts->SetTexID(imData->fontTexture);
+
 #if defined(DGL_USE_OPENGL3)
     ImGui_ImplOpenGL3_NewFrame();
 #else
     ImGui_ImplOpenGL2_NewFrame();
 #endif
 
+    imData->fontTexture = io.Fonts->TexID;
+
     ImGui::NewFrame();
     drawImGui();
     ImGui::Render();
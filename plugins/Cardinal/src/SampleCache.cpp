@@ -0,0 +1,1232 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE file.
+ */
+
+#include "SampleCache.hpp"
+#include "ghc/filesystem.hpp"
+
+extern "C" {
+#include "audio_decoder/ad.h"
+}
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef DISTRHO_OS_WINDOWS
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+// how often the cache thread checks streams for pages to prefetch
+static constexpr const uint kCacheIntervalInMs = 10;
+// unused pages kept around for reuse, 64MiB worth
+static constexpr const size_t kMaxRecentPages = 512;
+// pages read per cache thread iteration while building waveform overviews
+static constexpr const uint kScanPagesPerRun = 8;
+// frames per peak value while building waveform overviews
+static constexpr const uint32_t kScanPeakFrames = 1024;
+// bytes hashed from the start, middle and end of larger files for their content key
+static constexpr const size_t kKeyBlockSize = 65536;
+
+// --------------------------------------------------------------------------------------------------------------------
+
+enum SampleEncoding {
+    kEncodingUInt8,
+    kEncodingInt8,
+    kEncodingInt16,
+    kEncodingInt24,
+    kEncodingInt32,
+    kEncodingFloat32,
+    kEncodingFloat64,
+};
+
+static inline uint16_t readLE16(const uint8_t* const p) noexcept
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t readLE32(const uint8_t* const p) noexcept
+{
+    return static_cast<uint32_t>(p[0])
+         | static_cast<uint32_t>(p[1]) << 8
+         | static_cast<uint32_t>(p[2]) << 16
+         | static_cast<uint32_t>(p[3]) << 24;
+}
+
+static inline uint16_t readBE16(const uint8_t* const p) noexcept
+{
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t readBE32(const uint8_t* const p) noexcept
+{
+    return static_cast<uint32_t>(p[0]) << 24
+         | static_cast<uint32_t>(p[1]) << 16
+         | static_cast<uint32_t>(p[2]) << 8
+         | static_cast<uint32_t>(p[3]);
+}
+
+// AIFF sample rates are stored as 80-bit extended floats
+static double readExtended(const uint8_t* const p) noexcept
+{
+    const int exponent = (((p[0] & 0x7f) << 8) | p[1]) - 16383 - 63;
+    uint64_t mantissa = 0;
+
+    for (int i=2; i<10; ++i)
+        mantissa = (mantissa << 8) | p[i];
+
+    return std::ldexp(static_cast<double>(mantissa), exponent);
+}
+
+static inline float decodeSample(const uint8_t* const p, const SampleEncoding encoding, const bool bigEndian) noexcept
+{
+    switch (encoding)
+    {
+    case kEncodingUInt8:
+        return (static_cast<int>(p[0]) - 128) / 128.f;
+    case kEncodingInt8:
+        return static_cast<int8_t>(p[0]) / 128.f;
+    case kEncodingInt16:
+        return static_cast<int16_t>(bigEndian ? readBE16(p) : readLE16(p)) / 32768.f;
+    case kEncodingInt24:
+    {
+        const uint32_t value = bigEndian
+                             ? readBE32(p) & 0xffffff00
+                             : static_cast<uint32_t>(p[0]) << 8
+                             | static_cast<uint32_t>(p[1]) << 16
+                             | static_cast<uint32_t>(p[2]) << 24;
+        return static_cast<int32_t>(value) / 2147483648.f;
+    }
+    case kEncodingInt32:
+        return static_cast<int32_t>(bigEndian ? readBE32(p) : readLE32(p)) / 2147483648.f;
+    case kEncodingFloat32:
+    {
+        const uint32_t bits = bigEndian ? readBE32(p) : readLE32(p);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    case kEncodingFloat64:
+    {
+        const uint64_t bits = bigEndian
+                            ? static_cast<uint64_t>(readBE32(p)) << 32 | readBE32(p + 4)
+                            : static_cast<uint64_t>(readLE32(p + 4)) << 32 | readLE32(p);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return static_cast<float>(value);
+    }
+    }
+
+    return 0.f;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Read-only memory mapping of a whole file.
+
+struct MappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+   #ifdef DISTRHO_OS_WINDOWS
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+   #endif
+
+    MappedFile() = default;
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    bool open(const std::string& path)
+    {
+       #ifdef DISTRHO_OS_WINDOWS
+        const std::wstring wpath = ghc::filesystem::u8path(path).wstring();
+        file = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize;
+        if (! GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0
+            || static_cast<uint64_t>(fileSize.QuadPart) > SIZE_MAX)
+        {
+            close();
+            return false;
+        }
+
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        if (mapping == nullptr)
+        {
+            close();
+            return false;
+        }
+
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+        if (data == nullptr)
+        {
+            close();
+            return false;
+        }
+
+        size = static_cast<size_t>(fileSize.QuadPart);
+       #else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0 || static_cast<uintmax_t>(st.st_size) > SIZE_MAX)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void* const ptr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (ptr == MAP_FAILED)
+            return false;
+
+        ::madvise(ptr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+        data = static_cast<const uint8_t*>(ptr);
+        size = static_cast<size_t>(st.st_size);
+       #endif
+
+        return true;
+    }
+
+    void close()
+    {
+       #ifdef DISTRHO_OS_WINDOWS
+        if (data != nullptr)
+            UnmapViewOfFile(data);
+        if (mapping != nullptr)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+       #else
+        if (data != nullptr)
+            ::munmap(const_cast<uint8_t*>(data), size);
+       #endif
+
+        data = nullptr;
+        size = 0;
+    }
+
+    // lets the system drop a range that was read from our resident memory, it stays in the page cache
+    void release(const size_t offset, const size_t length)
+    {
+       #ifndef DISTRHO_OS_WINDOWS
+        static const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        const uintptr_t start = reinterpret_cast<uintptr_t>(data + offset) & ~(pageSize - 1);
+        const uintptr_t end = reinterpret_cast<uintptr_t>(data + offset + length);
+
+        if (end > start)
+            ::madvise(reinterpret_cast<void*>(start), end - start, MADV_DONTNEED);
+       #else
+        // mapped views are trimmed by the system working set manager
+        (void)offset;
+        (void)length;
+       #endif
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(MappedFile)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Carla audio decoder handle, reopened when a backend cannot seek backwards.
+
+struct SampleDecoder {
+    void* handle = nullptr;
+    uint64_t position = 0;
+
+    SampleDecoder() = default;
+
+    ~SampleDecoder()
+    {
+        close();
+    }
+
+    bool open(const std::string& path)
+    {
+        close();
+
+        adinfo nfo;
+        ad_clear_nfo(&nfo);
+        handle = ad_open(path.c_str(), &nfo);
+        ad_free_nfo(&nfo);
+
+        position = 0;
+        return handle != nullptr;
+    }
+
+    void close()
+    {
+        if (handle == nullptr)
+            return;
+
+        ad_close(handle);
+        handle = nullptr;
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(SampleDecoder)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// One cached file, only used from the cache thread or under the cache mutex.
+
+struct SampleFile {
+    std::string path;
+    uintmax_t fileSize = 0;
+    int64_t fileTime = 0;
+    uint fileChannels = 0;
+    uint channels = 0;
+    uint bitDepth = 0;
+    uint sampleRate = 0;
+    uint64_t numFrames = 0;
+
+    // uncompressed files, read straight from the mapping
+    MappedFile mapped;
+    const uint8_t* pcmData = nullptr;
+    uint blockAlign = 0;
+    SampleEncoding encoding = kEncodingInt16;
+    bool bigEndian = false;
+
+    // everything else, with separate decoders for playback and overview
+    SampleDecoder decoder;
+    SampleDecoder scanDecoder;
+
+    // pages handed out so far, alive while some stream or the recent page list holds them
+    std::vector<std::weak_ptr<const SamplePage>> pages;
+
+    // waveform overview, built by reading the whole file once
+    std::vector<float> scanPeaks;
+    uint64_t scanPosition = 0;
+    bool scanDone = false;
+    float preview[kSamplePreviewSize] = {};
+
+    SampleFile(const std::string& p)
+        : path(p) {}
+
+    bool open()
+    {
+        if (mapped.open(path))
+        {
+            if (parseWave() || parseAiff())
+                return true;
+
+            mapped.close();
+        }
+
+        adinfo nfo;
+        ad_clear_nfo(&nfo);
+
+        void* const handle = ad_open(path.c_str(), &nfo);
+
+        if (handle == nullptr)
+            return false;
+
+        fileChannels = nfo.channels;
+        channels = std::min(fileChannels, kSampleMaxChannels);
+        bitDepth = nfo.bit_depth;
+        sampleRate = nfo.sample_rate;
+        // only an estimate for some formats, corrected once the whole file was read
+        numFrames = nfo.frames > 0 ? static_cast<uint64_t>(nfo.frames) : 0;
+        ad_free_nfo(&nfo);
+
+        if (fileChannels == 0 || sampleRate == 0)
+        {
+            ad_close(handle);
+            return false;
+        }
+
+        decoder.handle = handle;
+        return true;
+    }
+
+    // reads up to `frames` frames from `start` into `dest`, as `channels` interleaved floats
+    uint32_t read(SampleDecoder& dec, const uint64_t start, uint32_t frames, float* const dest,
+                  std::vector<float>& buffer)
+    {
+        if (pcmData != nullptr)
+        {
+            if (start >= numFrames)
+                return 0;
+
+            frames = static_cast<uint32_t>(std::min<uint64_t>(frames, numFrames - start));
+
+            const uint bytesPerSample = blockAlign / fileChannels;
+            const uint8_t* const src = pcmData + start * blockAlign;
+
+            for (uint32_t i=0; i<frames; ++i)
+                for (uint c=0; c<channels; ++c)
+                    dest[i * channels + c] = decodeSample(src + i * blockAlign + c * bytesPerSample,
+                                                          encoding, bigEndian);
+
+            mapped.release(static_cast<size_t>(src - mapped.data), static_cast<size_t>(frames) * blockAlign);
+            return frames;
+        }
+
+        if (dec.handle == nullptr && ! dec.open(path))
+            return 0;
+
+        if (dec.position != start)
+        {
+            if (ad_seek(dec.handle, static_cast<int64_t>(start)) == static_cast<int64_t>(start))
+            {
+                dec.position = start;
+            }
+            else
+            {
+                // decoder cannot seek, read from the start or from where it is
+                if (start < dec.position && ! dec.open(path))
+                    return 0;
+
+                buffer.resize(kSamplePageFrames * fileChannels);
+
+                while (dec.position < start)
+                {
+                    const uint64_t skip = std::min<uint64_t>(start - dec.position, kSamplePageFrames);
+                    const ssize_t ret = ad_read(dec.handle, buffer.data(), skip * fileChannels);
+
+                    if (ret <= 0)
+                        return 0;
+
+                    dec.position += static_cast<uint64_t>(ret) / fileChannels;
+                }
+            }
+        }
+
+        buffer.resize(static_cast<size_t>(frames) * fileChannels);
+
+        uint32_t done = 0;
+        while (done < frames)
+        {
+            const ssize_t ret = ad_read(dec.handle, buffer.data() + done * fileChannels,
+                                        (frames - done) * fileChannels);
+
+            if (ret <= 0)
+                break;
+
+            done += static_cast<uint32_t>(ret) / fileChannels;
+        }
+
+        dec.position += done;
+
+        for (uint32_t i=0; i<done; ++i)
+            for (uint c=0; c<channels; ++c)
+                dest[i * channels + c] = buffer[i * fileChannels + c];
+
+        return done;
+    }
+
+private:
+    bool setupPcm(const uint8_t* const pcm, const size_t pcmSize, const uint numChannels, const uint rate,
+                  const uint align, const uint bits, const bool isFloat, const bool isBigEndian, const bool unsigned8)
+    {
+        if (numChannels == 0 || rate == 0 || align == 0 || align % numChannels != 0)
+            return false;
+
+        switch (align / numChannels)
+        {
+        case 1:
+            if (isFloat)
+                return false;
+            encoding = unsigned8 ? kEncodingUInt8 : kEncodingInt8;
+            break;
+        case 2:
+            if (isFloat)
+                return false;
+            encoding = kEncodingInt16;
+            break;
+        case 3:
+            if (isFloat)
+                return false;
+            encoding = kEncodingInt24;
+            break;
+        case 4:
+            encoding = isFloat ? kEncodingFloat32 : kEncodingInt32;
+            break;
+        case 8:
+            if (! isFloat)
+                return false;
+            encoding = kEncodingFloat64;
+            break;
+        default:
+            return false;
+        }
+
+        pcmData = pcm;
+        blockAlign = align;
+        bigEndian = isBigEndian;
+        fileChannels = numChannels;
+        channels = std::min(numChannels, kSampleMaxChannels);
+        bitDepth = bits;
+        sampleRate = rate;
+        numFrames = pcmSize / align;
+        return numFrames != 0;
+    }
+
+    bool parseWave()
+    {
+        const uint8_t* const data = mapped.data;
+        const size_t size = mapped.size;
+
+        if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0)
+            return false;
+
+        const uint8_t* fmt = nullptr;
+        const uint8_t* pcm = nullptr;
+        uint32_t fmtSize = 0;
+        size_t pcmSize = 0;
+
+        for (size_t offset = 12; offset + 8 <= size;)
+        {
+            const uint8_t* const chunk = data + offset;
+            const size_t chunkSize = readLE32(chunk + 4);
+            const size_t available = size - offset - 8;
+
+            if (std::memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && chunkSize <= available)
+            {
+                fmt = chunk + 8;
+                fmtSize = static_cast<uint32_t>(chunkSize);
+            }
+            else if (std::memcmp(chunk, "data", 4) == 0)
+            {
+                // streaming writers leave the size unset, use whatever is there
+                pcm = chunk + 8;
+                pcmSize = std::min(chunkSize, available);
+            }
+
+            offset += 8 + chunkSize + (chunkSize & 1);
+        }
+
+        if (fmt == nullptr || pcm == nullptr)
+            return false;
+
+        uint16_t format = readLE16(fmt);
+
+        // WAVE_FORMAT_EXTENSIBLE, the actual format is at the start of the sub-format GUID
+        if (format == 0xfffe && fmtSize >= 40)
+            format = readLE16(fmt + 24);
+
+        // PCM or IEEE float
+        if (format != 1 && format != 3)
+            return false;
+
+        return setupPcm(pcm, pcmSize, readLE16(fmt + 2), readLE32(fmt + 4),
+                        readLE16(fmt + 12), readLE16(fmt + 14), format == 3, false, true);
+    }
+
+    bool parseAiff()
+    {
+        const uint8_t* const data = mapped.data;
+        const size_t size = mapped.size;
+
+        if (size < 12 || std::memcmp(data, "FORM", 4) != 0)
+            return false;
+
+        const bool isAifc = std::memcmp(data + 8, "AIFC", 4) == 0;
+
+        if (! isAifc && std::memcmp(data + 8, "AIFF", 4) != 0)
+            return false;
+
+        const uint8_t* comm = nullptr;
+        const uint8_t* pcm = nullptr;
+        size_t commSize = 0;
+        size_t pcmSize = 0;
+
+        for (size_t offset = 12; offset + 8 <= size;)
+        {
+            const uint8_t* const chunk = data + offset;
+            const size_t chunkSize = readBE32(chunk + 4);
+            const size_t available = size - offset - 8;
+
+            if (std::memcmp(chunk, "COMM", 4) == 0 && chunkSize >= 18 && chunkSize <= available)
+            {
+                comm = chunk + 8;
+                commSize = chunkSize;
+            }
+            else if (std::memcmp(chunk, "SSND", 4) == 0 && available >= 8)
+            {
+                const size_t dataOffset = 8 + readBE32(chunk + 12);
+
+                if (dataOffset < std::min(chunkSize, available))
+                {
+                    pcm = chunk + 8 + dataOffset;
+                    pcmSize = std::min(chunkSize, available) - dataOffset;
+                }
+            }
+
+            offset += 8 + chunkSize + (chunkSize & 1);
+        }
+
+        if (comm == nullptr || pcm == nullptr)
+            return false;
+
+        const uint numChannels = readBE16(comm);
+        const uint32_t commFrames = readBE32(comm + 2);
+        const uint bits = readBE16(comm + 6);
+        const uint rate = static_cast<uint>(readExtended(comm + 8) + 0.5);
+        bool isFloat = false;
+        bool isBigEndian = true;
+
+        if (isAifc)
+        {
+            if (commSize < 22)
+                return false;
+
+            if (std::memcmp(comm + 18, "sowt", 4) == 0)
+                isBigEndian = false;
+            else if (std::memcmp(comm + 18, "fl32", 4) == 0 || std::memcmp(comm + 18, "FL32", 4) == 0
+                  || std::memcmp(comm + 18, "fl64", 4) == 0 || std::memcmp(comm + 18, "FL64", 4) == 0)
+                isFloat = true;
+            else if (std::memcmp(comm + 18, "NONE", 4) != 0)
+                return false;
+        }
+
+        const uint align = numChannels * ((bits + 7) / 8);
+
+        if (! setupPcm(pcm, pcmSize, numChannels, rate, align, bits, isFloat, isBigEndian, false))
+            return false;
+
+        numFrames = std::min<uint64_t>(numFrames, commFrames);
+        return numFrames != 0;
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(SampleFile)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+// FNV-1a over the file size and contents, only sampling the start, middle and end of larger files
+static bool getContentKey(const std::string& path, const uintmax_t size, uint64_t& key)
+{
+    ghc::filesystem::ifstream stream(ghc::filesystem::u8path(path), std::ios::binary);
+
+    if (! stream)
+        return false;
+
+    uint64_t hash = 14695981039346656037ULL;
+
+    const auto hashBytes = [&hash](const uint8_t* const bytes, const size_t count) {
+        for (size_t i=0; i<count; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+
+    uint8_t sizeBytes[8];
+    for (int i=0; i<8; ++i)
+        sizeBytes[i] = static_cast<uint8_t>(static_cast<uint64_t>(size) >> (i * 8));
+    hashBytes(sizeBytes, sizeof(sizeBytes));
+
+    std::vector<uint8_t> block(kKeyBlockSize);
+    std::vector<uintmax_t> offsets;
+
+    if (size <= kKeyBlockSize * 3)
+    {
+        for (uintmax_t offset = 0; offset < size; offset += kKeyBlockSize)
+            offsets.push_back(offset);
+    }
+    else
+    {
+        offsets = { 0, size / 2, size - kKeyBlockSize };
+    }
+
+    for (const uintmax_t offset : offsets)
+    {
+        stream.seekg(static_cast<std::streamoff>(offset));
+        stream.read(reinterpret_cast<char*>(block.data()),
+                    static_cast<std::streamsize>(std::min<uintmax_t>(kKeyBlockSize, size - offset)));
+
+        if (stream.gcount() <= 0)
+            return false;
+
+        hashBytes(block.data(), static_cast<size_t>(stream.gcount()));
+    }
+
+    key = hash;
+    return true;
+}
+
+// content keys only sample larger files, so files with the same key are compared in full before being shared
+static bool haveSameContents(const std::string& path1, const std::string& path2, const uintmax_t size)
+{
+    ghc::filesystem::ifstream stream1(ghc::filesystem::u8path(path1), std::ios::binary);
+    ghc::filesystem::ifstream stream2(ghc::filesystem::u8path(path2), std::ios::binary);
+
+    if (! stream1 || ! stream2)
+        return false;
+
+    std::vector<char> block1(kKeyBlockSize);
+    std::vector<char> block2(kKeyBlockSize);
+
+    for (uintmax_t offset = 0; offset < size; offset += kKeyBlockSize)
+    {
+        const std::streamsize count = static_cast<std::streamsize>(std::min<uintmax_t>(kKeyBlockSize, size - offset));
+
+        stream1.read(block1.data(), count);
+        stream2.read(block2.data(), count);
+
+        if (stream1.gcount() != count || stream2.gcount() != count)
+            return false;
+        if (std::memcmp(block1.data(), block2.data(), static_cast<size_t>(count)) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+bool SampleStream::isPageWanted(const uint32_t index, const uint64_t head, const uint64_t length,
+                                const bool loop) noexcept
+{
+    const uint64_t numPages = (length + kSamplePageFrames - 1) / kSamplePageFrames;
+    const uint64_t headPage = head / kSamplePageFrames;
+
+    if (index >= numPages)
+        return false;
+
+    if (loop)
+        return (index + numPages - headPage) % numPages < kNumSlots;
+
+    return index >= headPage && index - headPage < kNumSlots;
+}
+
+void SampleStream::retireSlots(const uint64_t head, const uint64_t length, const bool loop) noexcept
+{
+    for (Slot& slot : slots)
+    {
+        if (slot.state.load(std::memory_order_acquire) != kSlotReady)
+            continue;
+        if (slot.generation == currentGeneration && isPageWanted(slot.index, head, length, loop))
+            continue;
+
+        if (lastSlot == &slot)
+            lastSlot = nullptr;
+
+        slot.state.store(kSlotRetired, std::memory_order_release);
+    }
+}
+
+const float* SampleStream::getFrame(int64_t frame, const uint64_t length, const bool loop) noexcept
+{
+    static const float silence[kSampleMaxChannels] = {};
+
+    if (frame < 0 || static_cast<uint64_t>(frame) >= length)
+    {
+        if (! loop)
+            return silence;
+
+        const int64_t ilength = static_cast<int64_t>(length);
+        frame = ((frame % ilength) + ilength) % ilength;
+    }
+
+    const uint32_t index = static_cast<uint32_t>(frame / kSamplePageFrames);
+    const uint32_t offset = static_cast<uint32_t>(frame % kSamplePageFrames);
+
+    if (lastSlot == nullptr || lastSlot->index != index)
+    {
+        lastSlot = nullptr;
+
+        for (const Slot& slot : slots)
+        {
+            if (slot.state.load(std::memory_order_acquire) == kSlotReady
+                && slot.generation == currentGeneration && slot.index == index)
+            {
+                lastSlot = &slot;
+                break;
+            }
+        }
+
+        if (lastSlot == nullptr)
+            return nullptr;
+    }
+
+    const SamplePage* const page = lastSlot->page;
+
+    if (offset >= page->frames)
+        return nullptr;
+
+    return page->data + offset * page->channels;
+}
+
+void SampleStream::process(float* const outL, float* const outR, const uint32_t frames,
+                           const double hostSampleRate, const bool loop, const bool playing,
+                           const int64_t syncFrame) noexcept
+{
+    const uint32_t gen = generation.load(std::memory_order_acquire);
+
+    if (currentGeneration != gen)
+    {
+        currentGeneration = gen;
+        position = 0.0;
+        lastSlot = nullptr;
+    }
+
+    const uint64_t length = numFrames.load(std::memory_order_relaxed);
+    const uint rate = sampleRate.load(std::memory_order_relaxed);
+
+    looping.store(loop, std::memory_order_relaxed);
+
+    if (length == 0 || rate == 0 || hostSampleRate <= 0.0)
+    {
+        retireSlots(0, 0, false);
+        playhead.store(0, std::memory_order_relaxed);
+        std::memset(outL, 0, sizeof(float) * frames);
+        std::memset(outR, 0, sizeof(float) * frames);
+        return;
+    }
+
+    const double dlength = static_cast<double>(length);
+    const double step = rate / hostSampleRate;
+
+    if (syncFrame >= 0)
+        position = static_cast<double>(syncFrame) * step;
+    if (loop)
+        position = std::fmod(position, dlength);
+
+    // interpolation needs one frame before the current one
+    const uint64_t head = position >= 1.0 ? static_cast<uint64_t>(position) - 1 : 0;
+    retireSlots(head, length, loop);
+    playhead.store(head, std::memory_order_relaxed);
+
+    if (! playing)
+    {
+        std::memset(outL, 0, sizeof(float) * frames);
+        std::memset(outR, 0, sizeof(float) * frames);
+        return;
+    }
+
+    for (uint32_t i=0; i<frames; ++i)
+    {
+        if (! loop && position >= dlength)
+        {
+            std::memset(outL + i, 0, sizeof(float) * (frames - i));
+            std::memset(outR + i, 0, sizeof(float) * (frames - i));
+            break;
+        }
+
+        const int64_t frame = static_cast<int64_t>(position);
+        const float t = static_cast<float>(position - frame);
+        const float* const x0 = getFrame(frame, length, loop);
+
+        if (x0 == nullptr)
+        {
+            // not prefetched yet
+            outL[i] = outR[i] = 0.f;
+        }
+        else if (t == 0.f)
+        {
+            outL[i] = x0[0];
+            outR[i] = lastSlot != nullptr && lastSlot->page->channels > 1 ? x0[1] : x0[0];
+        }
+        else
+        {
+            const uint channels = lastSlot != nullptr ? lastSlot->page->channels : 1;
+            const float* xm1 = getFrame(frame - 1, length, loop);
+            const float* x1 = getFrame(frame + 1, length, loop);
+            const float* x2 = getFrame(frame + 2, length, loop);
+
+            // frames not available are replaced by the current one, better than a click
+            if (xm1 == nullptr)
+                xm1 = x0;
+            if (x1 == nullptr)
+                x1 = x0;
+            if (x2 == nullptr)
+                x2 = x1;
+
+            for (uint c=0; c<2; ++c)
+            {
+                const uint k = c < channels ? c : 0;
+
+                // 4-point cubic hermite
+                const float c1 = 0.5f * (x1[k] - xm1[k]);
+                const float c2 = xm1[k] - 2.5f * x0[k] + 2.f * x1[k] - 0.5f * x2[k];
+                const float c3 = 0.5f * (x2[k] - xm1[k]) + 1.5f * (x0[k] - x1[k]);
+                const float value = ((c3 * t + c2) * t + c1) * t + x0[k];
+
+                (c == 0 ? outL : outR)[i] = value;
+            }
+        }
+
+        position += step;
+
+        if (loop && position >= dlength)
+            position -= dlength;
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+SampleCache::SampleCache()
+    : Thread("SampleCache")
+{
+    startThread();
+}
+
+SampleCache::~SampleCache()
+{
+    signalThreadShouldExit();
+    signal.signal();
+    stopThread(-1);
+}
+
+void SampleCache::addStream(SampleStream* const stream)
+{
+    {
+        const MutexLocker cml(mutex);
+        streams.push_back(stream);
+    }
+
+    signal.signal();
+}
+
+void SampleCache::removeStream(SampleStream* const stream)
+{
+    const MutexLocker cml(mutex);
+
+    streams.erase(std::remove(streams.begin(), streams.end(), stream), streams.end());
+
+    // the stream is no longer processed, so all of its pages can go
+    for (SampleStream::Slot& slot : stream->slots)
+    {
+        slot.page = nullptr;
+        slot.ref.reset();
+        slot.state.store(SampleStream::kSlotFree, std::memory_order_release);
+    }
+
+    stream->file.reset();
+}
+
+void SampleCache::setStreamFile(SampleStream* const stream, const std::string& path)
+{
+    {
+        const MutexLocker cml(mutex);
+        stream->pendingPath = path;
+        stream->pendingLoad = true;
+    }
+
+    signal.signal();
+}
+
+bool SampleCache::getStreamPreview(SampleStream* const stream, float preview[kSamplePreviewSize])
+{
+    const MutexLocker cml(mutex);
+
+    if (stream->pendingLoad || stream->file == nullptr || ! stream->file->scanDone)
+        return false;
+
+    std::memcpy(preview, stream->file->preview, sizeof(float) * kSamplePreviewSize);
+    return true;
+}
+
+void SampleCache::run()
+{
+    while (! shouldThreadExit())
+    {
+        bool idle, scanning;
+
+        {
+            const MutexLocker cml(mutex);
+
+            for (SampleStream* const stream : streams)
+            {
+                if (stream->pendingLoad)
+                    loadStreamFile(stream);
+
+                refillStream(stream);
+            }
+
+            scanning = scanPreviews();
+            idle = streams.empty();
+        }
+
+        if (idle)
+            signal.wait();
+        else
+            d_msleep(scanning ? 1 : kCacheIntervalInMs);
+    }
+}
+
+std::shared_ptr<SampleFile> SampleCache::openFile(const std::string& path)
+{
+    const ghc::filesystem::path fspath = ghc::filesystem::u8path(path);
+    std::error_code ec;
+
+    const uintmax_t size = ghc::filesystem::file_size(fspath, ec);
+    if (ec)
+        return nullptr;
+
+    const int64_t mtime = ghc::filesystem::last_write_time(fspath, ec).time_since_epoch().count();
+    if (ec)
+        return nullptr;
+
+    // only hash files again if they changed on disk
+    uint64_t key;
+    const std::map<std::string, PathEntry>::const_iterator it = paths.find(path);
+
+    if (it != paths.end() && it->second.size == size && it->second.mtime == mtime)
+    {
+        key = it->second.key;
+    }
+    else
+    {
+        if (! getContentKey(path, size, key))
+            return nullptr;
+
+        paths[path] = { size, mtime, key };
+    }
+
+    for (std::multimap<uint64_t, std::weak_ptr<SampleFile>>::iterator fit = files.begin(); fit != files.end();)
+    {
+        if (fit->second.expired())
+            fit = files.erase(fit);
+        else
+            ++fit;
+    }
+
+    const auto range = files.equal_range(key);
+
+    for (std::multimap<uint64_t, std::weak_ptr<SampleFile>>::iterator fit = range.first; fit != range.second; ++fit)
+    {
+        std::shared_ptr<SampleFile> file = fit->second.lock();
+
+        if (file == nullptr || file->fileSize != size)
+            continue;
+
+        // the same unchanged file, or another one with exactly the same contents
+        if (file->path == path ? file->fileTime == mtime : haveSameContents(file->path, path, size))
+            return file;
+    }
+
+    std::shared_ptr<SampleFile> file = std::make_shared<SampleFile>(path);
+    file->fileSize = size;
+    file->fileTime = mtime;
+
+    if (! file->open())
+        return nullptr;
+
+    files.emplace(key, file);
+    return file;
+}
+
+std::shared_ptr<const SamplePage> SampleCache::getPage(const std::shared_ptr<SampleFile>& file, const uint32_t index)
+{
+    if (index < file->pages.size())
+    {
+        if (std::shared_ptr<const SamplePage> page = file->pages[index].lock())
+            return page;
+    }
+
+    const std::shared_ptr<SamplePage> page = std::make_shared<SamplePage>();
+    page->channels = file->channels;
+    page->frames = file->read(file->decoder, static_cast<uint64_t>(index) * kSamplePageFrames,
+                              kSamplePageFrames, page->data, decodeBuffer);
+
+    if (page->frames == 0)
+        return nullptr;
+
+    if (index >= file->pages.size())
+        file->pages.resize(index + 1);
+
+    file->pages[index] = page;
+
+    recentPages.push_front({ file, page, index });
+    if (recentPages.size() > kMaxRecentPages)
+        recentPages.pop_back();
+
+    return page;
+}
+
+void SampleCache::loadStreamFile(SampleStream* const stream)
+{
+    stream->pendingLoad = false;
+
+    std::shared_ptr<SampleFile> file;
+
+    if (! stream->pendingPath.empty())
+    {
+        file = openFile(stream->pendingPath);
+
+        if (file == nullptr)
+            d_stderr2("Failed to open audio file '%s'", stream->pendingPath.c_str());
+    }
+
+    stream->file = file;
+    stream->numFrames.store(file != nullptr ? file->numFrames : 0, std::memory_order_relaxed);
+    stream->sampleRate.store(file != nullptr ? file->sampleRate : 0, std::memory_order_relaxed);
+    stream->fileChannels.store(file != nullptr ? file->fileChannels : 0, std::memory_order_relaxed);
+    stream->bitDepth.store(file != nullptr ? file->bitDepth : 0, std::memory_order_relaxed);
+    stream->generation.store(stream->generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void SampleCache::refillStream(SampleStream* const stream)
+{
+    for (SampleStream::Slot& slot : stream->slots)
+    {
+        if (slot.state.load(std::memory_order_acquire) != SampleStream::kSlotRetired)
+            continue;
+
+        slot.page = nullptr;
+        slot.ref.reset();
+        slot.state.store(SampleStream::kSlotFree, std::memory_order_release);
+    }
+
+    const std::shared_ptr<SampleFile>& file = stream->file;
+
+    if (file == nullptr)
+        return;
+
+    const uint32_t generation = stream->generation.load(std::memory_order_relaxed);
+    const uint64_t length = stream->numFrames.load(std::memory_order_relaxed);
+    const uint64_t head = stream->playhead.load(std::memory_order_relaxed);
+    const bool looping = stream->looping.load(std::memory_order_relaxed);
+
+    const uint64_t numPages = (length + kSamplePageFrames - 1) / kSamplePageFrames;
+    const uint64_t headPage = head / kSamplePageFrames;
+
+    // fill the pages the audio thread will want next, in playing order
+    for (uint i=0; i<SampleStream::kNumSlots; ++i)
+    {
+        const uint64_t index = looping && numPages != 0 ? (headPage + i) % numPages : headPage + i;
+
+        if (index >= numPages)
+            break;
+
+        SampleStream::Slot* freeSlot = nullptr;
+        bool present = false;
+
+        for (SampleStream::Slot& slot : stream->slots)
+        {
+            const int state = slot.state.load(std::memory_order_acquire);
+
+            if (state == SampleStream::kSlotReady && slot.generation == generation && slot.index == index)
+            {
+                present = true;
+                break;
+            }
+
+            if (state == SampleStream::kSlotFree && freeSlot == nullptr)
+                freeSlot = &slot;
+        }
+
+        if (present)
+            continue;
+        if (freeSlot == nullptr)
+            break;
+
+        const std::shared_ptr<const SamplePage> page = getPage(file, static_cast<uint32_t>(index));
+
+        if (page == nullptr)
+            break;
+
+        freeSlot->generation = generation;
+        freeSlot->index = static_cast<uint32_t>(index);
+        freeSlot->page = page.get();
+        freeSlot->ref = page;
+        freeSlot->state.store(SampleStream::kSlotReady, std::memory_order_release);
+    }
+}
+
+bool SampleCache::scanPreviews()
+{
+    for (SampleStream* const stream : streams)
+    {
+        const std::shared_ptr<SampleFile> file = stream->file;
+
+        if (file == nullptr || file->scanDone)
+            continue;
+
+        scanBuffer.resize(kSamplePageFrames * kSampleMaxChannels);
+        float* const data = scanBuffer.data();
+
+        for (uint i=0; i<kScanPagesPerRun && ! file->scanDone; ++i)
+        {
+            const uint32_t frames = file->read(file->scanDecoder, file->scanPosition, kSamplePageFrames,
+                                               data, decodeBuffer);
+
+            for (uint32_t j=0; j<frames; j+=kScanPeakFrames)
+            {
+                const uint32_t end = std::min(j + kScanPeakFrames, frames) * file->channels;
+                float peak = 0.f;
+
+                for (uint32_t k=j*file->channels; k<end; ++k)
+                    peak = std::max(peak, std::abs(data[k]));
+
+                file->scanPeaks.push_back(peak);
+            }
+
+            file->scanPosition += frames;
+
+            if (frames == kSamplePageFrames)
+                continue;
+
+            // reached the end of the file
+            file->scanDone = true;
+            file->scanDecoder.close();
+
+            if (file->pcmData == nullptr && file->scanPosition != 0)
+                file->numFrames = file->scanPosition;
+
+            const size_t numPeaks = file->scanPeaks.size();
+
+            for (uint k=0; k<kSamplePreviewSize; ++k)
+            {
+                const size_t start = k * numPeaks / kSamplePreviewSize;
+                const size_t stop = std::min(numPeaks, std::max(start + 1, (k + 1) * numPeaks / kSamplePreviewSize));
+                float peak = 0.f;
+
+                for (size_t p=start; p<stop; ++p)
+                    peak = std::max(peak, file->scanPeaks[p]);
+
+                file->preview[k] = std::min(1.f, peak);
+            }
+
+            file->scanPeaks = std::vector<float>();
+
+            // decoders only know the exact length now
+            for (SampleStream* const other : streams)
+            {
+                if (other->file == file)
+                    other->numFrames.store(file->numFrames, std::memory_order_relaxed);
+            }
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,170 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE file.
+ */
+
+#pragma once
+
+#include "extra/Mutex.hpp"
+#include "extra/Thread.hpp"
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------------------------------------------------------------------
+// Process-wide cache of audio file contents, shared by everything that plays them.
+// Files are addressed by their contents, so the same file under different paths is only opened once.
+// Content keys only sample larger files, files sharing a key are compared in full before being shared.
+// Uncompressed WAV and AIFF files are memory-mapped, everything else is decoded through Carla's audio decoder.
+// In both cases samples are handed out as fixed-size float pages, refcounted and shared between streams.
+// Pages nobody is playing are kept up to a fixed memory budget and dropped oldest first.
+
+static constexpr const uint32_t kSamplePageFrames = 16384;
+static constexpr const uint kSampleMaxChannels = 2;
+static constexpr const uint kSamplePreviewSize = 108;
+
+struct SamplePage {
+    uint channels;
+    uint32_t frames;
+    float data[kSamplePageFrames * kSampleMaxChannels]; // interleaved
+};
+
+struct SampleFile;
+
+// --------------------------------------------------------------------------------------------------------------------
+// Plays one file from the cache, keeping only a few pages around the play position in memory.
+// The cache thread fills pages ahead of the play position, the audio thread hands back those it moved past.
+// Only `process()` may be called from the audio thread, everything else goes through SampleCache.
+
+struct SampleStream {
+    static constexpr const uint kNumSlots = 8;
+
+    SampleStream() = default;
+
+    // renders `frames` frames, silence where data is missing or when not playing.
+    // `syncFrame` sets the play position in host frames, or is negative for free-running playback.
+    void process(float* outL, float* outR, uint32_t frames, double hostSampleRate,
+                 bool looping, bool playing, int64_t syncFrame) noexcept;
+
+    // info about the current file, can be read from any thread
+    uint getChannels() const noexcept { return fileChannels.load(std::memory_order_relaxed); }
+    uint getBitDepth() const noexcept { return bitDepth.load(std::memory_order_relaxed); }
+    uint getSampleRate() const noexcept { return sampleRate.load(std::memory_order_relaxed); }
+    uint64_t getNumFrames() const noexcept { return numFrames.load(std::memory_order_relaxed); }
+    uint64_t getPosition() const noexcept { return playhead.load(std::memory_order_relaxed); }
+
+private:
+    friend struct SampleCache;
+
+    enum SlotState {
+        kSlotFree,    // owned by the cache thread
+        kSlotReady,   // owned by the audio thread
+        kSlotRetired, // given back by the audio thread, page still to be released
+    };
+
+    struct Slot {
+        std::atomic<int> state { kSlotFree };
+        uint32_t generation = 0;
+        uint32_t index = 0;
+        const SamplePage* page = nullptr;
+        std::shared_ptr<const SamplePage> ref;
+    };
+
+    Slot slots[kNumSlots];
+
+    // written by the cache thread, generation last
+    std::atomic<uint32_t> generation { 0 };
+    std::atomic<uint64_t> numFrames { 0 };
+    std::atomic<uint> sampleRate { 0 };
+    std::atomic<uint> fileChannels { 0 };
+    std::atomic<uint> bitDepth { 0 };
+
+    // written by the audio thread, tells the cache thread which pages to prefetch
+    std::atomic<uint64_t> playhead { 0 };
+    std::atomic<bool> looping { false };
+
+    // audio thread only
+    uint32_t currentGeneration = 0;
+    double position = 0.0;
+    const Slot* lastSlot = nullptr;
+
+    // cache thread only, guarded by the cache mutex
+    std::shared_ptr<SampleFile> file;
+    std::string pendingPath;
+    bool pendingLoad = false;
+
+    static bool isPageWanted(uint32_t index, uint64_t head, uint64_t length, bool looping) noexcept;
+    const float* getFrame(int64_t frame, uint64_t length, bool looping) noexcept;
+    void retireSlots(uint64_t head, uint64_t length, bool looping) noexcept;
+
+    DISTRHO_DECLARE_NON_COPYABLE(SampleStream)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Owns all cached files and pages, and the background thread that loads files and fills streams.
+// Meant to be used through SharedResourcePointer so that all modules share one instance.
+
+struct SampleCache : Thread {
+    SampleCache();
+    ~SampleCache() override;
+
+    void addStream(SampleStream* stream);
+    void removeStream(SampleStream* stream);
+
+    // makes a stream play another file, loading happens in the background; an empty path unloads the current file
+    void setStreamFile(SampleStream* stream, const std::string& path);
+
+    // copies the waveform overview of the stream file, returns false while it is not known yet
+    bool getStreamPreview(SampleStream* stream, float preview[kSamplePreviewSize]);
+
+protected:
+    void run() override;
+
+private:
+    struct PathEntry {
+        uintmax_t size;
+        int64_t mtime;
+        uint64_t key;
+    };
+
+    struct RecentPage {
+        std::shared_ptr<SampleFile> file;
+        std::shared_ptr<const SamplePage> page;
+        uint32_t index;
+    };
+
+    Mutex mutex;
+    Signal signal;
+    std::vector<SampleStream*> streams;
+    std::map<std::string, PathEntry> paths;
+    std::multimap<uint64_t, std::weak_ptr<SampleFile>> files;
+    std::list<RecentPage> recentPages;
+    std::vector<float> decodeBuffer;
+    std::vector<float> scanBuffer;
+
+    std::shared_ptr<SampleFile> openFile(const std::string& path);
+    std::shared_ptr<const SamplePage> getPage(const std::shared_ptr<SampleFile>& file, uint32_t index);
+    void loadStreamFile(SampleStream* stream);
+    void refillStream(SampleStream* stream);
+    bool scanPreviews();
+
+    DISTRHO_DECLARE_NON_COPYABLE(SampleCache)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
@@ -20,14 +20,6 @@
 #include "sassy/sassy.hpp"
 #include "sassy/sassy_scope.cpp"
 
-namespace ffft {
-template<class DT, int size>
-class FFTRealWithSize : public FFTReal<DT> {
-public:
-    explicit FFTRealWithSize() : FFTReal<DT>(size) {}
-};
-}
-
 struct SassyScopeModule : Module {
     enum ParamIds {
         NUM_PARAMS
@@ -48,38 +40,11 @@ struct SassyScopeModule : Module {
 
     ScopeData scope;
 
-    ffft::FFTRealWithSize<float, 16*2> fftObj16;
-    ffft::FFTRealWithSize<float, 32*2> fftObj32;
-    ffft::FFTRealWithSize<float, 64*2> fftObj64;
-    ffft::FFTRealWithSize<float, 128*2> fftObj128;
-    ffft::FFTRealWithSize<float, 256*2> fftObj256;
-    ffft::FFTRealWithSize<float, 512*2> fftObj512;
-    ffft::FFTRealWithSize<float, 1024*2> fftObj1024;
-    ffft::FFTRealWithSize<float, 2048*2> fftObj2048;
-    ffft::FFTRealWithSize<float, 4096*2> fftObj4096;
-    ffft::FFTRealWithSize<float, 8192*2> fftObj8192;
-    ffft::FFTRealWithSize<float, 16384*2> fftObj16384;
-    ffft::FFTRealWithSize<float, 32768*2> fftObj32768;
-    ffft::FFTRealWithSize<float, 65536*2> fftObj65536;
-
     SassyScopeModule()
     {
         config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 
         scope.fft.average = 1;
-        scope.fft.obj16 = &fftObj16;
-        scope.fft.obj32 = &fftObj32;
-        scope.fft.obj64 = &fftObj64;
-        scope.fft.obj128 = &fftObj128;
-        scope.fft.obj256 = &fftObj256;
-        scope.fft.obj512 = &fftObj512;
-        scope.fft.obj1024 = &fftObj1024;
-        scope.fft.obj2048 = &fftObj2048;
-        scope.fft.obj4096 = &fftObj4096;
-        scope.fft.obj8192 = &fftObj8192;
-        scope.fft.obj16384 = &fftObj16384;
-        scope.fft.obj32768 = &fftObj32768;
-        scope.fft.obj65536 = &fftObj65536;
     }
 
     void process(const ProcessArgs&) override
@@ -224,39 +189,12 @@ struct SassyScopeModule : Module {
 static ScopeData* getFakeScopeInstance()
 {
     static ScopeData scope;
-    static ffft::FFTReal<float> fftObj16(16*2);
-    static ffft::FFTReal<float> fftObj32(32*2);
-    static ffft::FFTReal<float> fftObj64(64*2);
-    static ffft::FFTReal<float> fftObj128(128*2);
-    static ffft::FFTReal<float> fftObj256(256*2);
-    static ffft::FFTReal<float> fftObj512(512*2);
-    static ffft::FFTReal<float> fftObj1024(1024*2);
-    static ffft::FFTReal<float> fftObj2048(2048*2);
-    static ffft::FFTReal<float> fftObj4096(4096*2);
-    static ffft::FFTReal<float> fftObj8192(8192*2);
-    static ffft::FFTReal<float> fftObj16384(16384*2);
-    static ffft::FFTReal<float> fftObj32768(32768*2);
-    static ffft::FFTReal<float> fftObj65536(65536*2);
-
     static bool needsInit = true;
 
     if (needsInit)
     {
         needsInit = false;
         scope.fft.average = 1;
-        scope.fft.obj16 = &fftObj16;
-        scope.fft.obj32 = &fftObj32;
-        scope.fft.obj64 = &fftObj64;
-        scope.fft.obj128 = &fftObj128;
-        scope.fft.obj256 = &fftObj256;
-        scope.fft.obj512 = &fftObj512;
-        scope.fft.obj1024 = &fftObj1024;
-        scope.fft.obj2048 = &fftObj2048;
-        scope.fft.obj4096 = &fftObj4096;
-        scope.fft.obj8192 = &fftObj8192;
-        scope.fft.obj16384 = &fftObj16384;
-        scope.fft.obj32768 = &fftObj32768;
-        scope.fft.obj65536 = &fftObj65536;
         scope.realloc(48000);
     }
 
@@ -81,6 +81,54 @@ float d_findMaxNormalizedFloat(const float floats[size])
     return maxf2;
 }
 
+/*
+ * Find the highest absolute and normalized value within a float array of any size.
+ */
+static inline
+float d_findMaxNormalizedFloat(const float floats[], const std::size_t size)
+{
+    float tmp, maxf2 = 0.f;
+
+    for (std::size_t i=0; i<size; ++i)
+    {
+        if (!std::isfinite(floats[i]))
+            __builtin_unreachable();
+
+        tmp = std::abs(floats[i]);
+
+        if (tmp > maxf2)
+            maxf2 = tmp;
+    }
+
+    if (maxf2 > 1.f)
+        maxf2 = 1.f;
+
+    return maxf2;
+}
+
+/*
+ * Block size for modules that process audio in blocks, like Carla, Ildaeil and AudioFile.
+ * Follows the host buffer size unless a small fixed size is requested, useful for feedback loops.
+ * Processing in blocks delays output by one block, which modules report as latency.
+ */
+#define MODULE_BLOCK_SIZE_MIN 16
+#define MODULE_BLOCK_SIZE_MAX 2048
+
+static inline
+std::vector<std::string> getModuleBlockSizeLabels()
+{
+    return { "Host buffer size", "16", "32", "64", "128", "256" };
+}
+
+static inline
+uint32_t getModuleBlockSize(const uint32_t hostBufferSize, const int fixedSizeIndex)
+{
+    if (fixedSizeIndex > 0)
+        return MODULE_BLOCK_SIZE_MIN << (std::min(fixedSizeIndex, 5) - 1);
+
+    return std::max<uint32_t>(MODULE_BLOCK_SIZE_MIN, std::min<uint32_t>(MODULE_BLOCK_SIZE_MAX, hostBufferSize));
+}
+
 /*
  * Find the highest absolute and normalized value within a float array.
  */
@@ -42,13 +42,25 @@
 
 #include "fftreal/FFTReal.h"
 
+#include <mutex>
+
 // int gFFTAverage = 1;
 // int gSamplerate;
 // float mUIScale;
 // // gScope
 
 struct ScopeData {
-    int mIndex = 0;
+    // recent history is kept at full rate, enough for the largest FFT plus averaging
+    static constexpr const unsigned int kRawSize = 1 << 17;
+    // the full history (10 seconds) is kept as min/max pairs, for blocks of 64 and 1024 samples
+    static constexpr const unsigned int kNumLevels = 2;
+    static constexpr const unsigned int kLevelShift[kNumLevels] = { 6, 10 };
+    static constexpr const int kHistorySeconds = 10;
+
+    // held by the UI while drawing, so that buffers can be replaced on sample rate changes
+    std::mutex mMutex;
+
+    unsigned int mIndex = 0;
     int mSampleRate = 0;
     float mScroll = 0;
     float mTimeScale = 0.01f;
@@ -60,9 +72,6 @@ struct ScopeData {
     int mFFTZoom = 0;
     int mPot = 0;
     bool darkMode = true;
-    float fft1[65536 * 2];
-    float fft2[65536 * 2];
-    float ffta[65536 * 2];
     unsigned int colors[4] = {
         0xffc0c0c0,
         0xffa0a0ff,
@@ -75,44 +84,162 @@ struct ScopeData {
         float mScale = 1.0f / 5.0f;
         int mScaleSlider = 0;
         float mOffset = 0;
-        float* mData = nullptr;
+        float* const mData;
+        float* mLevels[kNumLevels] = {}; // interleaved min and max
+        unsigned int mLevelMask[kNumLevels] = {};
+        float mBlockMin[kNumLevels] = {};
+        float mBlockMax[kNumLevels] = {};
+
+        // the full rate history does not depend on the sample rate, so it is only allocated once
+        Channel()
+            : mData(new float[kRawSize]())
+        {
+        }
 
         ~Channel()
         {
             delete[] mData;
+            for (unsigned int l = 0; l < kNumLevels; l++)
+                delete[] mLevels[l];
         }
 
-        void realloc(const int sampleRate)
+        // clears the history and takes over new level buffers, the previous ones are given back in `levels`
+        void swapLevels(float* levels[kNumLevels], const unsigned int blocks[kNumLevels])
         {
-            mData = new float[sampleRate * 10];
-            memset(mData, 0, sizeof(float) * sampleRate * 10);
+            memset(mData, 0, sizeof(float) * kRawSize);
+
+            for (unsigned int l = 0; l < kNumLevels; l++)
+            {
+                std::swap(mLevels[l], levels[l]);
+                mLevelMask[l] = blocks[l] - 1;
+                mBlockMin[l] = INFINITY;
+                mBlockMax[l] = -INFINITY;
+            }
+        }
+
+        inline void write(const unsigned int index, const float value)
+        {
+            mData[index & (kRawSize - 1)] = value;
+
+            // each level is built from the completed blocks of the previous one
+            float lo = value, hi = value;
+            for (unsigned int l = 0; l < kNumLevels; l++)
+            {
+                if (lo < mBlockMin[l]) mBlockMin[l] = lo;
+                if (hi > mBlockMax[l]) mBlockMax[l] = hi;
+
+                if (((index + 1) & ((1u << kLevelShift[l]) - 1)) != 0)
+                    break;
+
+                float* const block = mLevels[l] + ((index >> kLevelShift[l]) & mLevelMask[l]) * 2;
+                lo = block[0] = mBlockMin[l];
+                hi = block[1] = mBlockMax[l];
+                mBlockMin[l] = INFINITY;
+                mBlockMax[l] = -INFINITY;
+            }
+        }
+
+        // largest magnitude value of a completed block
+        inline float getBlockPeak(const unsigned int l, const unsigned int block) const
+        {
+            const float* const minmax = mLevels[l] + (block & mLevelMask[l]) * 2;
+            return -minmax[0] > minmax[1] ? minmax[0] : minmax[1];
+        }
+
+        // sample at `index - age`, older samples than the full rate history come from the finest level
+        inline float get(const unsigned int index, int age) const
+        {
+            if (age < 1)
+                age = 1;
+
+            if (static_cast<unsigned int>(age) <= kRawSize)
+                return mData[(index - age) & (kRawSize - 1)];
+
+            return getBlockPeak(0, (index - age) >> kLevelShift[0]);
+        }
+
+        // largest magnitude sample between `index - oldest` and `index - newest`,
+        // using the coarsest level whose blocks fit in the range
+        inline float getPeak(const unsigned int index, int oldest, int newest) const
+        {
+            if (newest < 1)
+                newest = 1;
+            if (oldest < newest)
+                oldest = newest;
+
+            const unsigned int span = oldest - newest + 1;
+            int level = -1;
+            for (unsigned int l = 0; l < kNumLevels; l++)
+            {
+                if ((1u << kLevelShift[l]) <= span)
+                    level = l;
+            }
+
+            if (level < 0)
+            {
+                float peak = get(index, newest);
+                for (int age = newest + 1; age <= oldest; age++)
+                {
+                    const float value = get(index, age);
+                    if (std::abs(value) > std::abs(peak))
+                        peak = value;
+                }
+                return peak;
+            }
+
+            // the block currently being written is not complete yet
+            const unsigned int shift = kLevelShift[level];
+            const unsigned int current = index >> shift;
+            const unsigned int first = (index - oldest) >> shift;
+            unsigned int last = (index - newest) >> shift;
+            if (static_cast<int>(current - last) <= 0)
+                last = current - 1;
+
+            float peak = getBlockPeak(level, first);
+            for (unsigned int block = first + 1; static_cast<int>(last - block) >= 0; block++)
+            {
+                const float value = getBlockPeak(level, block);
+                if (std::abs(value) > std::abs(peak))
+                    peak = value;
+            }
+            return peak;
         }
     } mCh[4];
 
     struct {
         int average;
-        ffft::FFTReal<float>* obj16;
-        ffft::FFTReal<float>* obj32;
-        ffft::FFTReal<float>* obj64;
-        ffft::FFTReal<float>* obj128;
-        ffft::FFTReal<float>* obj256;
-        ffft::FFTReal<float>* obj512;
-        ffft::FFTReal<float>* obj1024;
-        ffft::FFTReal<float>* obj2048;
-        ffft::FFTReal<float>* obj4096;
-        ffft::FFTReal<float>* obj8192;
-        ffft::FFTReal<float>* obj16384;
-        ffft::FFTReal<float>* obj32768;
-        ffft::FFTReal<float>* obj65536;
     } fft;
 
+    // must not run concurrently with probe(), the UI is kept out through mMutex
     void realloc(const int sampleRate)
     {
-        mIndex = 0;
-        mSampleRate = sampleRate;
+        unsigned int blocks[kNumLevels];
+        float* levels[4][kNumLevels];
+
+        for (unsigned int l = 0; l < kNumLevels; l++)
+        {
+            const unsigned int minBlocks = (sampleRate * kHistorySeconds >> kLevelShift[l]) + 1;
+            blocks[l] = 1;
+            while (blocks[l] < minBlocks)
+                blocks[l] <<= 1;
+
+            for (int i = 0; i < 4; i++)
+                levels[i][l] = new float[blocks[l] * 2]();
+        }
+
+        {
+            const std::lock_guard<std::mutex> lock(mMutex);
+
+            mIndex = 0;
+            mSampleRate = sampleRate;
+
+            for (int i = 0; i < 4; i++)
+                mCh[i].swapLevels(levels[i], blocks);
+        }
 
         for (int i = 0; i < 4; i++)
-            mCh[i].realloc(sampleRate);
+            for (unsigned int l = 0; l < kNumLevels; l++)
+                delete[] levels[i][l];
     }
 
     inline void probe(float data1, float data2, float data3, float data4)
@@ -120,11 +247,11 @@ struct ScopeData {
         // since probe has several channels, need to deal with index here
         if (mMode == 0)
         {
-            mCh[0].mData[mIndex] = data1;
-            mCh[1].mData[mIndex] = data2;
-            mCh[2].mData[mIndex] = data3;
-            mCh[3].mData[mIndex] = data4;
-            mIndex = (mIndex + 1) % (mSampleRate * 10);
+            mCh[0].write(mIndex, data1);
+            mCh[1].write(mIndex, data2);
+            mCh[2].write(mIndex, data3);
+            mCh[3].write(mIndex, data4);
+            mIndex++;
         }
     }
 };
@@ -40,6 +40,9 @@
 
 #include "sassy.hpp"
 
+#include <memory>
+#include <mutex>
+
 #define POW_2_3_4TH 1.6817928305074290860622509524664297900800685247135690216264521719
 
 static double catmullrom(double t, double p0, double p1, double p2, double p3)
@@ -76,6 +79,25 @@ static const float timescalesteps[5] =
     1.0f,
 };
 
+// FFT plans and scratch buffers are shared by all scopes, plans are only created for the sizes in use
+static std::mutex gFFTMutex;
+static std::unique_ptr<ffft::FFTReal<float>> gFFTPlans[13];
+static float gFFTInput[65536 * 2];
+static float gFFTOutput[65536 * 2];
+static float gFFTAverage[65536 * 2];
+
+static ffft::FFTReal<float>* getFFTPlan(const int pot)
+{
+    int i = 0;
+    while ((16 << i) < pot)
+        i++;
+
+    if (!gFFTPlans[i])
+        gFFTPlans[i].reset(new ffft::FFTReal<float>((16 << i) * 2));
+
+    return gFFTPlans[i].get();
+}
+
 static const char* timescaletext[5] =
 {
     "0.1ms",
@@ -144,7 +166,7 @@ static void scope_grid(const float uiScale)
 }
 
 
-static int scope_sync(ScopeData* gScope, int index)
+static int scope_sync(ScopeData* gScope, unsigned int index)
 {
     const float gSamplerate = gScope->mSampleRate;
     int samples = (int)(gSamplerate * gScope->mTimeScale);
@@ -156,21 +178,21 @@ static int scope_sync(ScopeData* gScope, int index)
         // calculate sync
         if (gScope->mSyncMode == 0)
         {
-            float* graphdata = gScope->mCh[gScope->mSyncChannel].mData;
+            const ScopeData::Channel& ch = gScope->mCh[gScope->mSyncChannel];
             int over = ofs;
-            while (over < (cycle - ofs) && graphdata[(index - over + cycle) % cycle] < 0) over++;
+            while (over < (cycle - ofs) && ch.get(index, over) < 0) over++;
             int under = over;
-            while (under < (cycle - ofs) && graphdata[(index - under + cycle) % cycle] > 0) under++;
+            while (under < (cycle - ofs) && ch.get(index, under) > 0) under++;
             ofs = under;
         }
         else
             if (gScope->mSyncMode == 1)
             {
-                float* graphdata = gScope->mCh[gScope->mSyncChannel].mData;
+                const ScopeData::Channel& ch = gScope->mCh[gScope->mSyncChannel];
                 int under = ofs;
-                while (under < (cycle - ofs) && graphdata[(index - under + cycle) % cycle] > 0) under++;
+                while (under < (cycle - ofs) && ch.get(index, under) > 0) under++;
                 int over = under;
-                while (over < (cycle - ofs) && graphdata[(index - over + cycle) % cycle] < 0) over++;
+                while (over < (cycle - ofs) && ch.get(index, over) < 0) over++;
                 ofs = over;
             }
         // default: ofs = samples
@@ -190,11 +212,10 @@ static int scope_sync(ScopeData* gScope, int index)
 }
 
 #if 0
-static void scope_plot(ScopeData* gScope, const float uiScale, int index)
+static void scope_plot(ScopeData* gScope, const float uiScale, unsigned int index)
 {
     ImVec2 p = ImGui::GetItemRectMin();
     const float gSamplerate = gScope->mSampleRate;
-    int cycle = gSamplerate * 10;
     /*
     Okay, max scale is 1 second, so..
     */
@@ -212,9 +233,9 @@ static void scope_plot(ScopeData* gScope, const float uiScale, int index)
             {
                 if (gScope->mCh[j].mEnabled)
                 {
-                    float* graphdata = gScope->mCh[j].mData;
-                    float y = graphdata[(index - ofs + i * samples / 16384 + cycle) % cycle];
-                    float x = graphdata[(index - ofs + i * samples / 16384 + cycle - 1) % cycle];
+                    const ScopeData::Channel& ch = gScope->mCh[j];
+                    float y = ch.get(index, ofs - i * samples / 16384);
+                    float x = ch.get(index, ofs - i * samples / 16384 + 1);
                     x = x * gScope->mCh[j].mScale;
                     y = y * gScope->mCh[j].mScale - gScope->mCh[j].mOffset;
                     ImGui::GetWindowDrawList()->AddCircleFilled(
@@ -233,10 +254,8 @@ static void scope_plot(ScopeData* gScope, const float uiScale, int index)
             {
                 if (gScope->mCh[j*2].mEnabled)
                 {
-                    float* graphdata = gScope->mCh[j * 2].mData;
-                    float x = graphdata[(index - ofs + i * samples / 32768 + cycle) % cycle];
-                    graphdata = gScope->mCh[j * 2 + 1].mData;
-                    float y = graphdata[(index - ofs + i * samples / 32768 + cycle) % cycle];
+                    float x = gScope->mCh[j * 2].get(index, ofs - i * samples / 32768);
+                    float y = gScope->mCh[j * 2 + 1].get(index, ofs - i * samples / 32768);
                     x = x * gScope->mCh[j * 2].mScale - gScope->mCh[j * 2].mOffset;
                     y = y * gScope->mCh[j * 2 + 1].mScale - gScope->mCh[j * 2 + 1].mOffset;
                     ImGui::GetWindowDrawList()->AddCircleFilled(
@@ -251,11 +270,10 @@ static void scope_plot(ScopeData* gScope, const float uiScale, int index)
 }
 #endif
 
-static void scope_time(ScopeData* gScope, const float uiScale, int index)
+static void scope_time(ScopeData* gScope, const float uiScale, unsigned int index)
 {
     ImVec2 p = ImGui::GetItemRectMin();
     const float gSamplerate = gScope->mSampleRate;
-    int cycle = gSamplerate * 10;
     ImDrawList* dl = ImGui::GetWindowDrawList();
     /*
     Okay, max scale is 1 second, so..
@@ -272,14 +290,13 @@ static void scope_time(ScopeData* gScope, const float uiScale, int index)
         {
             if (gScope->mCh[j].mEnabled)
             {
-                float* graphdata = gScope->mCh[j].mData;
+                const ScopeData::Channel& ch = gScope->mCh[j];
                 ImVec2 vert[grid_size];
                 for (int i = 0; i < grid_size; i++)
                 {
-                    float v0 = -graphdata[(index - ofs + i * samples / grid_size + cycle) % cycle];
-                    float v1 = -graphdata[(index - ofs + (i + 1) * samples / grid_size + cycle) % cycle];
+                    // peak of all the samples covered by this pixel
+                    float v0 = -ch.getPeak(index, ofs - i * samples / grid_size, ofs - (i + 1) * samples / grid_size + 1);
                     v0 = v0 * gScope->mCh[j].mScale - gScope->mCh[j].mOffset;
-                    v1 = v1 * gScope->mCh[j].mScale - gScope->mCh[j].mOffset;
                     vert[i].x = p.x + i * uiScale;
                     vert[i].y = p.y + (grid_size / 2 + v0 * grid_quarter_size) * uiScale;
                 }
@@ -317,10 +334,10 @@ static void scope_time(ScopeData* gScope, const float uiScale, int index)
         {
             if (gScope->mCh[j].mEnabled)
             {
-                float* graphdata = gScope->mCh[j].mData;
+                const ScopeData::Channel& ch = gScope->mCh[j];
                 for (int i = 0; i < samples; i++)
                 {
-                    float v0 = -graphdata[(index - ofs + i + cycle) % cycle];
+                    float v0 = -ch.get(index, ofs - i);
                     float v1 = 0;
                     v0 = v0 * gScope->mCh[j].mScale - gScope->mCh[j].mOffset;
                     v1 = v1 * gScope->mCh[j].mScale - gScope->mCh[j].mOffset;
@@ -355,10 +372,10 @@ static void scope_time(ScopeData* gScope, const float uiScale, int index)
         if (gScope->mCh[0].mEnabled || gScope->mCh[1].mEnabled || gScope->mCh[2].mEnabled || gScope->mCh[3].mEnabled)
         {
             ImGui::BeginTooltip();
-            if (gScope->mCh[0].mEnabled) ImGui::Text("Ch 0: %3.3f", gScope->mCh[0].mData[(index - ofs + ((int)mp.x / (int)uiScale) * samples / grid_size + cycle) % cycle]);
-            if (gScope->mCh[1].mEnabled) ImGui::Text("Ch 1: %3.3f", gScope->mCh[1].mData[(index - ofs + ((int)mp.x / (int)uiScale) * samples / grid_size + cycle) % cycle]);
-            if (gScope->mCh[2].mEnabled) ImGui::Text("Ch 2: %3.3f", gScope->mCh[2].mData[(index - ofs + ((int)mp.x / (int)uiScale) * samples / grid_size + cycle) % cycle]);
-            if (gScope->mCh[3].mEnabled) ImGui::Text("Ch 3: %3.3f", gScope->mCh[3].mData[(index - ofs + ((int)mp.x / (int)uiScale) * samples / grid_size + cycle) % cycle]);
+            if (gScope->mCh[0].mEnabled) ImGui::Text("Ch 0: %3.3f", gScope->mCh[0].get(index, ofs - ((int)mp.x / (int)uiScale) * samples / grid_size));
+            if (gScope->mCh[1].mEnabled) ImGui::Text("Ch 1: %3.3f", gScope->mCh[1].get(index, ofs - ((int)mp.x / (int)uiScale) * samples / grid_size));
+            if (gScope->mCh[2].mEnabled) ImGui::Text("Ch 2: %3.3f", gScope->mCh[2].get(index, ofs - ((int)mp.x / (int)uiScale) * samples / grid_size));
+            if (gScope->mCh[3].mEnabled) ImGui::Text("Ch 3: %3.3f", gScope->mCh[3].get(index, ofs - ((int)mp.x / (int)uiScale) * samples / grid_size));
             ImGui::EndTooltip();
         }
     }
@@ -371,12 +388,11 @@ static void vertline(const float uiScale, const float x, const float w)
     ImGui::GetWindowDrawList()->AddLine(ImVec2(p.x + x * uiScale, p.y), ImVec2(p.x + x * uiScale, p.y + (grid_size) * uiScale), 0xff000000, w);
 }
 
-static void scope_freq(ScopeData* gScope, const float uiScale, int index)
+static void scope_freq(ScopeData* gScope, const float uiScale, unsigned int index)
 {
     ImVec2 p = ImGui::GetItemRectMin();
     ImDrawList* dl = ImGui::GetWindowDrawList();
     const float gSamplerate = gScope->mSampleRate;
-    int cycle = gSamplerate * 10;
     /*
     Okay, max scale is 1 second, so..
     */
@@ -398,24 +414,8 @@ static void scope_freq(ScopeData* gScope, const float uiScale, int index)
 
     gScope->mPot = pot;
 
-    ffft::FFTReal<float>* fft = NULL;
-    switch (pot)
-    {
-    case 16: fft = gScope->fft.obj16; break;
-    case 32: fft = gScope->fft.obj32; break;
-    case 64: fft = gScope->fft.obj64; break;
-    case 128: fft = gScope->fft.obj128; break;
-    case 256: fft = gScope->fft.obj256; break;
-    case 512: fft = gScope->fft.obj512; break;
-    case 1024: fft = gScope->fft.obj1024; break;
-    case 2048: fft = gScope->fft.obj2048; break;
-    case 4096: fft = gScope->fft.obj4096; break;
-    case 8192: fft = gScope->fft.obj8192; break;
-    case 16384: fft = gScope->fft.obj16384; break;
-    case 32768: fft = gScope->fft.obj32768; break;
-    case 65536: fft = gScope->fft.obj65536; break;
-    }
-    if (!fft) return;
+    const std::lock_guard<std::mutex> lock(gFFTMutex);
+    ffft::FFTReal<float>* const fft = getFFTPlan(pot);
 
     int average = gScope->fft.average;
     int ofs = scope_sync(gScope, index);
@@ -438,21 +438,21 @@ static void scope_freq(ScopeData* gScope, const float uiScale, int index)
         {
 
 
-            memset(gScope->ffta, 0, sizeof(float) * 65536 * 2);
+            memset(gFFTAverage, 0, sizeof(gFFTAverage));
             for (int k = 0; k < average; k++)
             {
-                float* graphdata = gScope->mCh[j].mData;
+                const ScopeData::Channel& ch = gScope->mCh[j];
 
                 for (int i = 0; i < pot; i++)
                 {
-                    gScope->fft1[i * 2] = graphdata[(index - ofs + i + cycle - k) % cycle];
-                    gScope->fft1[i * 2 + 1] = 0;
+                    gFFTInput[i * 2] = ch.get(index, ofs - i + k);
+                    gFFTInput[i * 2 + 1] = 0;
                 }
 
-                fft->do_fft(gScope->fft2, gScope->fft1);
+                fft->do_fft(gFFTOutput, gFFTInput);
 
                 for (int i = 0; i < pot / 4; i++)
-                    gScope->ffta[i] += (1.0f / average) * sqrt(gScope->fft2[i * 2 + 0] * gScope->fft2[i * 2 + 0] + gScope->fft2[i * 2 + 1] * gScope->fft2[i * 2 + 1]);
+                    gFFTAverage[i] += (1.0f / average) * sqrt(gFFTOutput[i * 2 + 0] * gFFTOutput[i * 2 + 0] + gFFTOutput[i * 2 + 1] * gFFTOutput[i * 2 + 1]);
             }
 
             ImVec2 vert[size];
@@ -463,10 +463,10 @@ static void scope_freq(ScopeData* gScope, const float uiScale, int index)
                 freqbins[i] = ppos * freqbin;
                 
                 float f = ppos - (int)ppos;
-                float a = i ? gScope->ffta[(int)ppos - 1] : 0;
-                float b = gScope->ffta[(int)ppos];
-                float c = i < size ? gScope->ffta[(int)ppos + 1] : 0;
-                float d = i < (size-1) ? gScope->ffta[(int)ppos + 2] : 0;
+                float a = i ? gFFTAverage[(int)ppos - 1] : 0;
+                float b = gFFTAverage[(int)ppos];
+                float c = i < size ? gFFTAverage[(int)ppos + 1] : 0;
+                float d = i < (size-1) ? gFFTAverage[(int)ppos + 2] : 0;
 
                 float v0 = (float)catmullrom(f, a, b, c, d);
                 
@@ -521,7 +521,7 @@ static int groups(ScopeData* gScope, double h)
     int count = 0;
     for (int i = 1; i < gScope->mPot / 4; i++)
     {
-        if (gScope->fft1[i - 1] < h && gScope->fft1[i] > h)
+        if (gFFTInput[i - 1] < h && gFFTInput[i] > h)
             count++;
     }
     return count;
@@ -529,11 +529,13 @@ static int groups(ScopeData* gScope, double h)
 
 static void detect_fundamentals(ScopeData* gScope)
 {
-    // gScope->fft1[1..pot/4] has our mags
+    const std::lock_guard<std::mutex> lock(gFFTMutex);
+
+    // gFFTInput[1..pot/4] has our mags
     double maxmag = 0;
     for (int i = 0; i < gScope->mPot / 4; i++)
-        if (maxmag < gScope->fft1[i]) 
-            maxmag = gScope->fft1[i];
+        if (maxmag < gFFTInput[i]) 
+            maxmag = gFFTInput[i];
 
     double minmag = 0;
     int count = 0;
@@ -563,18 +565,18 @@ static void detect_fundamentals(ScopeData* gScope)
     int startbin = 0;
     for (int i = 2; i < gScope->mPot / 4; i++)
     {
-        if (gScope->fft1[i - 1] < h && gScope->fft1[i] > h)
+        if (gFFTInput[i - 1] < h && gFFTInput[i] > h)
         {
             startbin = i;
         }
-        if (gScope->fft1[i - 1] > h && gScope->fft1[i] < h)
+        if (gFFTInput[i - 1] > h && gFFTInput[i] < h)
         {
             double sum = 0;
             double magsum = 0;
             for (int j = startbin; j < i; j++)
             {
-                sum += gScope->fft1[j];
-                magsum += gScope->fft1[j] * j * freqbin;
+                sum += gFFTInput[j];
+                magsum += gFFTInput[j] * j * freqbin;
             }
             if (sum != 0)
             {
@@ -596,8 +598,10 @@ static void detect_fundamentals(ScopeData* gScope)
 
 void do_show_scope_window(ScopeData* gScope, const float uiScale)
 {
+    const std::lock_guard<std::mutex> lock(gScope->mMutex);
+
     // Data is updated live, so let's take local copies of critical stuff.
-    int index = gScope->mIndex;
+    unsigned int index = gScope->mIndex;
 
     ImGui::Begin("Scope", nullptr, ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize);
 
@@ -19,6 +19,8 @@
 #include "plugin.hpp"
 #include "widgets.hpp"
 
+#include <dsp/fastmath.hpp>
+
 // --------------------------------------------------------------------------------------------------------------------
 
 struct ZamAudioCompModule : Module {
@@ -59,12 +61,12 @@ struct ZamAudioCompModule : Module {
 
 	static inline float
 	from_dB(float gdb) {
-	        return (expf(0.05f*gdb*logf(10.f)));
+	        return dsp::fastDbToGain(gdb);
 	}
 
 	static inline float
 	to_dB(float g) {
-	        return (20.f*log10f(g));
+	        return dsp::fastGainToDb(g);
 	}
 
     ZamAudioCompModule()
@@ -102,7 +104,7 @@ struct ZamAudioCompModule : Module {
 	    const float srate = args.sampleRate;
 	    const float width = (6.f * knee) + 0.01;
 	    const float slewwidth = 1.8f;
-        const float release_coeff = exp(-1000.f/(release * srate));
+        const float release_coeff = dsp::fastExp(-1000.f/(release * srate));
 
         // const float gain = std::pow(params[0].getValue(), 2.f);
 
@@ -135,8 +137,8 @@ struct ZamAudioCompModule : Module {
         }
 
         const float attack_coeff = attslew
-                                 ? exp(-1000.f/((attack + 2.0*(slewfactor - 1)) * srate))
-                                 : exp(-1000.f/(attack * srate));
+                                 ? dsp::fastExp(-1000.f/((attack + 2.f*(slewfactor - 1)) * srate))
+                                 : dsp::fastExp(-1000.f/(attack * srate));
         // Don't slew on release
 
         const float Lxl = Lxg - Lyg;
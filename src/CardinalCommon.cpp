@@ -95,6 +95,9 @@ namespace asset {
 std::string patchesPath();
 void destroy();
 }
+namespace engine {
+void Engine_setModuleLatency(Engine*, Module*, uint32_t);
+}
 namespace plugin {
 void initStaticPlugins();
 void destroyStaticPlugins();
@@ -202,6 +205,11 @@ void CardinalPluginContext::removeIdleCallback(IdleCallback* const cb) const
    #endif
 }
 
+void CardinalPluginContext::setModuleLatency(rack::engine::Module* const module, const uint32_t frames)
+{
+    rack::engine::Engine_setModuleLatency(engine, module, frames);
+}
+
 void CardinalPluginContext::writeMidiMessage(const rack::midi::Message& message, const uint8_t channel)
 {
     if (bypassed)
@@ -24,6 +24,8 @@ struct Menu;
 
 namespace window {
 void generateScreenshot();
+/** Get the rate of UI idle calls and of frames that were actually drawn, averaged over the last second. */
+void getFrameRates(double& idleRate, double& drawRate);
 }
 
 bool isMini();
@@ -26,10 +26,14 @@
  */
 
 #include "CardinalCommon.hpp"
+#include "CardinalPluginContext.hpp"
 
+#include <atomic>
 #include <regex>
 
+#include <app/CableWidget.hpp>
 #include <app/ModuleWidget.hpp>
+#include <app/PortWidget.hpp>
 #include <app/RackWidget.hpp>
 #include <app/Scene.hpp>
 #include <engine/Engine.hpp>
@@ -73,6 +77,109 @@ static void CardinalModuleWidget__saveSelectionDialog(RackWidget* const w)
     });
 }
 
+// --------------------------------------------------------------------------------------------------------------------
+
+// number of placeholders alive, so that scene steps can skip looking for them most of the time
+static std::atomic<int> numDeferredModuleWidgets(0);
+
+/**
+ * Placeholder widget used for modules loaded while no UI is attached.
+ * It contains only bare ports so that cables can be attached to it, the real widget (with its panel, framebuffers,
+ * lights and so on) is created the first time the rack is shown.
+ */
+struct DeferredModuleWidget : ModuleWidget {
+    DeferredModuleWidget(plugin::Model* const m, engine::Module* const mod)
+    {
+        setModel(m);
+        setModule(mod);
+        box.size.x = RACK_GRID_WIDTH;
+
+        for (int i = 0, count = mod->getNumInputs(); i < count; ++i)
+            addInput(createDeferredPort(mod, engine::Port::INPUT, i));
+
+        for (int i = 0, count = mod->getNumOutputs(); i < count; ++i)
+            addOutput(createDeferredPort(mod, engine::Port::OUTPUT, i));
+
+        ++numDeferredModuleWidgets;
+    }
+
+    ~DeferredModuleWidget() override
+    {
+        --numDeferredModuleWidgets;
+    }
+
+    void draw(const DrawArgs&) override {}
+
+    static PortWidget* createDeferredPort(engine::Module* const mod, const engine::Port::Type type, const int portId)
+    {
+        PortWidget* const pw = new PortWidget;
+        pw->module = mod;
+        pw->type = type;
+        pw->portId = portId;
+        pw->hide();
+        return pw;
+    }
+};
+
+bool shouldDeferModuleWidgetCreation()
+{
+    const CardinalPluginContext* const pcontext = static_cast<CardinalPluginContext*>(APP);
+    return pcontext != nullptr && pcontext->ui == nullptr && pcontext->scene != nullptr;
+}
+
+ModuleWidget* createDeferredModuleWidget(plugin::Model* const model, engine::Module* const module)
+{
+    DISTRHO_SAFE_ASSERT_RETURN(model != nullptr, nullptr);
+    DISTRHO_SAFE_ASSERT_RETURN(module != nullptr, nullptr);
+
+    return new DeferredModuleWidget(model, module);
+}
+
+void realizeDeferredModuleWidgets()
+{
+    if (numDeferredModuleWidgets == 0)
+        return;
+
+    RackWidget* const rack = APP->scene->rack;
+
+    for (ModuleWidget* const placeholder : rack->getModules())
+    {
+        if (dynamic_cast<DeferredModuleWidget*>(placeholder) == nullptr)
+            continue;
+
+        CardinalPluginModelHelper* const helper = dynamic_cast<CardinalPluginModelHelper*>(placeholder->getModel());
+        DISTRHO_SAFE_ASSERT_CONTINUE(helper != nullptr);
+
+        engine::Module* const module = placeholder->getModule();
+        DISTRHO_SAFE_ASSERT_CONTINUE(module != nullptr);
+
+        ModuleWidget* const mw = helper->createModuleWidgetNow(module);
+        DISTRHO_SAFE_ASSERT_CONTINUE(mw != nullptr);
+
+        mw->box.pos = placeholder->box.pos;
+
+        // the module now belongs to the real widget
+        placeholder->releaseModule();
+
+        widget::Widget* const container = placeholder->parent;
+        container->addChildBelow(mw, placeholder);
+
+        // move cables over to the ports of the real widget
+        for (CableWidget* const cw : rack->getCompleteCables())
+        {
+            if (cw->inputPort != nullptr && cw->inputPort->parent == placeholder)
+                cw->inputPort = mw->getInput(cw->inputPort->portId);
+            if (cw->outputPort != nullptr && cw->outputPort->parent == placeholder)
+                cw->outputPort = mw->getOutput(cw->outputPort->portId);
+        }
+
+        container->removeChild(placeholder);
+        delete placeholder;
+    }
+
+    rack->updateExpanders();
+}
+
 }
 }
 
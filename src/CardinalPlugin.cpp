@@ -25,17 +25,24 @@
 #if defined(HAVE_LIBLO) && defined(HEADLESS)
 # include <lo/lo.h>
 # include "extra/Thread.hpp"
+#elif CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+# include "extra/Thread.hpp"
+#endif
+
+#if CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+# include "extra/RingBuffer.hpp"
 #endif
 
+#include <atomic>
 #include <cfloat>
 #include <list>
+#include <unordered_map>
 
 #include "CardinalCommon.hpp"
 #include "DistrhoPluginUtils.hpp"
 #include "CardinalPluginContext.hpp"
 #include "extra/Base64.hpp"
 #include "extra/ScopedDenormalDisable.hpp"
-#include "extra/ScopedSafeLocale.hpp"
 
 #ifdef DISTRHO_OS_WASM
 # include <emscripten/emscripten.h>
@@ -62,6 +69,13 @@ std::string patchesPath();
 #endif
 namespace engine {
 void Engine_setAboutToClose(Engine*);
+#if DISTRHO_PLUGIN_WANT_LATENCY
+uint32_t Engine_getLatency(Engine*);
+#endif
+#if CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+void Engine_collectVisualState(Engine*, std::unordered_map<int64_t, std::vector<uint8_t>>&, std::vector<uint8_t>&);
+void Engine_setVisualDisplayModules(Engine*, const std::vector<int64_t>&);
+#endif
 }
 }
 
@@ -158,6 +172,147 @@ struct ScopedContext {
 
 // -----------------------------------------------------------------------------------------------------------
 
+#if CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+static int8_t base64CharValue(const char c) noexcept
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+')
+        return 62;
+    if (c == '/')
+        return 63;
+    return -1;
+}
+
+// Moves as many overflowed parameter changes into the ring buffer as fit, oldest first.
+// Does not allocate memory, so run() can call it too.
+static void flushParamChanges(HeapRingBuffer& ringBuffer, std::vector<remoteUtils::ParamChange>& overflow)
+{
+    size_t count = 0;
+
+    while (count < overflow.size() && ringBuffer.getWritableDataSize() >= sizeof(remoteUtils::ParamChange))
+        ringBuffer.writeCustomType(overflow[count++]);
+
+    if (count == 0)
+        return;
+
+    ringBuffer.commitWrite();
+    overflow.erase(overflow.begin(), overflow.begin() + count);
+}
+
+// Decodes base64 encoded parameter changes straight into a ring buffer, without allocating memory.
+// Changes that do not fit, and all changes after them, go to `overflow` instead, coalesced per module parameter,
+// so a full ring buffer neither blocks nor loses changes.
+static void writeParamChangesFromBase64(HeapRingBuffer& ringBuffer,
+                                        std::vector<remoteUtils::ParamChange>& overflow,
+                                        const char* const base64)
+{
+    flushParamChanges(ringBuffer, overflow);
+
+    uint8_t record[sizeof(remoteUtils::ParamChange)];
+    uint recordSize = 0;
+    uint32_t bits = 0;
+    int numBits = 0;
+
+    for (const char* s = base64; *s != '\0'; ++s)
+    {
+        const int8_t value = base64CharValue(*s);
+        if (value < 0)
+            continue;
+
+        bits = ((bits << 6) | value) & 0xffffff;
+        numBits += 6;
+
+        if (numBits < 8)
+            continue;
+
+        numBits -= 8;
+        record[recordSize++] = (bits >> numBits) & 0xff;
+
+        if (recordSize != sizeof(record))
+            continue;
+
+        recordSize = 0;
+
+        // keep changes in order, once something overflows everything after it does too
+        if (overflow.empty() && ringBuffer.getWritableDataSize() >= sizeof(record))
+        {
+            ringBuffer.writeCustomData(record, sizeof(record));
+            continue;
+        }
+
+        remoteUtils::ParamChange change;
+        std::memcpy(&change, record, sizeof(record));
+
+        bool coalesced = false;
+        for (remoteUtils::ParamChange& pending : overflow)
+        {
+            if (pending.moduleId == change.moduleId && pending.paramId == change.paramId)
+            {
+                pending.value = change.value;
+                coalesced = true;
+                break;
+            }
+        }
+
+        if (! coalesced)
+            overflow.push_back(change);
+    }
+
+    ringBuffer.commitWrite();
+}
+
+// Periodically publishes module lights and output voltages, so the UI can show them without running the patch.
+// Only modules that changed are sent, plus the new state of the on-screen visual state providers the UI asked for.
+// Runs only while a UI is open.
+class VisualStateThread : public Thread
+{
+    static constexpr const uint kIntervalInMs = 1000 / 30;
+
+    CardinalBasePlugin* const plugin;
+    std::vector<uint8_t> data;
+    std::unordered_map<int64_t, std::vector<uint8_t>> lastStates;
+    std::atomic<bool> fullStateRequested;
+
+public:
+    VisualStateThread(CardinalBasePlugin* const p)
+        : Thread("CardinalVisualState"),
+          plugin(p),
+          fullStateRequested(false) {}
+
+    // resend everything on the next run, for a newly opened UI
+    void requestFullState() noexcept
+    {
+        fullStateRequested = true;
+    }
+
+protected:
+    void run() override
+    {
+        while (! shouldThreadExit())
+        {
+            d_msleep(kIntervalInMs);
+
+            if (fullStateRequested.exchange(false))
+                lastStates.clear();
+
+            rack::engine::Engine_collectVisualState(plugin->context->engine, lastStates, data);
+
+            if (data.empty())
+                continue;
+
+            plugin->updateStateValue("visual", String::asBase64(data.data(), data.size()));
+        }
+    }
+};
+#endif
+
+// -----------------------------------------------------------------------------------------------------------
+
 class CardinalPlugin : public CardinalBasePlugin
 {
    #ifdef DISTRHO_OS_WASM
@@ -186,6 +341,11 @@ class CardinalPlugin : public CardinalBasePlugin
 
     // bypass handling
     bool fWasBypassed;
+
+   #if DISTRHO_PLUGIN_WANT_LATENCY
+    // latency of the patch along the paths into host outputs
+    uint32_t fLatency = 0;
+   #endif
     MidiEvent bypassMidiEvents[16];
 
    #if CARDINAL_VARIANT_MINI || !defined(HEADLESS)
@@ -194,6 +354,12 @@ class CardinalPlugin : public CardinalBasePlugin
    #endif
    #if CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
     float fMiniReportValues[kCardinalParameterCountAtMini - kCardinalParameterStartMini];
+    ScopedPointer<VisualStateThread> fVisualStateThread;
+    // parameter changes from the UI, drained at the start of each run
+    HeapRingBuffer fParamChanges;
+    // changes that did not fit the ring buffer, coalesced per module parameter and guarded by the mutex
+    std::vector<remoteUtils::ParamChange> fParamChangesOverflow;
+    Mutex fParamChangesMutex;
    #endif
 
    #ifdef DISTRHO_PLUGIN_EXTRA_IO
@@ -248,6 +414,7 @@ public:
         fMiniReportValues[kCardinalParameterMiniTimeBeatsPerBar - kCardinalParameterStartMini] = 4;
         fMiniReportValues[kCardinalParameterMiniTimeBeatType - kCardinalParameterStartMini] = 4;
         fMiniReportValues[kCardinalParameterMiniTimeBeatsPerMinute - kCardinalParameterStartMini] = 120;
+        fParamChanges.createBuffer(sizeof(remoteUtils::ParamChange) * 1024);
        #endif
 
         // create unique temporary path for this instance
@@ -320,6 +487,14 @@ public:
 
     ~CardinalPlugin() override
     {
+       #if CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+        if (fVisualStateThread != nullptr)
+        {
+            fVisualStateThread->stopThread(5000);
+            fVisualStateThread = nullptr;
+        }
+       #endif
+
        #ifdef HAVE_LIBLO
         if (fInitializer->remotePluginInstance == this)
             fInitializer->remotePluginInstance = nullptr;
@@ -933,6 +1108,16 @@ protected:
             state.key = "param";
             state.label = "ParamChange";
             break;
+        case kCardinalStateVisual:
+            state.hints = kStateIsOnlyForUI | kStateIsBase64Blob;
+            state.key = "visual";
+            state.label = "Visual";
+            break;
+        case kCardinalStateVisualRequest:
+            state.hints = kStateIsOnlyForDSP | kStateIsBase64Blob;
+            state.key = "visualRequest";
+            state.label = "VisualRequest";
+            break;
        #endif
         }
     }
@@ -1049,18 +1234,47 @@ protected:
        #if CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
         if (std::strcmp(key, "param") == 0)
         {
-            long long moduleId = 0;
-            int paramId = 0;
-            float paramValue = 0.f;
-            {
-                const ScopedSafeLocale cssl;
-                std::sscanf(value, "%lld:%d:%f", &moduleId, &paramId, &paramValue);
-            }
+            const MutexLocker cml(fParamChangesMutex);
+            writeParamChangesFromBase64(fParamChanges, fParamChangesOverflow, value);
+            return;
+        }
+
+        // published by us for the UI, nothing to do
+        if (std::strcmp(key, "visual") == 0)
+            return;
+
+        // first byte is a CardinalVisualRequest, followed by the ids of modules whose visual state the UI wants
+        if (std::strcmp(key, "visualRequest") == 0)
+        {
+            const std::vector<uint8_t> data(d_getChunkFromBase64String(value));
+            DISTRHO_SAFE_ASSERT_RETURN(! data.empty(),);
+
+            std::vector<int64_t> moduleIds((data.size() - 1) / sizeof(int64_t));
+            std::memcpy(moduleIds.data(), data.data() + 1, moduleIds.size() * sizeof(int64_t));
 
-            rack::engine::Module* const module = context->engine->getModule(moduleId);
-            DISTRHO_SAFE_ASSERT_RETURN(module != nullptr,);
+            rack::engine::Engine_setVisualDisplayModules(context->engine, moduleIds);
 
-            context->engine->setParamValue(module, paramId, paramValue);
+            switch (data[0])
+            {
+            case kCardinalVisualRequestUIOpened:
+                if (fVisualStateThread == nullptr)
+                {
+                    fVisualStateThread = new VisualStateThread(this);
+                    fVisualStateThread->startThread();
+                }
+                else
+                {
+                    fVisualStateThread->requestFullState();
+                }
+                break;
+            case kCardinalVisualRequestUIClosed:
+                if (fVisualStateThread != nullptr)
+                {
+                    fVisualStateThread->stopThread(5000);
+                    fVisualStateThread = nullptr;
+                }
+                break;
+            }
             return;
         }
        #endif
@@ -1267,6 +1481,33 @@ protected:
        #if CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
         for (int i=0; i<DISTRHO_PLUGIN_NUM_INPUTS; ++i)
             fMiniReportValues[i] = context->dataIns[i][0];
+
+        // move changes that did not fit before, unless the UI side is busy adding more
+        if (fParamChangesMutex.tryLock())
+        {
+            flushParamChanges(fParamChanges, fParamChangesOverflow);
+            fParamChangesMutex.unlock();
+        }
+
+        if (fParamChanges.isDataAvailableForReading())
+        {
+            remoteUtils::ParamChange change;
+            rack::engine::Module* module = nullptr;
+
+            while (fParamChanges.readCustomType(change))
+            {
+                // changes usually come in bursts for the same module, avoid looking it up again
+                if (module == nullptr || module->id != change.moduleId)
+                    module = context->engine->getModule(change.moduleId);
+
+                if (module == nullptr)
+                    continue;
+                if (change.paramId < 0 || change.paramId >= static_cast<int32_t>(module->params.size()))
+                    continue;
+
+                context->engine->setParamValue(module, change.paramId, change.value);
+            }
+        }
        #endif
 
         if (bypassed)
@@ -1291,6 +1532,16 @@ protected:
         ++context->processCounter;
         context->engine->stepBlock(frames);
 
+       #if DISTRHO_PLUGIN_WANT_LATENCY
+        const uint32_t latency = rack::engine::Engine_getLatency(context->engine);
+
+        if (fLatency != latency)
+        {
+            fLatency = latency;
+            setLatency(latency);
+        }
+       #endif
+
         fWasBypassed = bypassed;
     }
 
@@ -97,11 +97,22 @@ enum CardinalStates {
    #endif
    #if CARDINAL_VARIANT_MINI
     kCardinalStateParamChange,
+    kCardinalStateVisual,
+    kCardinalStateVisualRequest,
    #endif
   #endif
     kCardinalStateCount
 };
 
+#if CARDINAL_VARIANT_MINI
+// first byte of the "visualRequest" state, followed by the ids of on-screen modules with visual state providers
+enum CardinalVisualRequest {
+    kCardinalVisualRequestUpdate,
+    kCardinalVisualRequestUIOpened,
+    kCardinalVisualRequestUIClosed,
+};
+#endif
+
 static_assert(kCardinalParameterBypass == kModuleParameterCount, "valid parameter indexes");
 #if CARDINAL_VARIANT_LOADER
 #elif CARDINAL_VARIANT_MINI || !defined(HEADLESS)
@@ -15,7 +15,6 @@
 #include "CardinalRemote.hpp"
 #include "CardinalPluginContext.hpp"
 #include "extra/Base64.hpp"
-#include "extra/ScopedSafeLocale.hpp"
 
 #if defined(STATIC_BUILD) || ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
 # undef HAVE_LIBLO
@@ -98,6 +97,11 @@ bool connectToRemote(const char* const url)
         remoteDetails->connected = true;
         remoteDetails->first = false;
         remoteDetails->screenshot = false;
+       #if CARDINAL_VARIANT_MINI
+        remoteDetails->localEngineIsUIOnly = true;
+       #else
+        remoteDetails->localEngineIsUIOnly = false;
+       #endif
     }
    #elif defined(HAVE_LIBLO)
     const lo_address addr = lo_address_new_from_url(url);
@@ -115,6 +119,7 @@ bool connectToRemote(const char* const url)
         remoteDetails->first = true;
         remoteDetails->connected = false;
         remoteDetails->screenshot = false;
+        remoteDetails->localEngineIsUIOnly = false;
 
         lo_server_add_method(oscServer, "/resp", nullptr, osc_handler, remoteDetails);
 
@@ -154,7 +159,16 @@ void disconnectFromRemote(RemoteDetails* const remote)
 void idleRemote(RemoteDetails* const remote)
 {
     DISTRHO_SAFE_ASSERT_RETURN(remote != nullptr,);
-#ifdef HAVE_LIBLO
+#if defined(CARDINAL_REMOTE_ENABLED) && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+    if (remote->pendingParamChanges.empty())
+        return;
+
+    const String data(String::asBase64(remote->pendingParamChanges.data(),
+                                       remote->pendingParamChanges.size() * sizeof(ParamChange)));
+    remote->pendingParamChanges.clear();
+
+    static_cast<CardinalBaseUI*>(remote->handle)->setState("param", data);
+#elif defined(HAVE_LIBLO)
     while (lo_server_recv_noblock(static_cast<lo_server>(remote->handle), 0) != 0) {}
 #endif
 }
@@ -163,12 +177,16 @@ void sendParamChangeToRemote(RemoteDetails* const remote, int64_t moduleId, int
 {
 #ifdef CARDINAL_REMOTE_ENABLED
 #if ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
-    char paramBuf[512] = {};
+    for (ParamChange& change : remote->pendingParamChanges)
     {
-        const ScopedSafeLocale cssl;
-        std::snprintf(paramBuf, sizeof(paramBuf), "%lld:%d:%f", (long long)moduleId, paramId, value);
+        if (change.moduleId == moduleId && change.paramId == paramId)
+        {
+            change.value = value;
+            return;
+        }
     }
-    static_cast<CardinalBaseUI*>(remote->handle)->setState("param", paramBuf);
+
+    remote->pendingParamChanges.push_back({ moduleId, paramId, value });
 #elif defined(HAVE_LIBLO)
     const lo_address addr = lo_address_new_from_url(remote->url);
     DISTRHO_SAFE_ASSERT_RETURN(addr != nullptr,);
@@ -6,6 +6,9 @@
 
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 #define CARDINAL_DEFAULT_REMOTE_PORT "2228"
 #define CARDINAL_DEFAULT_REMOTE_URL "osc.udp://192.168.51.1:2228"
 
@@ -13,6 +16,15 @@
 
 namespace remoteUtils {
 
+// binary parameter change record, sent in batches as base64 from UI to DSP when not using direct access
+struct ParamChange {
+    int64_t moduleId;
+    int32_t paramId;
+    float value;
+};
+
+static_assert(sizeof(ParamChange) == 16, "ParamChange must be tightly packed");
+
 struct RemoteDetails {
     void* handle;
     const char* url;
@@ -20,6 +32,10 @@ struct RemoteDetails {
     bool first;
     bool connected;
     bool screenshot;
+    // set when the local engine does not process modules, as with the UI side of the split Mini variant
+    bool localEngineIsUIOnly;
+    // changes are coalesced per module parameter and only sent on idle
+    std::vector<ParamChange> pendingParamChanges;
 };
 
 RemoteDetails* getRemote();
@@ -20,6 +20,7 @@
 #include <asset.hpp>
 #include <context.hpp>
 #include <engine/Engine.hpp>
+#include <engine/VisualStateProvider.hpp>
 #include <helpers.hpp>
 #include <patch.hpp>
 #include <settings.hpp>
@@ -70,11 +71,19 @@ std::string patchesPath();
 namespace engine {
 void Engine_setAboutToClose(Engine*);
 void Engine_setRemoteDetails(Engine*, remoteUtils::RemoteDetails*);
+#if CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+void Engine_applyVisualState(Engine*, const uint8_t* data, size_t size);
+#endif
 }
 namespace window {
     void WindowSetPluginUI(Window* window, CardinalBaseUI* ui);
     void WindowSetMods(Window* window, int mods);
+    void WindowSetDirty(Window* window);
     void WindowSetInternalSize(rack::window::Window* window, math::Vec size);
+    bool WindowShouldRedraw(Window* window);
+#if CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+    bool WindowIsModuleWidgetOnScreen(app::ModuleWidget* mw);
+#endif
 }
 }
 
@@ -311,6 +320,10 @@ class CardinalUI : public CardinalBaseUI,
    #ifdef DPF_RUNTIME_TESTING
     bool inSelfTest = false;
    #endif
+   #if CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+    bool visualStateRequested = false;
+    std::vector<int64_t> visualDisplayModuleIds;
+   #endif
 
     struct ScopedContext {
         CardinalPluginContext* const context;
@@ -327,6 +340,7 @@ class CardinalUI : public CardinalBaseUI,
         {
             rack::contextSet(context);
             rack::window::WindowSetMods(context->window, mods);
+            rack::window::WindowSetDirty(context->window);
             WindowParametersRestore(context->window);
         }
 
@@ -371,7 +385,7 @@ public:
             }
         } DISTRHO_SAFE_EXCEPTION("create unique temporary path");
 
-        const float sampleRate = 60; // fake audio running at 60 fps
+        const float sampleRate = 60; // not processed, lights and voltages come from DSP side
         rack::settings::sampleRate = sampleRate;
 
         context->dataIns = new const float*[DISTRHO_PLUGIN_NUM_INPUTS];
@@ -504,6 +518,13 @@ public:
         context->ui = nullptr;
 
        #if CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+        // let the DSP stop publishing visual state
+        if (visualStateRequested)
+        {
+            const uint8_t data = kCardinalVisualRequestUIClosed;
+            setState("visualRequest", String::asBase64(&data, 1));
+        }
+
         {
             const ScopedContext sc(this);
             context->patch->clear();
@@ -641,22 +662,53 @@ public:
             filebrowserhandle = nullptr;
         }
 
-       #if CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+        if (windowParameters.rateLimit != 0 && ++rateLimitStep % (windowParameters.rateLimit * 2))
+            return;
+
+        rateLimitStep = 0;
+
         {
             const ScopedContext sc(this);
-            for (uint32_t i=0; i<DISTRHO_PLUGIN_NUM_OUTPUTS;++i)
-                context->dataOuts[i][0] = 0.f;
-            ++context->processCounter;
-            context->engine->stepBlock(1);
+           #if CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+            requestVisualState();
+           #endif
+            if (! rack::window::WindowShouldRedraw(context->window))
+                return;
         }
-       #endif
 
-        if (windowParameters.rateLimit != 0 && ++rateLimitStep % (windowParameters.rateLimit * 2))
+        repaint();
+    }
+
+   #if CARDINAL_VARIANT_MINI && ! DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+    // Asks the DSP for the full visual state once, and for the state of on-screen modules that publish their own,
+    // such as meters and scopes, as modules are not processed on this side.
+    void requestVisualState()
+    {
+        std::vector<int64_t> moduleIds;
+
+        for (rack::app::ModuleWidget* const mw : context->scene->rack->getModules())
+        {
+            rack::engine::Module* const module = mw->getModule();
+            if (module == nullptr)
+                continue;
+
+            if (dynamic_cast<rack::engine::VisualStateProvider*>(module) != nullptr && rack::window::WindowIsModuleWidgetOnScreen(mw))
+                moduleIds.push_back(module->id);
+        }
+
+        if (visualStateRequested && moduleIds == visualDisplayModuleIds)
             return;
 
-        rateLimitStep = 0;
-        repaint();
+        std::vector<uint8_t> data(1 + moduleIds.size() * sizeof(int64_t));
+        data[0] = visualStateRequested ? kCardinalVisualRequestUpdate : kCardinalVisualRequestUIOpened;
+        std::memcpy(data.data() + 1, moduleIds.data(), moduleIds.size() * sizeof(int64_t));
+
+        setState("visualRequest", String::asBase64(data.data(), data.size()));
+
+        visualStateRequested = true;
+        visualDisplayModuleIds.swap(moduleIds);
     }
+   #endif
 
     void WindowParametersChanged(const WindowParameterList param, float value) override
     {
@@ -932,6 +984,15 @@ protected:
 
             return;
         }
+
+        // modules are not processed on the UI side, lights and output voltages come from the DSP
+        if (std::strcmp(key, "visual") == 0)
+        {
+            const std::vector<uint8_t> data(d_getChunkFromBase64String(value));
+
+            rack::engine::Engine_applyVisualState(context->engine, data.data(), data.size());
+            return;
+        }
        #endif
 
         if (std::strcmp(key, "windowSize") == 0)
@@ -0,0 +1,145 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <simd/dispatch.hpp>
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(CARDINAL_NOSIMD)
+# define CARDINAL_DISPATCH_AVX2
+# include <immintrin.h>
+#endif
+
+namespace rack {
+namespace simd {
+
+// --------------------------------------------------------------------------------------------------------------------
+// baseline, same code and summing order as the original scalar loops
+
+static float convolve_baseline(const float* const in, const float* const kernel, const int len)
+{
+    float y = 0.f;
+    for (int i = 0; i < len; ++i)
+        y += in[len - 1 - i] * kernel[i];
+    return y;
+}
+
+static float dot_baseline(const float* const a, const float* const b, const int len)
+{
+    float y = 0.f;
+    for (int i = 0; i < len; ++i)
+        y += a[i] * b[i];
+    return y;
+}
+
+static constexpr const Kernels kKernelsBaseline = {
+    convolve_baseline,
+    dot_baseline,
+    "baseline",
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// AVX2 + FMA, built with per-function target attributes so the rest of the binary keeps the baseline flags
+
+#ifdef CARDINAL_DISPATCH_AVX2
+# define CARDINAL_TARGET_AVX2 __attribute__((target("avx2,fma")))
+
+CARDINAL_TARGET_AVX2
+static inline float hsum_avx2(const __m256 v)
+{
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+    return _mm_cvtss_f32(sum);
+}
+
+CARDINAL_TARGET_AVX2
+static float convolve_avx2(const float* const in, const float* const kernel, const int len)
+{
+    const __m256i reverse = _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256 acc = _mm256_setzero_ps();
+    int i = 0;
+
+    for (; i + 8 <= len; i += 8)
+    {
+        const __m256 x = _mm256_permutevar8x32_ps(_mm256_loadu_ps(&in[len - 8 - i]), reverse);
+        acc = _mm256_fmadd_ps(x, _mm256_loadu_ps(&kernel[i]), acc);
+    }
+
+    float y = hsum_avx2(acc);
+    for (; i < len; ++i)
+        y += in[len - 1 - i] * kernel[i];
+    return y;
+}
+
+CARDINAL_TARGET_AVX2
+static float dot_avx2(const float* const a, const float* const b, const int len)
+{
+    __m256 acc = _mm256_setzero_ps();
+    int i = 0;
+
+    for (; i + 8 <= len; i += 8)
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i]), acc);
+
+    float y = hsum_avx2(acc);
+    for (; i < len; ++i)
+        y += a[i] * b[i];
+    return y;
+}
+
+static constexpr const Kernels kKernelsAVX2 = {
+    convolve_avx2,
+    dot_avx2,
+    "avx2+fma",
+};
+
+static bool isAVX2Supported()
+{
+    // also checks that the OS saves AVX registers
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+#endif // CARDINAL_DISPATCH_AVX2
+
+// --------------------------------------------------------------------------------------------------------------------
+
+// constant initialized, so the baseline is already in place for anything running before dynamic initialization
+Kernels kernels = kKernelsBaseline;
+
+struct SupportedKernels {
+    const Kernels* list[2];
+    int count;
+
+    SupportedKernels()
+        : list { &kKernelsBaseline, nullptr },
+          count(1)
+    {
+       #ifdef CARDINAL_DISPATCH_AVX2
+        if (isAVX2Supported())
+            list[count++] = &kKernelsAVX2;
+       #endif
+    }
+};
+
+const Kernels* const* getSupportedKernels(int* const count)
+{
+    static const SupportedKernels supported;
+
+    *count = supported.count;
+    return supported.list;
+}
+
+static struct KernelsSelector {
+    KernelsSelector()
+    {
+        int count;
+        const Kernels* const* const supported = getSupportedKernels(&count);
+        kernels = *supported[count - 1];
+    }
+} kernelsSelector;
+
+// --------------------------------------------------------------------------------------------------------------------
+
+}
+}
@@ -0,0 +1,87 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <dsp/fft.hpp>
+
+#include <map>
+#include <mutex>
+
+namespace rack {
+namespace dsp {
+
+// --------------------------------------------------------------------------------------------------------------------
+// PFFFT setups only hold twiddle factors and are never written to after creation, so a single instance per
+// size and transform type is shared by every FFT, convolver and module in the process.
+
+struct PffftSetupRegistry {
+    std::mutex mutex;
+    std::map<std::pair<int, int>, PFFFT_Setup*> setups;
+
+    ~PffftSetupRegistry()
+    {
+        for (auto& it : setups)
+            pffft_destroy_setup(it.second);
+    }
+};
+
+static PffftSetupRegistry& getPffftSetupRegistry()
+{
+    static PffftSetupRegistry registry;
+    return registry;
+}
+
+PFFFT_Setup* getSharedPffftSetup(const int length, const pffft_transform_t transform)
+{
+    PffftSetupRegistry& registry(getPffftSetupRegistry());
+    const std::lock_guard<std::mutex> lock(registry.mutex);
+
+    const std::pair<int, int> key(length, static_cast<int>(transform));
+
+    const auto it = registry.setups.find(key);
+    if (it != registry.setups.end())
+        return it->second;
+
+    PFFFT_Setup* const setup = pffft_new_setup(length, transform);
+
+    if (setup != nullptr)
+        registry.setups[key] = setup;
+
+    return setup;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+struct ThreadScratchBuffer {
+    float* data = nullptr;
+    size_t size = 0;
+
+    ~ThreadScratchBuffer()
+    {
+        if (data != nullptr)
+            pffft_aligned_free(data);
+    }
+};
+
+float* getThreadScratchBuffer(const size_t length)
+{
+    static thread_local ThreadScratchBuffer scratch;
+
+    if (scratch.size < length)
+    {
+        if (scratch.data != nullptr)
+            pffft_aligned_free(scratch.data);
+
+        scratch.data = static_cast<float*>(pffft_aligned_malloc(sizeof(float) * length));
+        scratch.size = length;
+    }
+
+    return scratch.data;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+}
+}
@@ -4,6 +4,7 @@ cd $(dirname ${0})
 
 diff -U3 ../Rack/include/midi.hpp ../../include/midi.hpp > diffs/midi.hpp.diff
 diff -U3 ../Rack/include/dsp/fir.hpp ../../include/dsp/fir.hpp > diffs/dsp-fir.hpp.diff
+diff -U3 ../Rack/include/dsp/fft.hpp ../../include/dsp/fft.hpp > diffs/dsp-fft.hpp.diff
 diff -U3 ../Rack/include/engine/Port.hpp ../../include/engine/Port.hpp > diffs/engine-Port.hpp.diff
 diff -U3 ../Rack/include/simd/Vector.hpp ../../include/simd/Vector.hpp > diffs/simd-Vector.hpp.diff
 
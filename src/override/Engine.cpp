@@ -21,11 +21,13 @@
 #include <mutex>
 #include <atomic>
 #include <tuple>
+#include <cstring>
 #include <pmmintrin.h>
 #include <unordered_map>
 
 #include <engine/Engine.hpp>
 #include <engine/TerminalModule.hpp>
+#include <engine/VisualStateProvider.hpp>
 #include <settings.hpp>
 #include <system.hpp>
 #include <random.hpp>
@@ -57,11 +59,56 @@ static constexpr const int METER_BUFFER_LEN = 32;
 static constexpr const float METER_TIME = 1.f;
 
 
+/** Ports connected by a cable, as used when stepping the engine */
+struct CableRoute {
+	const Output* output;
+	Input* input;
+};
+
+
+/** Delay a module adds to the signals going through it, and the state used to sum it along cable paths */
+struct ModuleLatency {
+	uint32_t latency = 0;
+	uint32_t outputLatency = 0;
+	enum { UNVISITED, VISITING, VISITED } visit = UNVISITED;
+	/** Modules with a cable into this one, rebuilt together with the cable routes */
+	std::vector<ModuleLatency*> inputs;
+	/** Next entry of `inputs` to visit while walking the cable paths */
+	size_t nextInput = 0;
+};
+
+
+/** Module on screen in a UI that does not process modules, whose visual state is sent to it */
+struct VisualDisplay {
+	Module* module;
+	VisualStateProvider* provider;
+};
+
+
 struct Engine::Internal {
 	std::vector<Module*> modules;
 	std::vector<TerminalModule*> terminalModules;
 	std::vector<Cable*> cables;
+
+	/** All cable routes packed in execution order, so stepping cables walks a single array.
+	Routes of each module's outputs follow the routes of the module processed before it.
+	Rebuilt by Engine_updateCableRoutes() whenever modules, cables or their order change.
+	*/
+	std::vector<CableRoute> cableRoutes;
+	/** End index in cableRoutes of the routes for each entry of `modules` */
+	std::vector<uint32_t> moduleRouteEnds;
+	/** End index in cableRoutes of the routes for each entry of `terminalModules` */
+	std::vector<uint32_t> terminalModuleRouteEnds;
 	std::set<ParamHandle*> paramHandles;
+	/** Latency of each module as set by Engine_setModuleLatency(), entries are only added and removed together with modules */
+	std::unordered_map<Module*, ModuleLatency> moduleLatencies;
+	/** Latency along the slowest path into terminal modules, recomputed when modules, cables or module latencies change */
+	uint32_t latency = 0;
+	bool latencyNeedsUpdate = false;
+	/** Path being walked by Engine_getOutputLatency(), reserved for every module so the audio thread does not allocate */
+	std::vector<ModuleLatency*> latencyStack;
+	/** Modules whose visual state is sent to the UI, see Engine_setVisualDisplayModules() */
+	std::vector<VisualDisplay> visualDisplays;
 
 	// moduleId
 	std::map<int64_t, Module*> modulesCache;
@@ -140,9 +187,9 @@ static void Engine_updateExpander_NoLock(Engine* that, Module* module, bool side
 }
 
 
-static void Cable_step(Cable* that) {
-	Output* output = &that->outputModule->outputs[that->outputId];
-	Input* input = &that->inputModule->inputs[that->inputId];
+static void CableRoute_step(const CableRoute* that) {
+	const Output* output = that->output;
+	Input* input = that->input;
 	// Match number of polyphonic channels to output port
 	const int channels = output->channels;
 	// Copy all voltages from output to input
@@ -183,14 +230,12 @@ static void Port_step(Port* that, float deltaTime) {
 #endif
 
 
-static void TerminalModule__doProcess(TerminalModule* const terminalModule, const Module::ProcessArgs& args, bool input) {
+static void TerminalModule__doProcess(TerminalModule* const terminalModule, const Module::ProcessArgs& args, bool input, const CableRoute* routes, const CableRoute* routesEnd) {
 	// Step module
 	if (input) {
 		terminalModule->processTerminalInput(args);
-		for (Output& output : terminalModule->outputs) {
-			for (Cable* cable : output.cables)
-				Cable_step(cable);
-		}
+		for (; routes != routesEnd; ++routes)
+			CableRoute_step(routes);
 	} else {
 		terminalModule->processTerminalOutput(args);
 	}
@@ -321,23 +366,28 @@ static void Engine_stepFrame(Engine* that) {
 	processArgs.sampleTime = internal->sampleTime;
 	processArgs.frame = internal->frame;
 
+	const CableRoute* const routes = internal->cableRoutes.data();
+	const CableRoute* route = routes;
+
 	// Process terminal inputs first
-	for (TerminalModule* terminalModule : internal->terminalModules) {
-		TerminalModule__doProcess(terminalModule, processArgs, true);
+	const size_t numTerminalModules = internal->terminalModules.size();
+	for (size_t i = 0; i < numTerminalModules; i++) {
+		const CableRoute* const routesEnd = routes + internal->terminalModuleRouteEnds[i];
+		TerminalModule__doProcess(internal->terminalModules[i], processArgs, true, route, routesEnd);
+		route = routesEnd;
 	}
 
 	// Step each module and cables
-	for (Module* module : internal->modules) {
-		Module__doProcess(module, processArgs);
-		for (Output& output : module->outputs) {
-			for (Cable* cable : output.cables)
-				Cable_step(cable);
-		}
+	const size_t numModules = internal->modules.size();
+	for (size_t i = 0; i < numModules; i++) {
+		Module__doProcess(internal->modules[i], processArgs);
+		for (const CableRoute* const routesEnd = routes + internal->moduleRouteEnds[i]; route != routesEnd; ++route)
+			CableRoute_step(route);
 	}
 
 	// Process terminal outputs last
 	for (TerminalModule* terminalModule : internal->terminalModules) {
-		TerminalModule__doProcess(terminalModule, processArgs, false);
+		TerminalModule__doProcess(terminalModule, processArgs, false, NULL, NULL);
 	}
 
 	++internal->frame;
@@ -406,6 +456,52 @@ static void Engine_debugOrderedModules(std::vector<Module*>& modules) {
 }
 #endif
 
+static void Engine_appendCableRoutes(Engine::Internal* internal, Module* module) {
+	for (const Output& output : module->outputs) {
+		for (Cable* cable : output.cables) {
+			CableRoute route;
+			route.output = &output;
+			route.input = &cable->inputModule->inputs[cable->inputId];
+			internal->cableRoutes.push_back(route);
+		}
+	}
+}
+
+/** Packs the routes of all cables in the order modules are processed, terminal inputs first.
+*/
+static void Engine_updateCableRoutes(Engine* that) {
+	Engine::Internal* internal = that->internal;
+
+	internal->latencyNeedsUpdate = true;
+
+	internal->cableRoutes.clear();
+	internal->cableRoutes.reserve(internal->cables.size());
+	internal->moduleRouteEnds.resize(internal->modules.size());
+	internal->terminalModuleRouteEnds.resize(internal->terminalModules.size());
+
+	for (size_t i = 0; i < internal->terminalModules.size(); i++) {
+		Engine_appendCableRoutes(internal, internal->terminalModules[i]);
+		internal->terminalModuleRouteEnds[i] = internal->cableRoutes.size();
+	}
+	for (size_t i = 0; i < internal->modules.size(); i++) {
+		Engine_appendCableRoutes(internal, internal->modules[i]);
+		internal->moduleRouteEnds[i] = internal->cableRoutes.size();
+	}
+
+	for (auto& it : internal->moduleLatencies)
+		it.second.inputs.clear();
+	for (Cable* cable : internal->cables) {
+		const auto inputIt = internal->moduleLatencies.find(cable->inputModule);
+		const auto outputIt = internal->moduleLatencies.find(cable->outputModule);
+		if (inputIt == internal->moduleLatencies.end() || outputIt == internal->moduleLatencies.end())
+			continue;
+		std::vector<ModuleLatency*>& inputs = inputIt->second.inputs;
+		if (std::find(inputs.begin(), inputs.end(), &outputIt->second) == inputs.end())
+			inputs.push_back(&outputIt->second);
+	}
+	internal->latencyStack.reserve(internal->moduleLatencies.size());
+}
+
 /** Order the modules so that they always read the most recent sample from their inputs
 */
 static void Engine_orderModules(Engine* that) {
@@ -421,6 +517,7 @@ static void Engine_orderModules(Engine* that) {
 		Engine_orderModule(module, touchedModules, orderedModules, terminalModulesIDs);
 
 	Engine_assignOrderedModules(internal->modules, orderedModules);
+	Engine_updateCableRoutes(that);
 
 #if DEBUG_ORDERED_MODULES
 	Engine_debugOrderedModules(internal->modules);
@@ -753,6 +850,8 @@ void Engine::addModule(Module* module) {
 	else
 		internal->modules.push_back(module);
 	internal->modulesCache[module->id] = module;
+	internal->moduleLatencies[module] = ModuleLatency();
+	Engine_updateCableRoutes(this);
 	// Dispatch AddEvent
 	Module::AddEvent eAdd;
 	module->onAdd(eAdd);
@@ -816,6 +915,14 @@ static void removeModule_NoLock_common(Engine::Internal* internal, Module* modul
 	module->leftExpander.module = NULL;
 	module->rightExpander.moduleId = -1;
 	module->rightExpander.module = NULL;
+	internal->moduleLatencies.erase(module);
+	// Stop sending its visual state
+	for (auto it = internal->visualDisplays.begin(); it != internal->visualDisplays.end(); ++it) {
+		if (it->module == module) {
+			internal->visualDisplays.erase(it);
+			break;
+		}
+	}
 	// Remove module
 	internal->modulesCache.erase(module->id);
 }
@@ -836,6 +943,7 @@ void Engine::removeModule_NoLock(Module* module) {
 		removeModule_NoLock_common(internal, module);
 		internal->modules.erase(it);
 	}
+	Engine_updateCableRoutes(this);
 }
 
 
@@ -1096,6 +1204,11 @@ float Engine::getParamValue(Module* module, int paramId) {
 
 
 void Engine::setParamSmoothValue(Module* module, int paramId, float value) {
+	// Remote side does all the processing, send the target value right away
+	if (internal->remoteDetails != nullptr && internal->remoteDetails->localEngineIsUIOnly) {
+		setParamValue(module, paramId, value);
+		return;
+	}
 	// If another param is being smoothed, jump value
 	if (internal->smoothModule && !(internal->smoothModule == module && internal->smoothParamId == paramId)) {
 		internal->smoothModule->params[internal->smoothParamId].setValue(internal->smoothValue);
@@ -1265,12 +1378,14 @@ void Engine::fromJson(json_t* rootJ) {
 		Module* const module = model->createModule();
 		DISTRHO_SAFE_ASSERT_CONTINUE(module != nullptr);
 
-		// Create the widget too, needed by a few modules
+		// Create the widget too, only for the few modules that need it
 		CardinalPluginModelHelper* const helper = dynamic_cast<CardinalPluginModelHelper*>(model);
 		DISTRHO_SAFE_ASSERT_CONTINUE(helper != nullptr);
 
-		app::ModuleWidget* const moduleWidget = helper->createModuleWidgetFromEngineLoad(module);
-		DISTRHO_SAFE_ASSERT_CONTINUE(moduleWidget != nullptr);
+		if (helper->needsWidgetOnEngineLoad) {
+			app::ModuleWidget* const moduleWidget = helper->createModuleWidgetFromEngineLoad(module);
+			DISTRHO_SAFE_ASSERT_CONTINUE(moduleWidget != nullptr);
+		}
 
 		try {
 			// This doesn't need a lock because the Module is not added to the Engine yet.
@@ -1341,5 +1456,315 @@ void Engine_setRemoteDetails(Engine* const engine, remoteUtils::RemoteDetails* c
 }
 
 
+void Engine_setModuleLatency(Engine* const engine, Module* const module, const uint32_t frames) {
+	Engine::Internal* const internal = engine->internal;
+
+	const auto it = internal->moduleLatencies.find(module);
+	DISTRHO_SAFE_ASSERT_RETURN(it != internal->moduleLatencies.end(),);
+
+	if (it->second.latency == frames)
+		return;
+
+	it->second.latency = frames;
+	internal->latencyNeedsUpdate = true;
+}
+
+
+/** Returns the latency of the signals leaving `moduleLatency`, that is the latency of its slowest input plus its own.
+Walks the cable paths depth first without recursion, feedback loops are only followed once.
+*/
+static uint32_t Engine_getOutputLatency(Engine::Internal* const internal, ModuleLatency* const moduleLatency) {
+	if (moduleLatency->visit != ModuleLatency::UNVISITED)
+		return moduleLatency->visit == ModuleLatency::VISITED ? moduleLatency->outputLatency : 0;
+
+	// While a module is on the stack, outputLatency holds the latency of its slowest input visited so far
+	std::vector<ModuleLatency*>& stack = internal->latencyStack;
+	stack.clear();
+
+	moduleLatency->visit = ModuleLatency::VISITING;
+	moduleLatency->nextInput = 0;
+	moduleLatency->outputLatency = 0;
+	stack.push_back(moduleLatency);
+
+	while (!stack.empty()) {
+		ModuleLatency* const current = stack.back();
+
+		if (current->nextInput < current->inputs.size()) {
+			ModuleLatency* const input = current->inputs[current->nextInput++];
+			switch (input->visit) {
+				case ModuleLatency::UNVISITED:
+					input->visit = ModuleLatency::VISITING;
+					input->nextInput = 0;
+					input->outputLatency = 0;
+					stack.push_back(input);
+					break;
+				case ModuleLatency::VISITED:
+					current->outputLatency = std::max(current->outputLatency, input->outputLatency);
+					break;
+				case ModuleLatency::VISITING:
+					// Feedback loop
+					break;
+			}
+			continue;
+		}
+
+		current->outputLatency += current->latency;
+		current->visit = ModuleLatency::VISITED;
+		stack.pop_back();
+
+		if (!stack.empty())
+			stack.back()->outputLatency = std::max(stack.back()->outputLatency, current->outputLatency);
+	}
+
+	return moduleLatency->outputLatency;
+}
+
+
+/** Returns the latency of the patch as seen by the host, the slowest path of modules in series that ends in a terminal module.
+Modules that do not reach a terminal module, and so the host outputs, are not taken into account.
+Must be called from the audio thread, in between blocks.
+*/
+uint32_t Engine_getLatency(Engine* const engine) {
+	Engine::Internal* const internal = engine->internal;
+
+	SharedLock<SharedMutex> lock(internal->mutex);
+
+	if (!internal->latencyNeedsUpdate)
+		return internal->latency;
+
+	internal->latencyNeedsUpdate = false;
+
+	for (auto& it : internal->moduleLatencies)
+		it.second.visit = ModuleLatency::UNVISITED;
+
+	uint32_t latency = 0;
+	for (TerminalModule* terminalModule : internal->terminalModules) {
+		const auto it = internal->moduleLatencies.find(terminalModule);
+		if (it != internal->moduleLatencies.end())
+			latency = std::max(latency, Engine_getOutputLatency(internal, &it->second));
+	}
+
+	internal->latency = latency;
+	return latency;
+}
+
+
+// Visual state blob, as published by the DSP side for UIs that do not process modules themselves.
+// A sequence of records, each starting with a uint8 record type:
+// - VISUAL_RECORD_MODULE: int64 id, uint16 light count, uint16 output count, float brightness per light,
+//   then for each output: uint8 channel count followed by one float voltage per channel.
+//   Only sent for modules that changed since the previous blob.
+// - VISUAL_RECORD_PROVIDER: int64 id, uint32 size, then the data from VisualStateProvider::getVisualState().
+//   Only sent for modules the UI asked for with Engine_setVisualDisplayModules(), and when they have new data.
+enum VisualRecordType : uint8_t {
+	VISUAL_RECORD_MODULE,
+	VISUAL_RECORD_PROVIDER,
+};
+
+
+template <typename T>
+static void Engine_appendVisualValue(std::vector<uint8_t>& data, const T value) {
+	const uint8_t* const bytes = reinterpret_cast<const uint8_t*>(&value);
+	data.insert(data.end(), bytes, bytes + sizeof(T));
+}
+
+
+static void Engine_collectModuleVisualState(Module* const module, std::unordered_map<int64_t, std::vector<uint8_t>>& lastStates, std::vector<uint8_t>& data) {
+	const uint16_t numLights = std::min<size_t>(module->lights.size(), UINT16_MAX);
+	const uint16_t numOutputs = std::min<size_t>(module->outputs.size(), UINT16_MAX);
+
+	if (numLights == 0 && numOutputs == 0)
+		return;
+
+	const size_t start = data.size();
+
+	Engine_appendVisualValue<uint8_t>(data, VISUAL_RECORD_MODULE);
+	Engine_appendVisualValue<int64_t>(data, module->id);
+	Engine_appendVisualValue<uint16_t>(data, numLights);
+	Engine_appendVisualValue<uint16_t>(data, numOutputs);
+
+	for (uint16_t i = 0; i < numLights; i++)
+		Engine_appendVisualValue<float>(data, module->lights[i].value);
+
+	for (uint16_t i = 0; i < numOutputs; i++) {
+		const Output& output = module->outputs[i];
+		const uint8_t channels = output.getChannels();
+		Engine_appendVisualValue<uint8_t>(data, channels);
+		for (uint8_t c = 0; c < channels; c++)
+			Engine_appendVisualValue<float>(data, output.voltages[c]);
+	}
+
+	// Drop the record again if the UI already has it
+	std::vector<uint8_t>& lastState = lastStates[module->id];
+	if (lastState.size() == data.size() - start && std::equal(lastState.begin(), lastState.end(), data.begin() + start)) {
+		data.resize(start);
+		return;
+	}
+	lastState.assign(data.begin() + start, data.end());
+}
+
+
+static void Engine_collectProviderVisualState(const VisualDisplay& display, std::vector<uint8_t>& data) {
+	const size_t start = data.size();
+
+	Engine_appendVisualValue<uint8_t>(data, VISUAL_RECORD_PROVIDER);
+	Engine_appendVisualValue<int64_t>(data, display.module->id);
+	Engine_appendVisualValue<uint32_t>(data, 0);
+
+	const size_t dataStart = data.size();
+	display.provider->getVisualState(data);
+
+	// Drop the record again if there is nothing new
+	if (data.size() == dataStart) {
+		data.resize(start);
+		return;
+	}
+
+	const uint32_t size = data.size() - dataStart;
+	std::memcpy(&data[dataStart - sizeof(uint32_t)], &size, sizeof(uint32_t));
+}
+
+
+void Engine_collectVisualState(Engine* const engine, std::unordered_map<int64_t, std::vector<uint8_t>>& lastStates, std::vector<uint8_t>& data) {
+	Engine::Internal* const internal = engine->internal;
+
+	data.clear();
+
+	SharedLock<SharedMutex> lock(internal->mutex);
+
+	for (Module* module : internal->modules)
+		Engine_collectModuleVisualState(module, lastStates, data);
+	for (TerminalModule* terminalModule : internal->terminalModules)
+		Engine_collectModuleVisualState(terminalModule, lastStates, data);
+	for (const VisualDisplay& display : internal->visualDisplays)
+		Engine_collectProviderVisualState(display, data);
+
+	// Forget removed modules
+	for (auto it = lastStates.begin(); it != lastStates.end();) {
+		if (internal->modulesCache.find(it->first) == internal->modulesCache.end())
+			it = lastStates.erase(it);
+		else
+			++it;
+	}
+}
+
+
+void Engine_setVisualDisplayModules(Engine* const engine, const std::vector<int64_t>& moduleIds) {
+	Engine::Internal* const internal = engine->internal;
+
+	std::lock_guard<SharedMutex> lock(internal->mutex);
+
+	std::vector<VisualDisplay> displays;
+
+	for (const int64_t moduleId : moduleIds) {
+		const auto it = internal->modulesCache.find(moduleId);
+		if (it == internal->modulesCache.end())
+			continue;
+
+		VisualStateProvider* const provider = dynamic_cast<VisualStateProvider*>(it->second);
+		if (provider != nullptr)
+			displays.push_back({it->second, provider});
+	}
+
+	internal->visualDisplays.swap(displays);
+}
+
+
+template <typename T>
+static bool Engine_readVisualValue(const uint8_t*& data, const uint8_t* const end, T& value) {
+	if (data + sizeof(T) > end)
+		return false;
+	std::memcpy(&value, data, sizeof(T));
+	data += sizeof(T);
+	return true;
+}
+
+
+static Module* Engine_findVisualModule(Engine::Internal* const internal, const int64_t moduleId) {
+	// modules not (yet) known on this side are skipped over
+	const auto it = internal->modulesCache.find(moduleId);
+	return it != internal->modulesCache.end() ? it->second : nullptr;
+}
+
+
+static bool Engine_applyModuleVisualState(Engine::Internal* const internal, const uint8_t*& data, const uint8_t* const end) {
+	int64_t moduleId;
+	uint16_t numLights, numOutputs;
+	uint8_t channels;
+	float value;
+
+	if (!Engine_readVisualValue(data, end, moduleId) || !Engine_readVisualValue(data, end, numLights) || !Engine_readVisualValue(data, end, numOutputs))
+		return false;
+
+	Module* const module = Engine_findVisualModule(internal, moduleId);
+
+	for (uint16_t i = 0; i < numLights; i++) {
+		if (!Engine_readVisualValue(data, end, value))
+			return false;
+		if (module != nullptr && i < module->lights.size())
+			module->lights[i].value = value;
+	}
+
+	for (uint16_t i = 0; i < numOutputs; i++) {
+		if (!Engine_readVisualValue(data, end, channels))
+			return false;
+		Output* const output = module != nullptr && i < module->outputs.size() ? &module->outputs[i] : nullptr;
+		if (output != nullptr)
+			output->setChannels(channels);
+		for (uint8_t c = 0; c < channels; c++) {
+			if (!Engine_readVisualValue(data, end, value))
+				return false;
+			if (output != nullptr && c < PORT_MAX_CHANNELS)
+				output->voltages[c] = value;
+		}
+	}
+
+	return true;
+}
+
+
+static bool Engine_applyProviderVisualState(Engine::Internal* const internal, const uint8_t*& data, const uint8_t* const end) {
+	int64_t moduleId;
+	uint32_t size;
+
+	if (!Engine_readVisualValue(data, end, moduleId) || !Engine_readVisualValue(data, end, size))
+		return false;
+	if (size > static_cast<size_t>(end - data))
+		return false;
+
+	Module* const module = Engine_findVisualModule(internal, moduleId);
+
+	if (VisualStateProvider* const provider = dynamic_cast<VisualStateProvider*>(module))
+		provider->setVisualState(data, size);
+
+	data += size;
+	return true;
+}
+
+
+void Engine_applyVisualState(Engine* const engine, const uint8_t* data, const size_t size) {
+	const uint8_t* const end = data + size;
+
+	SharedLock<SharedMutex> lock(engine->internal->mutex);
+
+	uint8_t type;
+
+	while (Engine_readVisualValue(data, end, type)) {
+		switch (type) {
+			case VISUAL_RECORD_MODULE:
+				if (!Engine_applyModuleVisualState(engine->internal, data, end))
+					return;
+				break;
+			case VISUAL_RECORD_PROVIDER:
+				if (!Engine_applyProviderVisualState(engine->internal, data, end))
+					return;
+				break;
+			default:
+				return;
+		}
+	}
+}
+
+
 } // namespace engine
 } // namespace rack
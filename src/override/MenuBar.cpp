@@ -868,26 +868,11 @@ struct HelpButton : MenuButton {
 
 
 struct InfoLabel : ui::Label {
-	int frameCount = 0;
-	double frameDurationTotal = 0.0;
-	double frameDurationAvg = NAN;
 	// double uiLastTime = 0.0;
 	// double uiLastThreadTime = 0.0;
 	// double uiFrac = 0.0;
 
 	void step() override {
-		// Compute frame rate
-		double frameDuration = APP->window->getLastFrameDuration();
-		if (std::isfinite(frameDuration)) {
-			frameDurationTotal += frameDuration;
-			frameCount++;
-		}
-		if (frameDurationTotal >= 1.0) {
-			frameDurationAvg = frameDurationTotal / frameCount;
-			frameDurationTotal = 0.0;
-			frameCount = 0;
-		}
-
 		// Compute UI thread CPU
 		// double time = system::getTime();
 		// double uiDuration = time - uiLastTime;
@@ -901,13 +886,15 @@ struct InfoLabel : ui::Label {
 		text = "";
 
 		if (box.size.x >= 400) {
-			double fps = std::isfinite(frameDurationAvg) ? 1.0 / frameDurationAvg : 0.0;
+			double idleRate, drawRate;
+			window::getFrameRates(idleRate, drawRate);
 #if DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
 			double meterAverage = APP->engine->getMeterAverage();
 			double meterMax = APP->engine->getMeterMax();
-			text = string::f("%.1f fps  %.1f%% avg  %.1f%% max", fps, meterAverage * 100, meterMax * 100);
+			text = string::f("%.1f fps  %.1f drawn  %.1f%% avg  %.1f%% max",
+			                 idleRate, drawRate, meterAverage * 100, meterMax * 100);
 #else
-			text = string::f("%.1f fps", fps);
+			text = string::f("%.1f fps  %.1f drawn", idleRate, drawRate);
 #endif
 			text += "     ";
 		}
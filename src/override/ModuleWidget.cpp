@@ -29,13 +29,22 @@
 
 #include <thread>
 #include <regex>
+#include <typeinfo>
 
 #include <app/ModuleWidget.hpp>
 #include <app/Scene.hpp>
 #include <engine/Engine.hpp>
 #include <plugin/Plugin.hpp>
 #include <app/SvgPanel.hpp>
+#include <app/SvgScrew.hpp>
+#include <app/LightWidget.hpp>
+#include <ui/Label.hpp>
 #include <ui/MenuSeparator.hpp>
+#include <widget/FramebufferWidget.hpp>
+#include <widget/OpaqueWidget.hpp>
+#include <widget/SvgWidget.hpp>
+#include <widget/TransformWidget.hpp>
+#include <widget/TransparentWidget.hpp>
 #include <system.hpp>
 #include <asset.hpp>
 #include <helpers.hpp>
@@ -64,6 +73,12 @@ struct ModuleWidget::Internal {
 	bool dragEnabled = true;
 
 	widget::Widget* panel = NULL;
+
+	/** Cached result of ModuleWidget_hasCustomDisplay(), computed again when the number of children changes.
+	-1 while unknown.
+	*/
+	int hasCustomDisplay = -1;
+	size_t numChildrenChecked = 0;
 };
 
 
@@ -1164,5 +1179,58 @@ engine::Module* ModuleWidget::releaseModule() {
 }
 
 
+// Returns true if `widget` draws nothing but parameters, lights, ports, labels and static artwork.
+// Anything else, like a custom display, may draw from module internals.
+static bool ModuleWidget__drawsOnlyKnownState(widget::Widget* const widget) {
+	if (dynamic_cast<ParamWidget*>(widget) != nullptr
+		|| dynamic_cast<PortWidget*>(widget) != nullptr
+		|| dynamic_cast<LightWidget*>(widget) != nullptr
+		|| dynamic_cast<SvgPanel*>(widget) != nullptr
+		|| dynamic_cast<SvgScrew*>(widget) != nullptr
+		|| dynamic_cast<ui::Label*>(widget) != nullptr)
+		return true;
+
+	// Plain containers, only as good as their children.
+	// Subclasses of the base widget types draw on their own, so those are matched exactly.
+	const std::type_info& type = typeid(*widget);
+	if (type != typeid(widget::Widget)
+		&& type != typeid(widget::OpaqueWidget)
+		&& type != typeid(widget::TransparentWidget)
+		&& dynamic_cast<widget::SvgWidget*>(widget) == nullptr
+		&& dynamic_cast<widget::FramebufferWidget*>(widget) == nullptr
+		&& dynamic_cast<widget::TransformWidget*>(widget) == nullptr)
+		return false;
+
+	for (widget::Widget* const child : widget->children) {
+		if (!ModuleWidget__drawsOnlyKnownState(child))
+			return false;
+	}
+	return true;
+}
+
+
+/** Returns true if `mw` has a custom display, which may draw from module internals and cannot be tracked for changes.
+The widget tree is only walked again when the number of direct children changes.
+*/
+bool ModuleWidget_hasCustomDisplay(ModuleWidget* const mw) {
+	ModuleWidget::Internal* const internal = mw->internal;
+
+	if (internal->hasCustomDisplay >= 0 && internal->numChildrenChecked == mw->children.size())
+		return internal->hasCustomDisplay != 0;
+
+	bool hasCustomDisplay = false;
+	for (widget::Widget* const child : mw->children) {
+		if (!ModuleWidget__drawsOnlyKnownState(child)) {
+			hasCustomDisplay = true;
+			break;
+		}
+	}
+
+	internal->hasCustomDisplay = hasCustomDisplay ? 1 : 0;
+	internal->numChildrenChecked = mw->children.size();
+	return hasCustomDisplay;
+}
+
+
 } // namespace app
 } // namespace rack
@@ -26,6 +26,7 @@
 #include <settings.hpp>
 #include <patch.hpp>
 #include <asset.hpp>
+#include <helpers.hpp>
 
 #ifdef NDEBUG
 # undef DEBUG
@@ -148,6 +149,9 @@ math::Vec Scene::getMousePos() {
 
 
 void Scene::step() {
+	// Create module widgets that were deferred while no UI was attached
+	realizeDeferredModuleWidgets();
+
 	if (APP->window->isFullScreen()) {
 		// Expand RackScrollWidget to cover entire screen if fullscreen
 		rackScroll->box.pos.y = 0;
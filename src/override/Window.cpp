@@ -14,6 +14,7 @@
  * the License, or (at your option) any later version.
  */
 
+#include <atomic>
 #include <map>
 #include <queue>
 #include <thread>
@@ -21,8 +22,11 @@
 #include <window/Window.hpp>
 #include <asset.hpp>
 #include <widget/Widget.hpp>
+#include <app/ModuleWidget.hpp>
+#include <app/RackWidget.hpp>
 #include <app/Scene.hpp>
 #include <context.hpp>
+#include <history.hpp>
 #include <patch.hpp>
 #include <settings.hpp>
 #include <system.hpp>
@@ -56,6 +60,11 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
+// read back pixels asynchronously through a pixel buffer object, where available
+#if defined(DISTRHO_OS_MAC) || (defined(GL_PIXEL_PACK_BUFFER) && defined(GL_GLEXT_PROTOTYPES) && !defined(DISTRHO_OS_WINDOWS))
+# define CARDINAL_WINDOW_SCREENSHOT_PBO
+#endif
+
 #endif
 
 #ifdef DISTRHO_OS_WASM
@@ -63,11 +72,21 @@
 #endif
 
 namespace rack {
+namespace app {
+bool ModuleWidget_hasCustomDisplay(ModuleWidget* mw);
+}
 namespace window {
 
 
 static const math::Vec WINDOW_SIZE_MIN = math::Vec(648, 538);
 
+// Frame rate used when only lights, meters and other visual module state change
+static constexpr const double FRAME_RATE_VISUAL_ONLY = 30.0;
+// Frame rate used when nothing at all changes, just to keep clocks and text cursors alive
+static constexpr const double FRAME_RATE_STATIC = 1.0;
+// How long after the last input event to keep drawing at full rate, for hover and tooltip changes
+static constexpr const double INPUT_ACTIVITY_TIMEOUT = 1.0;
+
 
 struct FontWithOriginalContext : Font {
 	int ohandle = -1;
@@ -134,7 +153,26 @@ enum ScreenshotStep {
 	kScreenshotStepStarted,
 	kScreenshotStepFirstPass,
 	kScreenshotStepSecondPass,
-	kScreenshotStepSaving
+	kScreenshotStepSaving,
+	kScreenshotStepReading,
+	kScreenshotStepEncoding
+};
+
+/** Screenshot pixels being flipped, downscaled and encoded on a worker thread. */
+struct ScreenshotJob {
+	uint8_t* pixels = nullptr;
+	int width = 0;
+	int height = 0;
+	int depth = 0;
+	int offsetY = 0;
+	std::vector<uint8_t> png;
+	char* base64 = nullptr;
+	std::atomic<bool> done = {false};
+
+	~ScreenshotJob() {
+		delete[] pixels;
+		std::free(base64);
+	}
 };
 #endif
 
@@ -163,6 +201,12 @@ struct Window::Internal {
 	int frame = 0;
 #ifdef CARDINAL_WINDOW_CAN_GENERATE_SCREENSHOTS
 	int generateScreenshotStep = kScreenshotStepNone;
+	ScreenshotJob* screenshotJob = nullptr;
+	std::thread screenshotThread;
+#ifdef CARDINAL_WINDOW_SCREENSHOT_PBO
+	GLuint screenshotPBO = 0;
+	ScreenshotJob* screenshotPendingJob = nullptr;
+#endif
 #endif
 	double monitorRefreshRate = 60.0;
 	double frameTime = NAN;
@@ -174,6 +218,21 @@ struct Window::Internal {
 	bool fbDirtyOnSubpixelChange = true;
 	int fbCount = 0;
 
+	// adaptive frame scheduling
+	bool dirty = true;
+	double lastInputTime = 0.0;
+	double lastDrawTime = 0.0;
+	int lastHistoryIndex = -1;
+	uint32_t lastParamsHash = 0;
+	uint32_t lastVisualHash = 0;
+
+	// scheduled vs drawn frame rates, averaged every second
+	int idleCount = 0;
+	int drawCount = 0;
+	double rateTime = 0.0;
+	double idleRate = 0.0;
+	double drawRate = 0.0;
+
 	Internal()
 #if DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
 		: hiddenApp(false),
@@ -478,6 +537,112 @@ void WindowSetMods(Window* const window, const int mods)
 	window->internal->mods = mods;
 }
 
+void WindowSetDirty(Window* const window)
+{
+	window->internal->dirty = true;
+	window->internal->lastInputTime = system::getTime();
+}
+
+static inline uint32_t Window__hashValue(uint32_t hash, const float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return (hash ^ bits) * 16777619u;
+}
+
+static inline uint32_t Window__hashValue(uint32_t hash, const uint32_t value)
+{
+	return (hash ^ value) * 16777619u;
+}
+
+// Returns true if any part of `mw` is on screen
+bool WindowIsModuleWidgetOnScreen(app::ModuleWidget* const mw)
+{
+	if (!mw->isVisible())
+		return false;
+
+	const math::Rect screenBox(mw->getAbsoluteOffset(math::Vec()), mw->box.size.mult(mw->getAbsoluteZoom()));
+	return screenBox.intersects(APP->scene->box.zeroPos());
+}
+
+bool WindowShouldRedraw(Window* const window)
+{
+	Window::Internal* const internal = window->internal;
+
+	const double time = system::getTime();
+
+	++internal->idleCount;
+	if (time - internal->rateTime >= 1.0) {
+		const double elapsed = time - internal->rateTime;
+		internal->idleRate = internal->idleCount / elapsed;
+		internal->drawRate = internal->drawCount / elapsed;
+		internal->idleCount = internal->drawCount = 0;
+		internal->rateTime = time;
+	}
+
+	if (APP->scene == nullptr)
+		return true;
+
+	bool fullRedraw = internal->dirty || time - internal->lastInputTime < INPUT_ACTIVITY_TIMEOUT;
+
+#ifdef CARDINAL_WINDOW_CAN_GENERATE_SCREENSHOTS
+	if (internal->generateScreenshotStep != kScreenshotStepNone)
+		fullRedraw = true;
+#endif
+
+	if (internal->lastHistoryIndex != APP->history->actionIndex) {
+		internal->lastHistoryIndex = APP->history->actionIndex;
+		fullRedraw = true;
+	}
+
+	// Hash what module widgets show, parameters (possibly automated by the host) go at full rate,
+	// everything else (lights, meters, port voltages) is capped to a lower rate
+	uint32_t paramsHash = 2166136261u;
+	uint32_t visualHash = 2166136261u;
+
+	for (app::ModuleWidget* const mw : APP->scene->rack->getModules()) {
+		engine::Module* const module = mw->getModule();
+		paramsHash = Window__hashValue(paramsHash, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(mw)));
+
+		if (module == nullptr)
+			continue;
+
+		// Custom displays cannot be tracked, keep full rate while one is on screen
+		if (!fullRedraw && app::ModuleWidget_hasCustomDisplay(mw) && WindowIsModuleWidgetOnScreen(mw))
+			fullRedraw = true;
+
+		for (engine::Param& param : module->params)
+			paramsHash = Window__hashValue(paramsHash, param.getValue());
+
+		for (engine::Light& light : module->lights)
+			visualHash = Window__hashValue(visualHash, static_cast<uint32_t>(light.getBrightness() * 255.f));
+
+		for (engine::Output& output : module->outputs) {
+			const int channels = output.getChannels();
+			visualHash = Window__hashValue(visualHash, static_cast<uint32_t>(channels));
+			for (int c = 0; c < channels; ++c)
+				visualHash = Window__hashValue(visualHash, output.getVoltage(c));
+		}
+	}
+
+	if (internal->lastParamsHash != paramsHash) {
+		internal->lastParamsHash = paramsHash;
+		fullRedraw = true;
+	}
+
+	double minFrameDuration = 1.0 / FRAME_RATE_STATIC;
+
+	if (internal->lastVisualHash != visualHash) {
+		internal->lastVisualHash = visualHash;
+		minFrameDuration = 1.0 / FRAME_RATE_VISUAL_ONLY;
+	}
+
+	if (fullRedraw)
+		return true;
+
+	return time - internal->lastDrawTime >= minFrameDuration;
+}
+
 Window::~Window() {
 	{
 #if DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
@@ -486,6 +651,17 @@ Window::~Window() {
 		internal->hiddenApp.idle();
 #endif
 
+#ifdef CARDINAL_WINDOW_CAN_GENERATE_SCREENSHOTS
+		if (internal->screenshotThread.joinable())
+			internal->screenshotThread.join();
+		delete internal->screenshotJob;
+#ifdef CARDINAL_WINDOW_SCREENSHOT_PBO
+		if (internal->screenshotPBO != 0)
+			glDeleteBuffers(1, &internal->screenshotPBO);
+		delete internal->screenshotPendingJob;
+#endif
+#endif
+
 		// Fonts and Images in the cache must be deleted before the NanoVG context is deleted
 		internal->fontCache.clear();
 		internal->imageCache.clear();
@@ -530,6 +706,7 @@ void Window::setSize(math::Vec size) {
 void WindowSetInternalSize(rack::window::Window* const window, math::Vec size) {
 	size = size.max(WINDOW_SIZE_MIN);
 	window->internal->size = size;
+	window->internal->dirty = true;
 }
 
 
@@ -583,17 +760,66 @@ static void Window__downscaleBitmap(uint8_t* pixels, int& width, int& height) {
 }
 
 static void Window__writeImagePNG(void* context, void* data, int size) {
+	ScreenshotJob* const job = static_cast<ScreenshotJob*>(context);
+	const uint8_t* const bytes = static_cast<const uint8_t*>(data);
+	job->png.insert(job->png.end(), bytes, bytes + size);
+}
+#endif
+
+
+// runs on the screenshot worker thread
+static void Window__encodeScreenshot(ScreenshotJob* const job) {
+	// Write pixels to PNG
+	Window__flipBitmap(job->pixels, job->width, job->height, job->depth);
+	int width = job->width;
+	int height = job->height - job->offsetY;
+	const int stride = width * job->depth;
+	uint8_t* const pixelsWithOffset = job->pixels + (stride * job->offsetY);
+#ifdef STBI_WRITE_NO_STDIO
 	USE_NAMESPACE_DISTRHO
-	CardinalBaseUI* const ui = static_cast<CardinalBaseUI*>(context);
-	if (char* const screenshot = String::asBase64(data, size).getAndReleaseBuffer()) {
-		ui->setState("screenshot", screenshot);
-		if (ui->remoteDetails != nullptr && ui->remoteDetails->connected && ui->remoteDetails->screenshot)
-			remoteUtils::sendScreenshotToRemote(ui->remoteDetails, screenshot);
-		std::free(screenshot);
+	Window__downscaleBitmap(pixelsWithOffset, width, height);
+	stbi_write_png_to_func(Window__writeImagePNG, job,
+	                       width, height, job->depth, pixelsWithOffset, stride);
+	if (!job->png.empty())
+		job->base64 = String::asBase64(job->png.data(), job->png.size()).getAndReleaseBuffer();
+#else
+	stbi_write_png("screenshot.png", width, height, job->depth, pixelsWithOffset, stride);
+#endif
+	job->done = true;
+}
+
+
+// hands the captured pixels over to the worker thread
+static void Window__startScreenshotJob(Window::Internal* const internal, ScreenshotJob* const job) {
+	if (internal->screenshotThread.joinable())
+		internal->screenshotThread.join();
+	delete internal->screenshotJob;
+
+	internal->screenshotJob = job;
+	internal->screenshotThread = std::thread(Window__encodeScreenshot, job);
+	internal->generateScreenshotStep = kScreenshotStepEncoding;
+}
+
+
+// called on the UI thread once the worker is done
+static void Window__finishScreenshotJob(Window::Internal* const internal) {
+	internal->screenshotThread.join();
+
+	ScreenshotJob* const job = internal->screenshotJob;
+	internal->screenshotJob = nullptr;
+	internal->generateScreenshotStep = kScreenshotStepNone;
+
+	if (CardinalBaseUI* const ui = internal->ui) {
+		if (job->base64 != nullptr) {
+			ui->setState("screenshot", job->base64);
+			if (ui->remoteDetails != nullptr && ui->remoteDetails->connected && ui->remoteDetails->screenshot)
+				remoteUtils::sendScreenshotToRemote(ui->remoteDetails, job->base64);
+		}
 	}
+
+	delete job;
 }
 #endif
-#endif
 
 
 void Window::step() {
@@ -606,6 +832,9 @@ void Window::step() {
 	}
 	internal->frameTime = frameTime;
 	internal->fbCount = 0;
+	internal->dirty = false;
+	internal->lastDrawTime = frameTime;
+	++internal->drawCount;
 	// double t1 = 0.0, t2 = 0.0, t3 = 0.0, t4 = 0.0, t5 = 0.0;
 
 	// Make event handlers and step() have a clean NanoVG context
@@ -637,6 +866,7 @@ void Window::step() {
 	float newPixelRatio = internal->tlw->getScaleFactor();
 	if (newPixelRatio != pixelRatio) {
 		pixelRatio = newPixelRatio;
+		internal->dirty = true;
 		APP->event->handleDirty();
 	}
 
@@ -704,8 +934,42 @@ void Window::step() {
 	++internal->frame;
 
 #ifdef CARDINAL_WINDOW_CAN_GENERATE_SCREENSHOTS
-	if (internal->generateScreenshotStep != kScreenshotStepNone) {
-		++internal->generateScreenshotStep;
+	switch (internal->generateScreenshotStep) {
+	case kScreenshotStepNone:
+		break;
+
+	case kScreenshotStepEncoding:
+		// Deliver the result once the worker thread is done, without blocking the UI
+		if (internal->screenshotJob->done)
+			Window__finishScreenshotJob(internal);
+		break;
+
+#ifdef CARDINAL_WINDOW_SCREENSHOT_PBO
+	case kScreenshotStepReading: {
+		// Pixels requested on the previous frame should be ready by now
+		ScreenshotJob* const job = internal->screenshotPendingJob;
+		internal->screenshotPendingJob = nullptr;
+		job->pixels = new uint8_t[job->height * job->width * 4];
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, internal->screenshotPBO);
+		if (const void* const data = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY)) {
+			std::memcpy(job->pixels, data, job->height * job->width * job->depth);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			Window__startScreenshotJob(internal, job);
+		}
+		else {
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			internal->generateScreenshotStep = kScreenshotStepNone;
+			delete job;
+		}
+		break;
+	}
+#endif
+
+	default:
+		if (++internal->generateScreenshotStep != kScreenshotStepSaving)
+			break;
 
 		int y = 0;
 #ifdef CARDINAL_TRANSPARENT_SCREENSHOTS
@@ -715,36 +979,44 @@ void Window::step() {
 		constexpr const int depth = 3;
 #endif
 
-		// Allocate pixel color buffer
-		uint8_t* const pixels = new uint8_t[winHeight * winWidth * 4];
-
 		// glReadPixels defaults to GL_BACK, but the back-buffer is unstable, so use the front buffer (what the user sees)
 		glReadBuffer(GL_FRONT);
-		glReadPixels(0, 0, winWidth, winHeight, depth == 3 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 
-		if (internal->generateScreenshotStep == kScreenshotStepSaving)
-		{
-			// Write pixels to PNG
-			Window__flipBitmap(pixels, winWidth, winHeight, depth);
-			winHeight -= y;
-			const int stride = winWidth * depth;
-			uint8_t* const pixelsWithOffset = pixels + (stride * y);
-#ifdef STBI_WRITE_NO_STDIO
-			Window__downscaleBitmap(pixelsWithOffset, winWidth, winHeight);
-			stbi_write_png_to_func(Window__writeImagePNG, internal->ui,
-			                       winWidth, winHeight, depth, pixelsWithOffset, stride);
+#ifdef CARDINAL_WINDOW_SCREENSHOT_PBO
+		// Read into a pixel buffer object, mapped on the next frame so the GPU transfer does not stall us
+		if (internal->screenshotPBO == 0)
+			glGenBuffers(1, &internal->screenshotPBO);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, internal->screenshotPBO);
+		glBufferData(GL_PIXEL_PACK_BUFFER, winHeight * winWidth * 4, nullptr, GL_STREAM_READ);
+		glReadPixels(0, 0, winWidth, winHeight, depth == 3 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		delete internal->screenshotPendingJob;
+		internal->screenshotPendingJob = new ScreenshotJob;
+		internal->screenshotPendingJob->width = winWidth;
+		internal->screenshotPendingJob->height = winHeight;
+		internal->screenshotPendingJob->depth = depth;
+		internal->screenshotPendingJob->offsetY = y;
+		internal->generateScreenshotStep = kScreenshotStepReading;
 #else
-			stbi_write_png("screenshot.png", winWidth, winHeight, depth, pixelsWithOffset, stride);
+		{
+			ScreenshotJob* const job = new ScreenshotJob;
+			job->width = winWidth;
+			job->height = winHeight;
+			job->depth = depth;
+			job->offsetY = y;
+			job->pixels = new uint8_t[winHeight * winWidth * 4];
+			glReadPixels(0, 0, winWidth, winHeight, depth == 3 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, job->pixels);
+			Window__startScreenshotJob(internal, job);
+		}
 #endif
 
-			internal->generateScreenshotStep = kScreenshotStepNone;
 #ifdef CARDINAL_TRANSPARENT_SCREENSHOTS
-			APP->scene->menuBar->show();
-			APP->scene->rack->children.front()->show();
+		APP->scene->menuBar->show();
+		APP->scene->rack->children.front()->show();
 #endif
-		}
-
-		delete[] pixels;
+		break;
 	}
 #endif
 }
@@ -910,6 +1182,12 @@ void generateScreenshot() {
 }
 
 
+void getFrameRates(double& idleRate, double& drawRate) {
+	idleRate = APP->window->internal->idleRate;
+	drawRate = APP->window->internal->drawRate;
+}
+
+
 void init() {
 }
 
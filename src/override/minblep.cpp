@@ -1,6 +1,6 @@
 /*
  * DISTRHO Cardinal Plugin
- * Copyright (C) 2021-2023 Filipe Coelho <falktx@falktx.com>
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -26,18 +26,26 @@
  */
 
 #include <dsp/minblep.hpp>
+#include <dsp/minblamp.hpp>
 #include <dsp/fft.hpp>
 #include <dsp/window.hpp>
 
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
 
 namespace rack {
 namespace dsp {
 
 
-void minBlepImpulse(int z, int o, float* output) {
+static void computeMinBlepImpulse(int z, int o, float* output) {
 	// Symmetric sinc array with `z` zero-crossings on each side
 	int n = 2 * z * o;
-	float* x = (float*) pffft_aligned_malloc(sizeof(float) * n);
+	// Both buffers come from the per-thread scratch arena, `x` first and `fx` right after it, kept 16-byte aligned
+	int xSize = (n + 3) & ~3;
+	float* x = getThreadScratchBuffer(xSize + 2 * n);
 	for (int i = 0; i < n; i++) {
 		float p = math::rescale((float) i, 0.f, (float)(n - 1), (float) - z, (float) z);
 		x[i] = sinc(p);
@@ -47,7 +55,7 @@ void minBlepImpulse(int z, int o, float* output) {
 	blackmanHarrisWindow(x, n);
 
 	// Real cepstrum
-	float* fx = (float*) pffft_aligned_malloc(sizeof(float) * 2 * n);
+	float* fx = x + xSize;
 	// Valgrind complains that the array is uninitialized for some reason, unless we clear it.
 	std::memset(fx, 0, sizeof(float) * 2 * n);
 	RealFFT rfft(n);
@@ -100,10 +108,86 @@ void minBlepImpulse(int z, int o, float* output) {
 	}
 
 	std::memcpy(output, x, n * sizeof(float));
+}
+
+
+static void computeMinBlampImpulse(int z, int o, float* output) {
+	int n = 2 * z * o;
+	minBlepImpulse(z, o, output);
+
+	// Integrate the minBLEP into a band-limited ramp, in samples, with the trapezoidal rule
+	float rampEnd = 0.f;
+	for (int i = 1; i < n; i++) {
+		rampEnd += (output[i - 1] + output[i]) / (2 * o);
+	}
+
+	// The minimum-phase ramp lags the ideal ramp by `delay` samples.
+	// Adding a band-limited step of that size keeps the result band-limited and lets the residual settle to 0.
+	float delay = (float)(n - 1) / o - rampEnd;
+
+	float ramp = 0.f;
+	float prevStep = 0.f;
+	for (int i = 0; i < n; i++) {
+		float step = output[i];
+		if (i > 0)
+			ramp += (prevStep + step) / (2 * o);
+		output[i] = ramp - (float) i / o + delay * step;
+		prevStep = step;
+	}
+}
+
+
+/** Impulses are only computed once per process for each configuration */
+static void getCachedImpulse(int kind, int z, int o, void (*compute)(int, int, float*), float* output) {
+	static std::mutex mutex;
+	static std::map<std::tuple<int, int, int>, std::vector<float>> impulses;
+
+	int n = 2 * z * o;
+	std::tuple<int, int, int> key(kind, z, o);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = impulses.find(key);
+		if (it != impulses.end()) {
+			std::memcpy(output, it->second.data(), n * sizeof(float));
+			return;
+		}
+	}
+
+	// Computed without holding the lock, as the minBLAMP needs the minBLEP
+	compute(z, o, output);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	impulses.emplace(key, std::vector<float>(output, output + n));
+}
+
+
+/** Configurations used by most oscillators, tabulated together the first time any minBLEP is needed.
+They are computed with the same float code as any other configuration, as the result depends on rounding
+and existing patches must keep rendering the same.
+*/
+static const int kCommonMinBlepConfigs[][2] = {
+	{16, 16},
+	{16, 32},
+};
+
+
+void minBlepImpulse(int z, int o, float* output) {
+	static const bool commonTabulated = []() {
+		for (const auto& config : kCommonMinBlepConfigs) {
+			std::vector<float> impulse(2 * config[0] * config[1]);
+			getCachedImpulse(0, config[0], config[1], computeMinBlepImpulse, impulse.data());
+		}
+		return true;
+	}();
+	(void) commonTabulated;
+
+	getCachedImpulse(0, z, o, computeMinBlepImpulse, output);
+}
+
 
-	// Cleanup
-	pffft_aligned_free(x);
-	pffft_aligned_free(fx);
+void minBlampImpulse(int z, int o, float* output) {
+	getCachedImpulse(1, z, o, computeMinBlampImpulse, output);
 }
 
 
@@ -0,0 +1,124 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE file.
+ */
+
+// Compares RealTimeConvolver against NonUniformConvolver for reverb-sized kernels.
+// Times are measured on the calling thread, which is what the audio thread pays for.
+// Blocks taking longer than their own duration are counted as late, for the non-uniform convolver
+// that includes running or waiting for a job whose worker missed its deadline.
+
+#include <dsp/convolver.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace rack;
+
+static constexpr const double kSampleRate = 48000.0;
+static constexpr const size_t kBlockSize = 64;
+static constexpr const double kKernelSeconds[] = { 0.5, 1.0, 2.0, 4.0, 8.0 };
+static constexpr const double kInputSeconds = 10.0;
+
+// --------------------------------------------------------------------------------------------------------------------
+
+struct BlockTimes {
+    double total = 0.0;
+    double worst = 0.0;
+    size_t late = 0; // blocks that took longer than their own duration
+};
+
+template <class Convolver>
+static BlockTimes run(Convolver& convolver, const std::vector<float>& input, std::vector<float>& output)
+{
+    using clock = std::chrono::steady_clock;
+
+    const double blockDuration = kBlockSize / kSampleRate;
+    BlockTimes times;
+
+    for (size_t i = 0; i + kBlockSize <= input.size(); i += kBlockSize)
+    {
+        const clock::time_point start = clock::now();
+        convolver.processBlock(&input[i], &output[i]);
+        const double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+        times.total += elapsed;
+        times.worst = std::max(times.worst, elapsed);
+
+        if (elapsed > blockDuration)
+            ++times.late;
+    }
+
+    return times;
+}
+
+static void print(const char* const name, const BlockTimes& times, const size_t numBlocks)
+{
+    const double blockDuration = kBlockSize / kSampleRate;
+
+    std::printf("  %-12s avg %8.2f us  worst %9.2f us  load %6.2f%%  late blocks %zu\n",
+                name,
+                times.total / numBlocks * 1e6,
+                times.worst * 1e6,
+                times.total / (numBlocks * blockDuration) * 100.0,
+                times.late);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+int main()
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> noise(-1.f, 1.f);
+
+    const size_t numBlocks = static_cast<size_t>(kInputSeconds * kSampleRate) / kBlockSize;
+
+    std::vector<float> input(numBlocks * kBlockSize);
+    for (float& value : input)
+        value = noise(rng);
+
+    std::printf("block size %zu at %.0f Hz, %.0f s of input\n", kBlockSize, kSampleRate, kInputSeconds);
+
+    for (const double seconds : kKernelSeconds)
+    {
+        // exponentially decaying noise, as a stand-in for a reverb impulse response
+        const size_t length = static_cast<size_t>(seconds * kSampleRate);
+        std::vector<float> kernel(length);
+        for (size_t i = 0; i < length; ++i)
+            kernel[i] = noise(rng) * std::exp(-6.9f * i / length) * 0.01f;
+
+        std::vector<float> uniformOutput(input.size());
+        std::vector<float> nonUniformOutput(input.size());
+
+        dsp::RealTimeConvolver uniform(kBlockSize);
+        uniform.setKernel(kernel.data(), length);
+        const BlockTimes uniformTimes = run(uniform, input, uniformOutput);
+
+        dsp::NonUniformConvolver nonUniform(kBlockSize);
+        nonUniform.setKernel(kernel.data(), length);
+        const BlockTimes nonUniformTimes = run(nonUniform, input, nonUniformOutput);
+
+        float maxError = 0.f;
+        for (size_t i = 0; i < input.size(); ++i)
+            maxError = std::max(maxError, std::abs(uniformOutput[i] - nonUniformOutput[i]));
+
+        std::printf("kernel %.1f s (%zu samples), max difference %g\n", seconds, length, maxError);
+        print("uniform", uniformTimes, numBlocks);
+        print("non-uniform", nonUniformTimes, numBlocks);
+    }
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE file.
+ */
+
+// Checks every kernel variant supported by the running CPU against the baseline one.
+// Reductions may sum in a different order, so they are compared within a rounding tolerance
+// relative to the sum of the magnitudes of their terms.
+
+#include <simd/dispatch.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace rack;
+
+static constexpr const int kMaxLength = 300;
+static constexpr const int kMaxOffset = 8;
+static constexpr const int kRounds = 20;
+
+// --------------------------------------------------------------------------------------------------------------------
+
+struct TestContext {
+    const simd::Kernels& baseline;
+    const simd::Kernels& variant;
+    int failures = 0;
+
+    void check(const char* const function, const int len, const float expected, const float result, const double magnitude)
+    {
+        // a few ulps per term is more than any summing order can account for
+        const double tolerance = 4.0 * (len + 1) * 1.2e-7 * magnitude + 1e-30;
+
+        if (std::abs(static_cast<double>(expected) - result) <= tolerance)
+            return;
+
+        if (++failures <= 10)
+            std::printf("  %s len %d: baseline %.9g, %s %.9g\n", function, len, expected, variant.name, result);
+    }
+};
+
+static void testReductions(TestContext& ctx, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> dist(-10.f, 10.f);
+    std::vector<float> a(kMaxLength + kMaxOffset), b(kMaxLength + kMaxOffset);
+
+    for (int round = 0; round < kRounds; ++round)
+    {
+        for (float& value : a)
+            value = dist(rng);
+        for (float& value : b)
+            value = dist(rng);
+
+        for (int len = 0; len <= kMaxLength; ++len)
+        {
+            // unaligned pointers, as the kernels are used on arbitrary offsets into buffers
+            const float* const x = &a[round % kMaxOffset];
+            const float* const y = &b[(round * 3) % kMaxOffset];
+
+            double productMagnitude = 0.0;
+            for (int i = 0; i < len; ++i)
+                productMagnitude += std::abs(x[len - 1 - i] * y[i]);
+
+            ctx.check("convolve", len, ctx.baseline.convolve(x, y, len), ctx.variant.convolve(x, y, len),
+                      productMagnitude);
+            ctx.check("dot", len, ctx.baseline.dot(x, y, len), ctx.variant.dot(x, y, len), productMagnitude);
+        }
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+int main()
+{
+    int count = 0;
+    const simd::Kernels* const* const supported = simd::getSupportedKernels(&count);
+
+    std::printf("%d kernel variants supported, selected %s\n", count, simd::kernels.name);
+
+    if (count == 1)
+    {
+        std::printf("only the baseline is available, nothing to compare\n");
+        return 0;
+    }
+
+    int failures = 0;
+
+    for (int i = 1; i < count; ++i)
+    {
+        std::mt19937 rng(i);
+        TestContext ctx { *supported[0], *supported[i] };
+
+        testReductions(ctx, rng);
+
+        std::printf("%s: %s\n", supported[i]->name, ctx.failures == 0 ? "ok" : "FAILED");
+        failures += ctx.failures;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,270 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE file.
+ */
+
+// Checks the scalar, float_4 and float_8 versions of every dsp/fastmath.hpp function against libm,
+// computed in double precision, over the input ranges and error bounds given in their documentation.
+
+#include <dsp/fastmath.hpp>
+
+#include <cfloat>
+#include <cstdio>
+#include <vector>
+
+using namespace rack;
+
+static constexpr const int kSweepPoints = 1 << 20;
+
+// --------------------------------------------------------------------------------------------------------------------
+
+enum ErrorType {
+    kAbsoluteError,
+    kRelativeError
+};
+
+static double getError(const ErrorType type, const double result, const double reference)
+{
+    const double error = std::abs(result - reference);
+    return type == kRelativeError ? error / std::abs(reference) : error;
+}
+
+// evenly spaced inputs, padded to a multiple of 8 by repeating the last one
+static std::vector<float> sweep(const double first, const double last, const int points = kSweepPoints)
+{
+    std::vector<float> inputs;
+    inputs.reserve(points + 8);
+
+    for (int i = 0; i < points; ++i)
+        inputs.push_back(first + (last - first) * i / (points - 1));
+
+    while (inputs.size() % 8 != 0)
+        inputs.push_back(inputs.back());
+
+    return inputs;
+}
+
+// same, but evenly spaced on a log2 scale
+static std::vector<float> sweepLog2(const double first, const double last, const int points = kSweepPoints)
+{
+    std::vector<float> inputs(sweep(first, last, points));
+
+    for (float& value : inputs)
+        value = std::exp2(static_cast<double>(value));
+
+    return inputs;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static int failures = 0;
+
+// `a` and `b` hold the inputs of each call, `b` is ignored by single argument functions.
+// `bound` gives the allowed error for a pair of inputs.
+template <typename Function, typename Reference, typename Bound>
+static void check(const char* const name,
+                  const std::vector<float>& a, const std::vector<float>& b,
+                  Function function, Reference reference,
+                  const ErrorType type, Bound bound)
+{
+    static constexpr const char* const kVersions[3] = { "float", "float_4", "float_8" };
+    double maxExcess[3] = { 0.0, 0.0, 0.0 };
+    double maxError[3] = { 0.0, 0.0, 0.0 };
+    float worstInputs[3][2] = {};
+
+    const auto test = [&](const int version, const size_t i, const float result) {
+        const double error = getError(type, result, reference(a[i], b[i]));
+        const double excess = error / bound(a[i], b[i]);
+
+        maxError[version] = std::max(maxError[version], error);
+
+        if (excess > maxExcess[version])
+        {
+            maxExcess[version] = excess;
+            worstInputs[version][0] = a[i];
+            worstInputs[version][1] = b[i];
+        }
+    };
+
+    for (size_t i = 0; i < a.size(); i += 8)
+    {
+        for (size_t j = 0; j < 8; ++j)
+            test(0, i + j, function(a[i + j], b[i + j]));
+
+        float results[8];
+
+        for (size_t j = 0; j < 8; j += 4)
+        {
+            function(simd::float_4::load(&a[i + j]), simd::float_4::load(&b[i + j])).store(&results[j]);
+            for (size_t k = 0; k < 4; ++k)
+                test(1, i + j + k, results[j + k]);
+        }
+
+        function(simd::float_8::load(&a[i]), simd::float_8::load(&b[i])).store(results);
+        for (size_t k = 0; k < 8; ++k)
+            test(2, i + k, results[k]);
+    }
+
+    for (int version = 0; version < 3; ++version)
+    {
+        const bool ok = maxExcess[version] <= 1.0;
+
+        std::printf("%-40s %-8s max %s error %.3g %s\n",
+                    name, kVersions[version], type == kRelativeError ? "relative" : "absolute",
+                    maxError[version], ok ? "ok" : "FAILED");
+
+        if (! ok)
+        {
+            std::printf("  worst at %.9g, %.9g, %.3g times the allowed error\n",
+                        worstInputs[version][0], worstInputs[version][1], maxExcess[version]);
+            ++failures;
+        }
+    }
+}
+
+// single argument version with a constant error bound
+template <typename Function>
+static void check(const char* const name,
+                  const std::vector<float>& inputs,
+                  Function function, double (*reference)(double),
+                  const ErrorType type, const double bound)
+{
+    check(name, inputs, inputs,
+          [function](const auto x, const auto) { return function(x); },
+          [reference](const float x, const float) { return reference(x); },
+          type,
+          [bound](const float, const float) { return bound; });
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static double dbToGain(const double db)
+{
+    return std::pow(10.0, db / 20.0);
+}
+
+static double gainToDb(const double gain)
+{
+    return 20.0 * std::log10(gain);
+}
+
+// results of out of range inputs
+static double exp2Min(double)
+{
+    return FLT_MIN;
+}
+
+static double exp2Max(double)
+{
+    return std::exp2(127.0);
+}
+
+static double log2Min(double)
+{
+    return -126.0;
+}
+
+int main()
+{
+    check("fastExp2 [-126, 127]",
+          sweep(-126.0, 127.0),
+          [](const auto x) { return dsp::fastExp2(x); },
+          std::exp2, kRelativeError, 2e-7);
+
+    check("fastLog2 [1/2, 2]",
+          sweepLog2(-1.0, 1.0),
+          [](const auto x) { return dsp::fastLog2(x); },
+          std::log2, kAbsoluteError, 4e-7);
+
+    check("fastLog2 normal range",
+          sweepLog2(-126.0, 127.999),
+          [](const auto x) { return dsp::fastLog2(x); },
+          std::log2, kAbsoluteError, 4e-6);
+
+    check("fastDbToGain [-120, 120]",
+          sweep(-120.0, 120.0),
+          [](const auto x) { return dsp::fastDbToGain(x); },
+          dbToGain, kRelativeError, 1e-6);
+
+    check("fastGainToDb [-20 dB, 20 dB]",
+          sweepLog2(-20.0 / 6.02059991, 20.0 / 6.02059991),
+          [](const auto x) { return dsp::fastGainToDb(x); },
+          gainToDb, kAbsoluteError, 4e-6);
+
+    check("fastGainToDb normal range",
+          sweepLog2(-126.0, 127.999),
+          [](const auto x) { return dsp::fastGainToDb(x); },
+          gainToDb, kAbsoluteError, 4e-5);
+
+    // fastExp2() error plus the rounding of `x * log2(e)` and of log2(e) itself, both relative to x
+    {
+        const std::vector<float> inputs(sweep(-87.0, 88.0));
+
+        check("fastExp [-87, 88]",
+              inputs, inputs,
+              [](const auto x, const auto) { return dsp::fastExp(x); },
+              [](const float x, const float) { return std::exp(static_cast<double>(x)); },
+              kRelativeError,
+              [](const float x, const float) { return 2e-7 + std::abs(x) * 1.2e-7; });
+    }
+
+    check("fastTanh [-20, 20]",
+          sweep(-20.0, 20.0),
+          [](const auto x) { return dsp::fastTanh(x); },
+          std::tanh, kAbsoluteError, 1.5e-7);
+
+    // every combination of 1024 bases and 1024 exponents
+    {
+        const std::vector<float> bases(sweepLog2(std::log2(0.01), std::log2(10.0), 1024));
+        const std::vector<float> exponents(sweep(-4.0, 4.0, 1024));
+        std::vector<float> a, b;
+
+        for (const float base : bases)
+        {
+            for (const float exponent : exponents)
+            {
+                a.push_back(base);
+                b.push_back(exponent);
+            }
+        }
+
+        check("fastPow [0.01, 10] ^ [-4, 4]",
+              a, b,
+              [](const auto base, const auto exponent) { return dsp::fastPow(base, exponent); },
+              [](const float base, const float exponent) { return std::pow(static_cast<double>(base),
+                                                                            static_cast<double>(exponent)); },
+              kRelativeError,
+              [](const float, const float) { return 2.5e-6; });
+    }
+
+    // out of range inputs are clamped, including zero and subnormals for the logarithms
+    check("fastExp2 clamping",
+          sweep(-1000.0, -126.0, 1024),
+          [](const auto x) { return dsp::fastExp2(x); },
+          exp2Min, kRelativeError, 2e-7);
+
+    check("fastExp2 clamping",
+          sweep(127.0, 1000.0, 1024),
+          [](const auto x) { return dsp::fastExp2(x); },
+          exp2Max, kRelativeError, 2e-7);
+
+    check("fastLog2 subnormals",
+          sweep(0.0, FLT_MIN, 1024),
+          [](const auto x) { return dsp::fastLog2(x); },
+          log2Min, kAbsoluteError, 4e-6);
+
+    std::printf("%s\n", failures == 0 ? "all ok" : "some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+/*
+ * DISTRHO Cardinal Plugin
+ * Copyright (C) 2021-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE file.
+ */
+
+// Compares float_8 against float_4 for the per-sample work of typical polyphonic VCO, VCF and VCA modules,
+// all 16 channels processed as 2 float_8 or 4 float_4 vectors per sample.
+// float_8 only uses 256-bit registers on AVX builds, on the default SSE3 build both widths should run about the same.
+
+#include <dsp/fastmath.hpp>
+#include <engine/Port.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace rack;
+
+static constexpr const float kSampleRate = 48000.f;
+static constexpr const int kSamples = 48000 * 20;
+
+// --------------------------------------------------------------------------------------------------------------------
+
+// saw and sine outputs from a 1V/oct pitch input, as in a typical VCO
+template <typename T>
+struct VCO {
+    static constexpr const int kVectors = PORT_MAX_CHANNELS / T::size;
+    T phase[kVectors] = {};
+
+    void process(const float* const pitch, float* const saw, float* const sine)
+    {
+        for (int i = 0; i < kVectors; ++i)
+        {
+            const T freq = dsp::FREQ_C4 * dsp::fastExp2(T::load(&pitch[i * T::size]));
+            phase[i] += freq * (1.f / kSampleRate);
+            phase[i] -= simd::floor(phase[i]);
+
+            (phase[i] * 10.f - 5.f).store(&saw[i * T::size]);
+            (simd::sin(phase[i] * (2.f * float(M_PI))) * 5.f).store(&sine[i * T::size]);
+        }
+    }
+};
+
+// 4-pole ladder lowpass with tanh saturation and a 1V/oct cutoff input, as in a typical VCF
+template <typename T>
+struct VCF {
+    static constexpr const int kVectors = PORT_MAX_CHANNELS / T::size;
+    T state[kVectors][4] = {};
+
+    void process(const float* const input, const float* const cutoff, float* const output)
+    {
+        for (int i = 0; i < kVectors; ++i)
+        {
+            const T freq = simd::fmin(dsp::FREQ_C4 * dsp::fastExp2(T::load(&cutoff[i * T::size])), kSampleRate * 0.2f);
+            const T g = freq * (2.f * float(M_PI) / kSampleRate);
+            T* const s = state[i];
+
+            const T in = dsp::fastTanh(T::load(&input[i * T::size]) * 0.2f - s[3] * 2.f);
+            s[0] += g * (in - dsp::fastTanh(s[0]));
+            s[1] += g * (dsp::fastTanh(s[0]) - dsp::fastTanh(s[1]));
+            s[2] += g * (dsp::fastTanh(s[1]) - dsp::fastTanh(s[2]));
+            s[3] += g * (dsp::fastTanh(s[2]) - dsp::fastTanh(s[3]));
+
+            (s[3] * 5.f).store(&output[i * T::size]);
+        }
+    }
+};
+
+// exponential response to a 0 to 10V gain input, as in a typical VCA
+template <typename T>
+struct VCA {
+    static constexpr const int kVectors = PORT_MAX_CHANNELS / T::size;
+
+    void process(const float* const input, const float* const gain, float* const output)
+    {
+        for (int i = 0; i < kVectors; ++i)
+        {
+            const T cv = simd::clamp(T::load(&gain[i * T::size]) * 0.1f, 0.f, 1.f);
+            const T amp = simd::ifelse(cv > 0.f, dsp::fastDbToGain(cv * 60.f - 60.f), 0.f);
+
+            (T::load(&input[i * T::size]) * amp).store(&output[i * T::size]);
+        }
+    }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+// voltages for all channels, in the usual ranges. audio alternates sign every sample so the filter state keeps moving
+struct Inputs {
+    float audio[PORT_MAX_CHANNELS];
+    float pitch[PORT_MAX_CHANNELS];
+    float gain[PORT_MAX_CHANNELS];
+
+    explicit Inputs(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+
+        for (int c = 0; c < PORT_MAX_CHANNELS; ++c)
+        {
+            audio[c] = dist(rng) * 5.f;
+            pitch[c] = dist(rng) * 2.f;
+            gain[c] = dist(rng) * 5.f + 5.f;
+        }
+    }
+
+    void step(const int sample)
+    {
+        for (int c = 0; c < PORT_MAX_CHANNELS; ++c)
+            audio[c] = -audio[c] + (sample & 1 ? 0.001f : -0.001f);
+    }
+};
+
+struct Results {
+    double seconds;
+    float checksum; // keeps the compiler from dropping the work, and shows both widths compute the same
+};
+
+template <typename T>
+static Results run(const int kernel, std::mt19937 rng)
+{
+    using clock = std::chrono::steady_clock;
+
+    Inputs inputs(rng);
+    VCO<T> vco;
+    VCF<T> vcf;
+    VCA<T> vca;
+    float out1[PORT_MAX_CHANNELS] = {}, out2[PORT_MAX_CHANNELS] = {};
+    float checksum = 0.f;
+
+    const clock::time_point start = clock::now();
+
+    for (int i = 0; i < kSamples; ++i)
+    {
+        inputs.step(i);
+
+        switch (kernel)
+        {
+        case 0:
+            vco.process(inputs.pitch, out1, out2);
+            break;
+        case 1:
+            vcf.process(inputs.audio, inputs.pitch, out1);
+            break;
+        case 2:
+            vca.process(inputs.audio, inputs.gain, out1);
+            break;
+        }
+
+        checksum += out1[i % PORT_MAX_CHANNELS] + out2[i % PORT_MAX_CHANNELS];
+    }
+
+    return { std::chrono::duration<double>(clock::now() - start).count(), checksum };
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+int main()
+{
+    static constexpr const char* const kKernels[] = { "VCO", "VCF", "VCA" };
+
+    std::printf("%d channels, %d samples at %.0f Hz\n", PORT_MAX_CHANNELS, kSamples, kSampleRate);
+
+   #ifdef __AVX__
+    std::printf("built with AVX, float_8 uses 256-bit registers\n");
+   #else
+    std::printf("built without AVX, float_8 runs as two float_4 halves\n");
+   #endif
+
+    for (int kernel = 0; kernel < 3; ++kernel)
+    {
+        const std::mt19937 rng(kernel + 1);
+        const Results results4 = run<simd::float_4>(kernel, rng);
+        const Results results8 = run<simd::float_8>(kernel, rng);
+
+        std::printf("%s\n", kKernels[kernel]);
+        std::printf("  float_4  %7.2f ns/sample  checksum %g\n", results4.seconds / kSamples * 1e9, results4.checksum);
+        std::printf("  float_8  %7.2f ns/sample  checksum %g\n", results8.seconds / kSamples * 1e9, results8.checksum);
+        std::printf("  float_8 speedup %.2fx\n", results4.seconds / results8.seconds);
+    }
+
+    return 0;
+}